@@ -0,0 +1,441 @@
+// Standalone collision benchmark: synthetic scenes of boxes through the
+// CollisionManager, no window or GL. Every workload runs in each query mode
+// and is checked against the tree's answers.
+//
+//   CollisionBench [--sizes 10,100,1000] [--queries N] [--seed S]
+//                  [--label name] [--out results.json]
+
+#include "Algorithms\collision.h"
+#include <gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const float EYE_HEIGHT = 2.0f;
+    const float ALIEN_HEIGHT = 3.0f;
+    const int ALIEN_BATCH = 64;
+
+    // An AABB, or an OBB turned around Y, that never moves
+    class BenchCollidable : public ICollidable
+    {
+    public:
+        BenchCollidable(const glm::vec3& center, const glm::vec3& size, float yaw, bool oriented)
+            : oriented(oriented)
+        {
+            model = glm::translate(glm::mat4(1.0f), center) *
+                glm::rotate(glm::mat4(1.0f), yaw, glm::vec3(0.0f, 1.0f, 0.0f)) *
+                glm::scale(glm::mat4(1.0f), size);
+            inverseModel = glm::inverse(model);
+
+            minW = glm::vec3(std::numeric_limits<float>::max());
+            maxW = glm::vec3(-std::numeric_limits<float>::max());
+            for (int i = 0; i < 8; i++)
+            {
+                glm::vec3 corner((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+                glm::vec3 world = glm::vec3(model * glm::vec4(corner, 1.0f));
+                minW = glm::min(minW, world);
+                maxW = glm::max(maxW, world);
+            }
+        }
+
+        void getWorldAABB(glm::vec3& outMin, glm::vec3& outMax) const override
+        {
+            outMin = minW;
+            outMax = maxW;
+        }
+        const char* getName() const override { return "Bench"; }
+        glm::mat4 getModelMatrix() const override { return model; }
+        glm::mat4 getInverseModelMatrix() const override { return inverseModel; }
+        void getLocalBounds(glm::vec3& outMin, glm::vec3& outMax) const override
+        {
+            outMin = glm::vec3(-0.5f);
+            outMax = glm::vec3(0.5f);
+        }
+        bool usesOBBCollision() const override { return oriented; }
+
+        // Brute force reference for the casts: the segment in box space
+        // (the same parameter t, the matrix is affine) against the unit cube
+        bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& outDistance) const
+        {
+            glm::vec3 localOrigin = glm::vec3(inverseModel * glm::vec4(origin, 1.0f));
+            glm::vec3 localDirection = glm::vec3(inverseModel * glm::vec4(direction, 0.0f));
+            float enter = 0.0f;
+            float exit = maxDistance;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (std::fabs(localDirection[axis]) < 1e-12f)
+                {
+                    if (localOrigin[axis] < -0.5f || localOrigin[axis] > 0.5f)
+                        return false;
+                    continue;
+                }
+                float t0 = (-0.5f - localOrigin[axis]) / localDirection[axis];
+                float t1 = (0.5f - localOrigin[axis]) / localDirection[axis];
+                enter = std::max(enter, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+                if (enter > exit)
+                    return false;
+            }
+            outDistance = enter;
+            return true;
+        }
+
+    private:
+        glm::mat4 model;
+        glm::mat4 inverseModel;
+        glm::vec3 minW;
+        glm::vec3 maxW;
+        bool oriented;
+    };
+
+    // Platforms spread over a square that grows with the count, so the
+    // density (and the work a query should do) stays the same
+    struct Scene
+    {
+        std::vector<std::unique_ptr<BenchCollidable>> collidables;
+        CollisionManager manager;
+        float side;
+        double buildMs;
+    };
+
+    void buildScene(Scene& scene, int count, std::mt19937& random)
+    {
+        scene.side = std::sqrt((float)count) * 10.0f;
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            glm::vec3 center((unit(random) - 0.5f) * scene.side, unit(random) * 30.0f, (unit(random) - 0.5f) * scene.side);
+            glm::vec3 size(2.0f + unit(random) * 8.0f, 0.5f + unit(random) * 2.0f, 2.0f + unit(random) * 8.0f);
+            bool oriented = i % 4 == 0;
+            float yaw = oriented ? unit(random) * 6.2831853f : 0.0f;
+            scene.collidables.emplace_back(new BenchCollidable(center, size, yaw, oriented));
+
+            // like the game: nearly everything is static
+            scene.manager.addCollidable(scene.collidables.back().get(),
+                i % 10 == 0 ? CollisionManager::Mobility::Dynamic : CollisionManager::Mobility::Static);
+        }
+        scene.manager.setCollisionMargin(0.0f);
+        scene.manager.update();
+        scene.buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // half anywhere in the scene, half standing on a random collidable
+    glm::vec3 randomPoint(const Scene& scene, std::mt19937& random, float height)
+    {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        if (unit(random) < 0.5f)
+            return glm::vec3((unit(random) - 0.5f) * scene.side, unit(random) * 40.0f, (unit(random) - 0.5f) * scene.side);
+
+        glm::vec3 minW, maxW;
+        scene.collidables[random() % scene.collidables.size()]->getWorldAABB(minW, maxW);
+        return glm::vec3(glm::mix(minW.x, maxW.x, unit(random)), maxW.y + height * unit(random),
+            glm::mix(minW.z, maxW.z, unit(random)));
+    }
+
+    struct Result
+    {
+        int sceneSize;
+        const char* workload;
+        const char* mode;
+        int queries;
+        double totalMs;
+        double candidatesPerQuery;  // negative when the workload doesn't count them
+        int mismatches;
+    };
+
+    const float DISTANCE_TOLERANCE = 1e-3f;
+
+    struct ModeInfo
+    {
+        const char* name;
+        CollisionManager::QueryMode mode;
+    };
+
+    const ModeInfo MODES[] = {
+        { "bvh", CollisionManager::QueryMode::Tree },
+        { "simd", CollisionManager::QueryMode::SimdScan },
+        { "linear", CollisionManager::QueryMode::ScalarScan },
+    };
+
+    double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // The player: one moveCapsule per tick, walking and falling a little
+    void runPlayer(Scene& scene, int queries, unsigned seed, std::vector<Result>& results)
+    {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> step(-0.3f, 0.3f);
+        std::vector<CollisionManager::Query> moves(queries);
+        std::vector<glm::vec3> motions(queries);
+        for (int i = 0; i < queries; i++)
+        {
+            moves[i] = CollisionManager::Query(randomPoint(scene, random, EYE_HEIGHT) + glm::vec3(0.0f, EYE_HEIGHT, 0.0f), EYE_HEIGHT);
+            motions[i] = glm::vec3(step(random), -0.2f, step(random));
+        }
+
+        std::vector<glm::vec3> expected;
+        for (const ModeInfo& mode : MODES)
+        {
+            scene.manager.setQueryMode(mode.mode);
+            std::vector<glm::vec3> positions(queries);
+            long long candidates = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < queries; i++)
+            {
+                CollisionManager::QueryResult result = scene.manager.moveCapsule(moves[i], motions[i]);
+                positions[i] = result.position;
+                candidates += result.candidates;
+            }
+            double ms = elapsedMs(start);
+
+            int mismatches = 0;
+            if (expected.empty())
+                expected = positions;
+            for (int i = 0; i < queries; i++)
+            {
+                if (positions[i] != expected[i])
+                    mismatches++;
+            }
+
+            Result result = { (int)scene.collidables.size(), "player", mode.name, queries, ms,
+                (double)candidates / queries, mismatches };
+            results.push_back(result);
+        }
+    }
+
+    // The aliens: their probes resolved in batches, like the game's tick
+    void runAliens(Scene& scene, int queries, unsigned seed, std::vector<Result>& results)
+    {
+        std::mt19937 random(seed);
+        std::vector<CollisionManager::Query> probes(queries);
+        for (int i = 0; i < queries; i++)
+            probes[i] = CollisionManager::Query(randomPoint(scene, random, 1.0f) + glm::vec3(0.0f, ALIEN_HEIGHT - 0.2f, 0.0f), ALIEN_HEIGHT);
+
+        std::vector<glm::vec3> expected;
+        for (const ModeInfo& mode : MODES)
+        {
+            scene.manager.setQueryMode(mode.mode);
+            std::vector<CollisionManager::QueryResult> resolved(queries);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < queries; i += ALIEN_BATCH)
+            {
+                int count = std::min(ALIEN_BATCH, queries - i);
+                scene.manager.resolvePoints(&probes[i], count, &resolved[i]);
+            }
+            double ms = elapsedMs(start);
+
+            long long candidates = 0;
+            int mismatches = 0;
+            bool first = expected.empty();
+            for (int i = 0; i < queries; i++)
+            {
+                candidates += resolved[i].candidates;
+                if (first)
+                    expected.push_back(resolved[i].position);
+                else if (resolved[i].position != expected[i])
+                    mismatches++;
+            }
+
+            Result result = { (int)scene.collidables.size(), "alien", mode.name, queries, ms,
+                (double)candidates / queries, mismatches };
+            results.push_back(result);
+        }
+    }
+
+    // Ground checks: a short ray down, always through the trees
+    int runRaycasts(Scene& scene, int queries, unsigned seed, std::vector<Result>& results)
+    {
+        std::mt19937 random(seed);
+        std::vector<glm::vec3> origins(queries);
+        for (int i = 0; i < queries; i++)
+            origins[i] = randomPoint(scene, random, EYE_HEIGHT) + glm::vec3(0.0f, EYE_HEIGHT, 0.0f);
+
+        const glm::vec3 down(0.0f, -1.0f, 0.0f);
+        const float length = EYE_HEIGHT + 3.0f;
+        std::vector<float> distances(queries); // negative for a miss
+        int hits = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < queries; i++)
+        {
+            CollisionManager::RayHit hit;
+            distances[i] = -1.0f;
+            if (scene.manager.raycast(origins[i], down, length, hit))
+            {
+                distances[i] = hit.distance;
+                hits++;
+            }
+        }
+        double ms = elapsedMs(start);
+
+        // every ray against every box, untimed
+        int mismatches = 0;
+        for (int i = 0; i < queries; i++)
+        {
+            float closest = -1.0f;
+            for (const std::unique_ptr<BenchCollidable>& collidable : scene.collidables)
+            {
+                float distance;
+                if (collidable->raycast(origins[i], down, length, distance) && (closest < 0.0f || distance < closest))
+                    closest = distance;
+            }
+            if ((closest < 0.0f) != (distances[i] < 0.0f) || std::fabs(closest - distances[i]) > DISTANCE_TOLERANCE)
+                mismatches++;
+        }
+
+        // casts don't report how many collidables they tested
+        Result result = { (int)scene.collidables.size(), "raycast", "bvh", queries, ms, -1.0, mismatches };
+        results.push_back(result);
+        return hits;
+    }
+
+    std::string formatCandidates(const Result& result, const char* format, const char* missing)
+    {
+        if (result.candidatesPerQuery < 0.0)
+            return missing;
+        char text[32];
+        snprintf(text, sizeof(text), format, result.candidatesPerQuery);
+        return text;
+    }
+
+    bool writeJson(const std::string& path, const std::string& label, unsigned seed, const std::vector<Result>& results)
+    {
+        std::ofstream file(path.c_str(), std::ios::out | std::ios::trunc);
+        if (!file)
+            return false;
+
+        file << "{\n  \"label\": \"" << label << "\",\n  \"seed\": " << seed << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& r = results[i];
+            char line[512];
+            snprintf(line, sizeof(line), "    { \"collidables\": %d, \"workload\": \"%s\", \"mode\": \"%s\", \"queries\": %d, "
+                "\"total_ms\": %.3f, \"queries_per_sec\": %.0f, \"ns_per_query\": %.1f, "
+                "\"candidates_per_query\": %s, \"mismatches\": %d }%s\n",
+                r.sceneSize, r.workload, r.mode, r.queries, r.totalMs, r.queries / (r.totalMs / 1000.0),
+                r.totalMs * 1e6 / r.queries, formatCandidates(r, "%.2f", "null").c_str(), r.mismatches,
+                i + 1 < results.size() ? "," : "");
+            file << line;
+        }
+        file << "  ]\n}\n";
+        return (bool)file;
+    }
+
+    std::vector<int> parseSizes(const char* text)
+    {
+        std::vector<int> sizes;
+        while (*text)
+        {
+            int size = atoi(text);
+            if (size > 0)
+                sizes.push_back(size);
+            const char* comma = strchr(text, ',');
+            if (!comma)
+                break;
+            text = comma + 1;
+        }
+        return sizes;
+    }
+
+    int usage(const char* program, const char* problem)
+    {
+        if (problem)
+            fprintf(stderr, "%s\n", problem);
+        fprintf(stderr, "usage: %s [--sizes 10,100,1000] [--queries N] [--seed S] [--label name] [--out results.json]\n", program);
+        return problem ? 1 : 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> sizes = { 10, 100, 1000, 10000, 100000 };
+    int queries = 10000;
+    unsigned seed = 1;
+    std::string label = "unlabeled";
+    std::string out = "collision_bench.json";
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* flag = argv[i];
+        if (strcmp(flag, "--help") == 0 || strcmp(flag, "-h") == 0)
+            return usage(argv[0], nullptr);
+
+        bool known = strcmp(flag, "--sizes") == 0 || strcmp(flag, "--queries") == 0 || strcmp(flag, "--seed") == 0 ||
+            strcmp(flag, "--label") == 0 || strcmp(flag, "--out") == 0;
+        if (!known)
+        {
+            std::string problem = std::string("unknown argument ") + flag;
+            return usage(argv[0], problem.c_str());
+        }
+        if (i + 1 >= argc)
+        {
+            std::string problem = std::string(flag) + " needs a value";
+            return usage(argv[0], problem.c_str());
+        }
+
+        const char* value = argv[++i];
+        if (strcmp(flag, "--sizes") == 0)
+        {
+            sizes = parseSizes(value);
+            if (sizes.empty())
+                return usage(argv[0], "--sizes needs at least one positive count");
+        }
+        else if (strcmp(flag, "--queries") == 0)
+            queries = std::max(1, atoi(value));
+        else if (strcmp(flag, "--seed") == 0)
+            seed = (unsigned)strtoul(value, nullptr, 10);
+        else if (strcmp(flag, "--label") == 0)
+            label = value;
+        else
+            out = value;
+    }
+
+    std::vector<Result> results;
+    printf("%11s  %-8s %-7s %12s %10s %11s %10s\n", "collidables", "workload", "mode", "queries/s", "ns/query", "candidates", "mismatch");
+    for (int size : sizes)
+    {
+        std::mt19937 random(seed + size);
+        Scene scene;
+        buildScene(scene, size, random);
+        printf("-- %d collidables, built in %.1f ms, static tree %d deep, dynamic tree height %d\n", size, scene.buildMs,
+            scene.manager.getStaticTreeHeight(), scene.manager.getBroadphaseHeight());
+
+        size_t first = results.size();
+        runPlayer(scene, queries, seed, results);
+        runAliens(scene, queries, seed + 1, results);
+        int rayHits = runRaycasts(scene, queries, seed + 2, results);
+
+        for (size_t i = first; i < results.size(); i++)
+        {
+            const Result& r = results[i];
+            printf("%11d  %-8s %-7s %12.0f %10.1f %11s %10d\n", r.sceneSize, r.workload, r.mode,
+                r.queries / (r.totalMs / 1000.0), r.totalMs * 1e6 / r.queries, formatCandidates(r, "%.2f", "-").c_str(),
+                r.mismatches);
+        }
+        printf("   %d of %d ground rays hit\n", rayHits, queries);
+    }
+
+    if (!writeJson(out, label, seed, results))
+    {
+        printf("Could not write %s\n", out.c_str());
+        return 1;
+    }
+    printf("Results written to %s\n", out.c_str());
+    return 0;
+}
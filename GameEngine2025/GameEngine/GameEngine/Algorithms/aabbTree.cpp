@@ -0,0 +1,271 @@
+#include "aabbTree.h"
+#include <algorithm>
+
+namespace
+{
+    float surfaceArea(const glm::vec3& minW, const glm::vec3& maxW)
+    {
+        glm::vec3 d = maxW - minW;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+}
+
+AABBTree::AABBTree(float fatMargin)
+    : root(NULL_NODE)
+    , freeList(NULL_NODE)
+    , leafCount(0)
+    , fatMargin(fatMargin)
+{
+}
+
+void AABBTree::clear()
+{
+    nodes.clear();
+    root = NULL_NODE;
+    freeList = NULL_NODE;
+    leafCount = 0;
+}
+
+int AABBTree::allocateNode()
+{
+    if (freeList == NULL_NODE)
+    {
+        Node node = Node();
+        node.parent = NULL_NODE;
+        node.height = -1;
+        nodes.push_back(node);
+        freeList = (int)nodes.size() - 1;
+    }
+
+    int index = freeList;
+    freeList = nodes[index].parent;
+
+    Node& node = nodes[index];
+    node.minW = glm::vec3(0.0f);
+    node.maxW = glm::vec3(0.0f);
+    node.userData = -1;
+    node.parent = NULL_NODE;
+    node.left = NULL_NODE;
+    node.right = NULL_NODE;
+    node.height = 0;
+    return index;
+}
+
+void AABBTree::freeNode(int index)
+{
+    nodes[index].parent = freeList;
+    nodes[index].height = -1;
+    freeList = index;
+}
+
+int AABBTree::insert(const glm::vec3& minW, const glm::vec3& maxW, int userData)
+{
+    int leaf = allocateNode();
+    glm::vec3 margin(fatMargin);
+    nodes[leaf].minW = minW - margin;
+    nodes[leaf].maxW = maxW + margin;
+    nodes[leaf].userData = userData;
+
+    insertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void AABBTree::remove(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leafCount--;
+}
+
+bool AABBTree::update(int proxy, const glm::vec3& minW, const glm::vec3& maxW)
+{
+    Node& node = nodes[proxy];
+    bool inside = node.minW.x <= minW.x && node.minW.y <= minW.y && node.minW.z <= minW.z &&
+        node.maxW.x >= maxW.x && node.maxW.y >= maxW.y && node.maxW.z >= maxW.z;
+    if (inside)
+        return false;
+
+    removeLeaf(proxy);
+    glm::vec3 margin(fatMargin);
+    nodes[proxy].minW = minW - margin;
+    nodes[proxy].maxW = maxW + margin;
+    insertLeaf(proxy);
+    return true;
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+    if (root == NULL_NODE)
+    {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    // walk down to the sibling that grows the total surface area the least
+    glm::vec3 leafMin = nodes[leaf].minW;
+    glm::vec3 leafMax = nodes[leaf].maxW;
+    int index = root;
+    while (!nodes[index].isLeaf())
+    {
+        const Node& node = nodes[index];
+        float area = surfaceArea(node.minW, node.maxW);
+        float combinedArea = surfaceArea(glm::min(node.minW, leafMin), glm::max(node.maxW, leafMax));
+
+        // making a new parent here, and pushing the leaf further down
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCost[2];
+        int children[2] = { node.left, node.right };
+        for (int i = 0; i < 2; i++)
+        {
+            const Node& child = nodes[children[i]];
+            float grown = surfaceArea(glm::min(child.minW, leafMin), glm::max(child.maxW, leafMax));
+            childCost[i] = child.isLeaf() ? grown + inheritanceCost
+                : (grown - surfaceArea(child.minW, child.maxW)) + inheritanceCost;
+        }
+
+        if (cost < childCost[0] && cost < childCost[1])
+            break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].minW = glm::min(nodes[sibling].minW, leafMin);
+    nodes[newParent].maxW = glm::max(nodes[sibling].maxW, leafMax);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_NODE)
+    {
+        root = newParent;
+    }
+    else if (nodes[oldParent].left == sibling)
+    {
+        nodes[oldParent].left = newParent;
+    }
+    else
+    {
+        nodes[oldParent].right = newParent;
+    }
+
+    refitUpwards(nodes[leaf].parent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+    if (leaf == root)
+    {
+        root = NULL_NODE;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    if (grandParent == NULL_NODE)
+    {
+        root = sibling;
+        nodes[sibling].parent = NULL_NODE;
+        freeNode(parent);
+        return;
+    }
+
+    // the sibling takes the parent's place
+    if (nodes[grandParent].left == parent)
+        nodes[grandParent].left = sibling;
+    else
+        nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+
+    refitUpwards(grandParent);
+}
+
+void AABBTree::refitUpwards(int index)
+{
+    while (index != NULL_NODE)
+    {
+        index = balance(index);
+
+        Node& node = nodes[index];
+        const Node& left = nodes[node.left];
+        const Node& right = nodes[node.right];
+        node.minW = glm::min(left.minW, right.minW);
+        node.maxW = glm::max(left.maxW, right.maxW);
+        node.height = 1 + std::max(left.height, right.height);
+
+        index = node.parent;
+    }
+}
+
+// AVL-style rotation: if one child is two levels taller, its taller child
+// moves up. Returns the node now at the subtree root.
+int AABBTree::balance(int a)
+{
+    Node& A = nodes[a];
+    if (A.isLeaf() || A.height < 2)
+        return a;
+
+    int b = A.left;
+    int c = A.right;
+    int heightDifference = nodes[c].height - nodes[b].height;
+
+    if (heightDifference > 1 || heightDifference < -1)
+    {
+        // rotate the taller child (up) above a
+        bool rightTaller = heightDifference > 1;
+        int up = rightTaller ? c : b;
+        int other = rightTaller ? b : c;
+        int f = nodes[up].left;
+        int g = nodes[up].right;
+
+        // up replaces a under a's parent
+        nodes[up].left = a;
+        nodes[up].parent = A.parent;
+        A.parent = up;
+        if (nodes[up].parent != NULL_NODE)
+        {
+            Node& upParent = nodes[nodes[up].parent];
+            if (upParent.left == a)
+                upParent.left = up;
+            else
+                upParent.right = up;
+        }
+        else
+        {
+            root = up;
+        }
+
+        // the taller grandchild stays with up, the shorter one goes to a
+        int keep = nodes[f].height > nodes[g].height ? f : g;
+        int give = keep == f ? g : f;
+        nodes[up].right = keep;
+        if (rightTaller)
+            A.right = give;
+        else
+            A.left = give;
+        nodes[give].parent = a;
+
+        A.minW = glm::min(nodes[other].minW, nodes[give].minW);
+        A.maxW = glm::max(nodes[other].maxW, nodes[give].maxW);
+        A.height = 1 + std::max(nodes[other].height, nodes[give].height);
+
+        Node& U = nodes[up];
+        U.minW = glm::min(A.minW, nodes[keep].minW);
+        U.maxW = glm::max(A.maxW, nodes[keep].maxW);
+        U.height = 1 + std::max(A.height, nodes[keep].height);
+        return up;
+    }
+
+    return a;
+}
@@ -0,0 +1,158 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Dynamic bounding volume hierarchy over fat AABBs (broadphase).
+// Leaves store a box enlarged by a margin so small moves don't touch the
+// tree; inserts pick the cheapest sibling by surface area and the tree is
+// kept balanced with rotations, so queries visit O(log n) nodes.
+class AABBTree
+{
+public:
+    static const int NULL_NODE = -1;
+
+    explicit AABBTree(float fatMargin = 0.5f);
+
+    // returns a proxy id for the box, stable until remove()
+    int insert(const glm::vec3& minW, const glm::vec3& maxW, int userData);
+    void remove(int proxy);
+
+    // Refit a moved box. Returns false (and does nothing) while the box
+    // still fits inside its fat AABB.
+    bool update(int proxy, const glm::vec3& minW, const glm::vec3& maxW);
+
+    void clear();
+
+    int getUserData(int proxy) const { return nodes[proxy].userData; }
+    void getFatAABB(int proxy, glm::vec3& outMin, glm::vec3& outMax) const
+    {
+        outMin = nodes[proxy].minW;
+        outMax = nodes[proxy].maxW;
+    }
+
+    // calls visit(proxy) for every leaf whose fat box overlaps [minW, maxW]
+    template <typename Visitor>
+    void query(const glm::vec3& minW, const glm::vec3& maxW, Visitor&& visit) const
+    {
+        if (root == NULL_NODE)
+            return;
+
+        int stack[STACK_SIZE];
+        int count = 0;
+        stack[count++] = root;
+        while (count > 0)
+        {
+            const Node& node = nodes[stack[--count]];
+            if (!overlaps(node, minW, maxW))
+                continue;
+
+            if (node.isLeaf())
+            {
+                visit((int)(&node - &nodes[0]));
+            }
+            else if (count + 2 <= STACK_SIZE)
+            {
+                stack[count++] = node.left;
+                stack[count++] = node.right;
+            }
+        }
+    }
+
+    // calls visit(proxy) for every leaf whose fat box, grown by radius, the
+    // segment origin + direction * [0, maxDistance] passes through. visit
+    // returns the distance to clip the segment to, so subtrees past the
+    // closest hit so far are skipped.
+    template <typename Visitor>
+    void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float radius,
+        Visitor&& visit) const
+    {
+        if (root == NULL_NODE)
+            return;
+
+        glm::vec3 grow(radius);
+        int stack[STACK_SIZE];
+        int count = 0;
+        stack[count++] = root;
+        while (count > 0)
+        {
+            const Node& node = nodes[stack[--count]];
+            if (!segmentHitsBox(node.minW - grow, node.maxW + grow, origin, direction, maxDistance))
+                continue;
+
+            if (node.isLeaf())
+            {
+                maxDistance = visit((int)(&node - &nodes[0]));
+            }
+            else if (count + 2 <= STACK_SIZE)
+            {
+                stack[count++] = node.left;
+                stack[count++] = node.right;
+            }
+        }
+    }
+
+    int getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+    int getLeafCount() const { return leafCount; }
+
+private:
+    // balanced trees stay far below this even with millions of leaves
+    static const int STACK_SIZE = 256;
+
+    struct Node
+    {
+        glm::vec3 minW;
+        glm::vec3 maxW;
+        int userData;
+        int parent;     // also the free list link
+        int left;
+        int right;
+        int height;     // 0 for leaves, -1 when free
+
+        bool isLeaf() const { return left == NULL_NODE; }
+    };
+
+    std::vector<Node> nodes;
+    int root;
+    int freeList;
+    int leafCount;
+    float fatMargin;
+
+    static bool overlaps(const Node& node, const glm::vec3& minW, const glm::vec3& maxW)
+    {
+        return node.minW.x <= maxW.x && node.maxW.x >= minW.x &&
+            node.minW.y <= maxW.y && node.maxW.y >= minW.y &&
+            node.minW.z <= maxW.z && node.maxW.z >= minW.z;
+    }
+
+    static bool segmentHitsBox(const glm::vec3& minW, const glm::vec3& maxW,
+        const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+    {
+        float enter = 0.0f;
+        float exit = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::fabs(direction[axis]) < 1e-12f)
+            {
+                if (origin[axis] < minW[axis] || origin[axis] > maxW[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (minW[axis] - origin[axis]) / direction[axis];
+            float t1 = (maxW[axis] - origin[axis]) / direction[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+            if (enter > exit)
+                return false;
+        }
+        return true;
+    }
+
+    int allocateNode();
+    void freeNode(int index);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    int balance(int index);
+    void refitUpwards(int index);
+};
@@ -1,9 +1,55 @@
 #include "collision.h"
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 
+namespace
+{
+    // Segment origin + direction * [0, maxT] against a box: outT is where
+    // it enters and outNormal the face it enters through. Starting inside
+    // is a hit at 0 with a zero normal.
+    bool segmentEntersBox(const glm::vec3& minB, const glm::vec3& maxB, const glm::vec3& origin,
+        const glm::vec3& direction, float maxT, float& outT, glm::vec3& outNormal)
+    {
+        float enter = 0.0f;
+        float exit = maxT;
+        int enterAxis = -1;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::fabs(direction[axis]) < 1e-12f)
+            {
+                if (origin[axis] < minB[axis] || origin[axis] > maxB[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (minB[axis] - origin[axis]) / direction[axis];
+            float t1 = (maxB[axis] - origin[axis]) / direction[axis];
+            if (std::min(t0, t1) > enter)
+            {
+                enter = std::min(t0, t1);
+                enterAxis = axis;
+            }
+            exit = std::min(exit, std::max(t0, t1));
+            if (enter > exit)
+                return false;
+        }
+
+        outT = enter;
+        outNormal = glm::vec3(0.0f);
+        if (enterAxis != -1)
+            outNormal[enterAxis] = direction[enterAxis] > 0.0f ? -1.0f : 1.0f;
+        return true;
+    }
+}
+
 CollisionManager::CollisionManager()
-    : collisionMargin(0.1f)
+    : staticTreeDirty(false)
+    , queryMode(QueryMode::Tree)
+    , nextOrder(1)
+    , worldVersion(0)
+    , lastCandidateCount(0)
+    , ground(nullptr)
+    , collisionMargin(0.1f)
     , debugOutput(false)
 {
 }
@@ -14,31 +60,140 @@ CollisionManager::~CollisionManager()
     collidables.clear();
 }
 
-void CollisionManager::addCollidable(ICollidable* collidable)
+void CollisionManager::addCollidable(ICollidable* collidable, Mobility mobility)
 {
     if (collidable)
     {
         // avoid duplicates
-        auto it = std::find(collidables.begin(), collidables.end(), collidable);
-        if (it == collidables.end())
+        if (proxies.find(collidable) == proxies.end())
         {
+            collidable->updateTransform();
+
+            Proxy proxy;
+            proxy.entry = store.add(collidable, nextOrder++);
+            glm::vec3 minW, maxW;
+            store.getBox(proxy.entry, minW, maxW);
+            proxy.node = broadphase.insert(minW, maxW, proxy.entry);
+            proxy.index = (int)collidables.size();
+            proxy.isStatic = mobility == Mobility::Static;
+            proxies[collidable] = proxy;
             collidables.push_back(collidable);
+            if (proxy.isStatic)
+                staticTreeDirty = true;
+            worldVersion++;
         }
     }
 }
 
 void CollisionManager::removeCollidable(ICollidable* collidable)
 {
-    auto it = std::find(collidables.begin(), collidables.end(), collidable);
-    if (it != collidables.end())
+    auto proxy = proxies.find(collidable);
+    if (proxy == proxies.end())
+        return;
+
+    bool inStaticTree = proxy->second.node == AABBTree::NULL_NODE;
+    if (!inStaticTree)
+        broadphase.remove(proxy->second.node);
+    store.remove(proxy->second.entry);
+
+    // the last collidable takes its slot
+    int index = proxy->second.index;
+    collidables[index] = collidables.back();
+    proxies[collidables[index]].index = index;
+    collidables.pop_back();
+    proxies.erase(proxy);
+
+    // its entry id may be handed out again, the static tree can't keep it
+    if (inStaticTree)
+        buildStaticTree();
+    worldVersion++;
+}
+
+void CollisionManager::updateCollidable(ICollidable* collidable)
+{
+    auto proxy = proxies.find(collidable);
+    if (proxy == proxies.end())
+        return;
+
+    collidable->updateTransform();
+    store.refresh(proxy->second.entry);
+    if (proxy->second.node == AABBTree::NULL_NODE)
+    {
+        buildStaticTree();
+    }
+    else
     {
-        collidables.erase(it);
+        glm::vec3 minW, maxW;
+        store.getBox(proxy->second.entry, minW, maxW);
+        broadphase.update(proxy->second.node, minW, maxW);
+    }
+    worldVersion++;
+}
+
+void CollisionManager::buildStaticTree()
+{
+    std::vector<StaticBVH::Item> items;
+    for (auto& pair : proxies)
+    {
+        Proxy& proxy = pair.second;
+        if (!proxy.isStatic)
+            continue;
+
+        if (proxy.node != AABBTree::NULL_NODE)
+        {
+            broadphase.remove(proxy.node);
+            proxy.node = AABBTree::NULL_NODE;
+        }
+
+        StaticBVH::Item item;
+        store.getBox(proxy.entry, item.minW, item.maxW);
+        item.userData = proxy.entry;
+        items.push_back(item);
+    }
+
+    staticTree.build(items);
+    staticTreeDirty = false;
+}
+
+void CollisionManager::update()
+{
+    if (staticTreeDirty)
+        buildStaticTree();
+
+    for (auto& pair : proxies)
+    {
+        ICollidable* collidable = const_cast<ICollidable*>(pair.first);
+        const Proxy& proxy = pair.second;
+        if (proxy.isStatic)
+            continue;
+
+        // only the objects whose setters ran since the last pass are copied
+        // again, the others just get their flags checked
+        if (collidable->updateTransform())
+        {
+            store.refresh(proxy.entry);
+            glm::vec3 minW, maxW;
+            store.getBox(proxy.entry, minW, maxW);
+            broadphase.update(proxy.node, minW, maxW);
+            worldVersion++;
+        }
+        else if (store.refreshFlags(proxy.entry))
+        {
+            worldVersion++;
+        }
     }
 }
 
 void CollisionManager::clearAll()
 {
     collidables.clear();
+    proxies.clear();
+    broadphase.clear();
+    staticTree.clear();
+    staticTreeDirty = false;
+    store.clear();
+    distanceField.clear();
+    worldVersion++;
 }
 
 const char* CollisionManager::faceToString(ContactFace face)
@@ -57,77 +212,712 @@ const char* CollisionManager::faceToString(ContactFace face)
 
 bool CollisionManager::resolvePointAgainstAll(glm::vec3& point, float eyeHeight)
 {
+    QueryResult result;
+    resolveQuery(Query(point, eyeHeight), result, hitScratch);
+
+    point = result.position;
+    lastCollision = result.lastCollision;
+    lastCandidateCount = result.candidates;
+    return result.resolved;
+}
+
+void CollisionManager::resolvePoints(const Query* queries, size_t count, QueryResult* results) const
+{
+    // scratch per call instead of a member, this is what makes it reentrant
+    std::vector<CollisionStore::Hit> scratch;
+    for (size_t i = 0; i < count; i++)
+    {
+        resolveQuery(queries[i], results[i], scratch);
+    }
+}
+
+CollisionManager::QueryResult CollisionManager::resolvePoint(const Query& query) const
+{
+    QueryResult result;
+    resolvePoints(&query, 1, &result);
+    return result;
+}
+
+bool CollisionManager::sweepCapsule(const Query& query, const glm::vec3& motion, SweepHit& outHit) const
+{
+    float length = glm::length(motion);
+    if (length <= 0.0f)
+        return false;
+
+    // everything the moving point could resolve against anywhere on the way
+    float reach = std::max(1.0f, query.eyeHeight) + collisionMargin + query.radius;
+    glm::vec3 end = query.point + motion;
+    glm::vec3 sweepMin = glm::min(query.point, end) - glm::vec3(reach);
+    glm::vec3 sweepMax = glm::max(query.point, end) + glm::vec3(reach);
+    int samples = std::max(1, (int)std::ceil(length / SWEEP_STEP));
+
+    // the earliest hit wins, registration order breaks ties like the resolve
+    float firstTime = 2.0f;
+    int firstEntry = -1;
+    auto consider = [&](int entry)
+    {
+        if (!(store.getLayers(entry) & query.filterMask))
+            return;
+
+        float time;
+        if (!sweepEntry(entry, query, motion, samples, firstTime, time))
+            return;
+        if (time < firstTime || (time == firstTime && store.getOrder(entry) < store.getOrder(firstEntry)))
+        {
+            firstTime = time;
+            firstEntry = entry;
+        }
+    };
+
+    int cached;
+    if (lookupSupport(query.support, sweepMin, sweepMax, cached))
+    {
+        if (cached != -1)
+            consider(cached);
+    }
+    else
+        queryBroadphase(sweepMin, sweepMax, consider);
+
+    if (firstEntry == -1)
+        return false;
+
+    outHit.time = firstTime;
+    outHit.position = query.point + motion * firstTime;
+
+    glm::vec3 resolved = outHit.position;
+    ContactFace face;
+    resolvePointAgainstEntry(firstEntry, resolved, query.eyeHeight, query.radius, face);
+    outHit.normal = contactNormal(firstEntry, face, resolved - outHit.position);
+    outHit.contact.collidable = store.getCollidable(firstEntry);
+    outHit.contact.face = face;
+    outHit.contact.resolvedPosition = resolved;
+    outHit.contact.normal = outHit.normal;
+    return true;
+}
+
+bool CollisionManager::sweepEntry(int entry, const Query& query, const glm::vec3& motion, int samples, float limit,
+    float& outTime) const
+{
+    const int BISECTION_STEPS = 12;
+
+    ContactFace face;
+    glm::vec3 point = query.point;
+    if (resolvePointAgainstEntry(entry, point, query.eyeHeight, query.radius, face))
+        return false;
+
+    float freeTime = 0.0f;
+    for (int i = 1; i <= samples && freeTime <= limit; i++)
+    {
+        float hitTime = (float)i / samples;
+        point = query.point + motion * hitTime;
+        if (!resolvePointAgainstEntry(entry, point, query.eyeHeight, query.radius, face))
+        {
+            freeTime = hitTime;
+            continue;
+        }
+
+        // the surface is somewhere between the last free sample and this one
+        for (int step = 0; step < BISECTION_STEPS; step++)
+        {
+            float middle = 0.5f * (freeTime + hitTime);
+            point = query.point + motion * middle;
+            if (resolvePointAgainstEntry(entry, point, query.eyeHeight, query.radius, face))
+                hitTime = middle;
+            else
+                freeTime = middle;
+        }
+        if (hitTime > limit)
+            return false;
+        outTime = hitTime;
+        return true;
+    }
+    return false;
+}
+
+glm::vec3 CollisionManager::contactNormal(int entry, ContactFace face, const glm::vec3& push) const
+{
+    bool oriented = store.isOriented(entry);
+    if (oriented && store.getOrientedBox(entry).mesh)
+    {
+        // the mesh resolve always pushes along the contact normal
+        float length = glm::length(push);
+        return length > 0.0f ? push / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    glm::vec3 normal;
+    switch (face)
+    {
+    case ContactFace::Bottom: normal = glm::vec3(0.0f, -1.0f, 0.0f); break;
+    case ContactFace::Left:   normal = glm::vec3(-1.0f, 0.0f, 0.0f); break;
+    case ContactFace::Right:  normal = glm::vec3(1.0f, 0.0f, 0.0f); break;
+    case ContactFace::Back:   normal = glm::vec3(0.0f, 0.0f, -1.0f); break;
+    case ContactFace::Front:  normal = glm::vec3(0.0f, 0.0f, 1.0f); break;
+    default:                  normal = glm::vec3(0.0f, 1.0f, 0.0f); break;
+    }
+
+    // an OBB's faces are in its local space
+    if (oriented)
+    {
+        glm::mat3 toWorld = glm::transpose(glm::mat3(store.getOrientedBox(entry).inverseModel));
+        normal = glm::normalize(toWorld * normal);
+    }
+    return normal;
+}
+
+bool CollisionManager::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance,
+    RayHit& outHit, unsigned filterMask, SupportCache* support) const
+{
+    float length = glm::length(direction);
+    if (length <= 0.0f || maxDistance < 0.0f)
+        return false;
+    return cast(origin, 0.0f, direction / length, maxDistance, filterMask, support, outHit);
+}
+
+bool CollisionManager::sphereCast(const glm::vec3& origin, float radius, const glm::vec3& direction,
+    float maxDistance, RayHit& outHit, unsigned filterMask, SupportCache* support) const
+{
+    float length = glm::length(direction);
+    if (length <= 0.0f || maxDistance < 0.0f)
+        return false;
+    return cast(origin, std::max(radius, 0.0f), direction / length, maxDistance, filterMask, support, outHit);
+}
+
+bool CollisionManager::cast(const glm::vec3& origin, float radius, const glm::vec3& direction, float maxDistance,
+    unsigned filterMask, SupportCache* support, RayHit& outHit) const
+{
+    float closest = maxDistance;
+    int hitEntry = -1;
+    glm::vec3 hitNormal(0.0f);
+    auto consider = [&](int entry)
+    {
+        float distance;
+        glm::vec3 normal;
+        if ((store.getLayers(entry) & filterMask) &&
+            castAgainstEntry(entry, origin, radius, direction, closest, distance, normal) &&
+            (hitEntry == -1 || distance < closest ||
+                (distance == closest && store.getOrder(entry) < store.getOrder(hitEntry))))
+        {
+            closest = distance;
+            hitEntry = entry;
+            hitNormal = normal;
+        }
+    };
+
+    glm::vec3 end = origin + direction * maxDistance;
+    int cached;
+    if (lookupSupport(support, glm::min(origin, end) - glm::vec3(radius), glm::max(origin, end) + glm::vec3(radius), cached))
+    {
+        if (cached != -1)
+            consider(cached);
+    }
+    else
+    {
+        // the trees clip the ray to the closest hit so far as they go
+        raycastBroadphase(origin, direction, maxDistance, radius, [&](int entry)
+        {
+            consider(entry);
+            return closest;
+        });
+    }
+
+    bool found = hitEntry != -1;
+    ICollidable* collidable = found ? store.getCollidable(hitEntry) : nullptr;
+
+    float groundDistance;
+    if (ground && (filterMask & COLLISION_LAYER_GROUND) &&
+        ground->raycast(origin - glm::vec3(0.0f, radius, 0.0f), direction, closest, groundDistance) &&
+        (!found || groundDistance < closest))
+    {
+        glm::vec3 under = origin + direction * groundDistance;
+        closest = groundDistance;
+        hitNormal = ground->getNormal(under.x, under.z);
+        collidable = nullptr;
+        found = true;
+    }
+
+    if (!found)
+        return false;
+
+    // a floor under the cast, the next casts from around here can skip the tree
+    if (support && hitNormal.y > 0.7f)
+        cacheSupport(*support, origin, maxDistance + radius, collidable ? hitEntry : -1);
+
+    outHit.distance = closest;
+    outHit.point = origin + direction * closest;
+    outHit.normal = hitNormal;
+    outHit.collidable = collidable;
+    return true;
+}
+
+bool CollisionManager::castAgainstEntry(int entry, const glm::vec3& origin, float radius, const glm::vec3& direction,
+    float maxDistance, float& outDistance, glm::vec3& outNormal) const
+{
+    if (!store.isOriented(entry))
+    {
+        glm::vec3 minW, maxW;
+        store.getBox(entry, minW, maxW);
+        if (!segmentEntersBox(minW - glm::vec3(radius), maxW + glm::vec3(radius),
+            origin, direction, maxDistance, outDistance, outNormal))
+            return false;
+
+        // starting inside faces back along the cast
+        if (outNormal == glm::vec3(0.0f))
+            outNormal = -direction;
+        return true;
+    }
+
+    const CollisionStore::OrientedBox& box = store.getOrientedBox(entry);
+    if (box.mesh && radius <= 0.0f)
+        return box.mesh->raycast(box.inverseModel, origin, direction, maxDistance, outDistance, outNormal);
+
+    if (box.mesh)
+    {
+        // step the sphere a radius at a time so no surface is skipped, then
+        // bisect the step that touched
+        const int BISECTION_STEPS = 12;
+        TriangleBVH::Contact contact;
+        auto touches = [&](float distance)
+        {
+            glm::vec3 center = origin + direction * distance;
+            return box.mesh->collideCapsule(box.model, box.inverseModel, center, center, radius, contact);
+        };
+
+        float hitDistance = -1.0f;
+        float freeDistance = 0.0f;
+        if (touches(0.0f))
+        {
+            hitDistance = 0.0f;
+        }
+        else
+        {
+            int steps = std::max(1, (int)std::ceil(maxDistance / radius));
+            for (int i = 1; i <= steps && hitDistance < 0.0f; i++)
+            {
+                float distance = maxDistance * i / steps;
+                if (touches(distance))
+                    hitDistance = distance;
+                else
+                    freeDistance = distance;
+            }
+            if (hitDistance < 0.0f)
+                return false;
+            for (int step = 0; step < BISECTION_STEPS; step++)
+            {
+                float middle = 0.5f * (freeDistance + hitDistance);
+                if (touches(middle))
+                    hitDistance = middle;
+                else
+                    freeDistance = middle;
+            }
+        }
+        touches(hitDistance);
+        outDistance = hitDistance;
+        outNormal = contact.normal;
+        return true;
+    }
+
+    // the box in its own space, grown by the radius along each scaled axis
+    glm::vec3 scale(glm::length(glm::vec3(box.model[0])), glm::length(glm::vec3(box.model[1])),
+        glm::length(glm::vec3(box.model[2])));
+    glm::vec3 grow = glm::vec3(radius) / scale;
+    glm::vec3 localOrigin = glm::vec3(box.inverseModel * glm::vec4(origin, 1.0f));
+    glm::vec3 localEnd = glm::vec3(box.inverseModel * glm::vec4(origin + direction * maxDistance, 1.0f));
+
+    float t;
+    glm::vec3 localNormal;
+    if (!segmentEntersBox(box.localMin - grow, box.localMax + grow, localOrigin, localEnd - localOrigin, 1.0f,
+        t, localNormal))
+        return false;
+
+    outDistance = t * maxDistance;
+    outNormal = localNormal == glm::vec3(0.0f) ? -direction
+        : glm::normalize(glm::transpose(glm::mat3(box.inverseModel)) * localNormal);
+    return true;
+}
+
+CollisionManager::QueryResult CollisionManager::moveCapsule(const Query& query, const glm::vec3& motion,
+    int maxIterations) const
+{
+    // resolved contacts are left this far off the surface, so the next
+    // sweep doesn't start touching it
+    const float SKIN = 0.001f;
+
+    Query moving = query;
+    glm::vec3 remaining = motion;
+    CollisionInfo contact;
+    bool touched = false;
+    QueryResult swept;      // only its contacts
+
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        SweepHit hit;
+        if (!sweepCapsule(moving, remaining, hit))
+        {
+            moving.point += remaining;
+            break;
+        }
+
+        touched = true;
+        moving.point = hit.contact.resolvedPosition + hit.normal * SKIN;
+        contact = hit.contact;
+        contact.resolvedPosition = moving.point;
+        swept.addContact(contact);
+        if (contact.collidable->isHazard())
+            break;
+
+        // what is left of the motion, without the part going into the surface
+        remaining *= 1.0f - hit.time;
+        float into = glm::dot(remaining, hit.normal);
+        if (into < 0.0f)
+            remaining -= hit.normal * into;
+    }
+
+    // the end point still gets the full resolve, for the ground and for
+    // anything the move started inside of
+    QueryResult result;
+    std::vector<CollisionStore::Hit> scratch;
+    resolveQuery(moving, result, scratch);
+
+    // a hazard on the way, or a collidable if the resolve only found the ground
+    if (touched && (contact.collidable->isHazard() || !result.lastCollision.collidable))
+        result.lastCollision = contact;
+    result.resolved = result.resolved || touched;
+    for (int i = 0; i < swept.contactCount; i++)
+        result.addContact(swept.contacts[i]);
+    return result;
+}
+
+void CollisionManager::resolveQuery(const Query& request, QueryResult& result, std::vector<CollisionStore::Hit>& hits) const
+{
+    glm::vec3 point = request.point;
+    float eyeHeight = request.eyeHeight;
     bool anyResolved = false;
-    lastCollision = CollisionInfo(); // reset last collision info
+    CollisionInfo contact;
+    bool landed = false;
+    int supportEntry = -1;      // what it landed on, -1 for the ground
+
+    // Only the collidables that can move the point, in the same order the
+    // full list was walked in. A resolve moves the point, so the rest of the
+    // list is gathered again around the new position.
+    CollisionStore::PointQuery query;
+    query.eyeHeight = eyeHeight;
+    query.margin = collisionMargin;
+    query.reach = std::max(1.0f, eyeHeight) + collisionMargin + request.radius;
+    query.afterOrder = 0;
+    query.filter = request.filterMask;
+    result.candidates = 0;
+    result.contactCount = 0;
 
-    for (ICollidable* collidable : collidables)
+    bool moved = true;
+    while (moved)
     {
-        if (collidable && collidable->isCollisionEnabled())
+        moved = false;
+        query.point = point;
+        gatherHits(query, request.support, hits);
+        result.candidates += (int)hits.size();
+
+        for (const CollisionStore::Hit& hit : hits)
         {
             ContactFace face;
-            bool collided = false;
+            glm::vec3 before = point;
+            if (!resolvePointAgainstEntry(hit.entry, point, eyeHeight, request.radius, face))
+                continue;
 
-            // use OBB collision if the object requests it
-            if (collidable->usesOBBCollision())
+            ICollidable* collidable = store.getCollidable(hit.entry);
+            anyResolved = true;
+            contact.collidable = collidable;
+            contact.face = face;
+            contact.resolvedPosition = point;
+            contact.normal = contactNormal(hit.entry, face, point - before);
+            result.addContact(contact);
+            if (face == ContactFace::Top)
             {
-                collided = resolvePointAgainstOBB(collidable, point, eyeHeight, face);
+                landed = true;
+                supportEntry = hit.entry;
             }
-            else
+
+            // print collision info if debug is enabled
+            if (debugOutput)
             {
-                // use standard AABB collision
+                printf("=== Collision with '%s' on %s face ===\n",
+                    collidable->getName(),
+                    faceToString(face));
+                printf("  Player pos: (%.2f, %.2f, %.2f), feet Y: %.2f\n",
+                    point.x, point.y, point.z, point.y - eyeHeight);
+
                 glm::vec3 minW, maxW;
+                if (collidable->usesOBBCollision())
+                {
+                    glm::vec3 localMin, localMax;
+                    collidable->getLocalBounds(localMin, localMax);
+                    printf("  OBJ Local bounds min: (%.2f, %.2f, %.2f)\n",
+                        localMin.x, localMin.y, localMin.z);
+                    printf("  OBJ Local bounds max: (%.2f, %.2f, %.2f)\n",
+                        localMax.x, localMax.y, localMax.z);
+                }
+
                 collidable->getWorldAABB(minW, maxW);
-                collided = resolvePointAgainstAABB(minW, maxW, point, eyeHeight, face);
+                printf("  OBJ World AABB min: (%.2f, %.2f, %.2f)\n",
+                    minW.x, minW.y, minW.z);
+                printf("  OBJ World AABB max: (%.2f, %.2f, %.2f)\n",
+                    maxW.x, maxW.y, maxW.z);
             }
 
-            if (collided)
-            {
-                anyResolved = true;
-                lastCollision.collidable = collidable;
-                lastCollision.face = face;
-                lastCollision.resolvedPosition = point;
+            query.afterOrder = hit.order;
+            moved = true;
+            break;
+        }
+    }
 
-                // print collision info if debug is enabled
-                if (debugOutput)
-                {
-                    printf("=== Collision with '%s' on %s face ===\n",
-                        collidable->getName(),
-                        faceToString(face));
-                    printf("  Player pos: (%.2f, %.2f, %.2f), feet Y: %.2f\n",
-                        point.x, point.y, point.z, point.y - eyeHeight);
-
-                    glm::vec3 minW, maxW;
-                    if (collidable->usesOBBCollision())
-                    {
-                        glm::vec3 localMin, localMax;
-                        collidable->getLocalBounds(localMin, localMax);
-                        printf("  OBJ Local bounds min: (%.2f, %.2f, %.2f)\n",
-                            localMin.x, localMin.y, localMin.z);
-                        printf("  OBJ Local bounds max: (%.2f, %.2f, %.2f)\n",
-                            localMax.x, localMax.y, localMax.z);
-                    }
-
-                    collidable->getWorldAABB(minW, maxW);
-                    printf("  OBJ World AABB min: (%.2f, %.2f, %.2f)\n",
-                        minW.x, minW.y, minW.z);
-                    printf("  OBJ World AABB max: (%.2f, %.2f, %.2f)\n",
-                        maxW.x, maxW.y, maxW.z);
-                }
+    // the ground last, a platform may already have lifted the point above it.
+    // A collidable hit this call keeps priority in lastCollision (hazards).
+    ContactFace groundFace;
+    if ((request.filterMask & COLLISION_LAYER_GROUND) && resolvePointAgainstGround(point, eyeHeight, groundFace))
+    {
+        CollisionInfo groundContact;
+        groundContact.face = groundFace;
+        groundContact.resolvedPosition = point;
+        groundContact.normal = ground->getNormal(point.x, point.z);
+        result.addContact(groundContact);
+
+        if (!anyResolved)
+            contact = groundContact;
+        anyResolved = true;
+        if (!landed && groundFace == ContactFace::Top)
+            landed = true;
+
+        if (debugOutput)
+        {
+            printf("=== Collision with ground on %s face ===\n", faceToString(groundFace));
+            printf("  Player pos: (%.2f, %.2f, %.2f), feet Y: %.2f\n",
+                point.x, point.y, point.z, point.y - eyeHeight);
+        }
+    }
+
+    if (request.support && landed)
+        cacheSupport(*request.support, point, query.reach, supportEntry);
+
+    result.position = point;
+    result.resolved = anyResolved;
+    result.lastCollision = contact;
+}
+
+void CollisionManager::gatherHits(const CollisionStore::PointQuery& query, SupportCache* support,
+    std::vector<CollisionStore::Hit>& hits) const
+{
+    hits.clear();
+
+    // The box resolve needs the eye over the box and reaches down to the
+    // feet; a rotated box is hit only if a surface point lies within
+    // eyeHeight of the eye. query.reach covers both.
+    glm::vec3 queryMin = query.point - glm::vec3(query.reach);
+    glm::vec3 queryMax = query.point + glm::vec3(query.reach);
+
+    int cached;
+    if (lookupSupport(support, queryMin, queryMax, cached))
+    {
+        if (cached != -1 && store.mayResolve(cached, query))
+        {
+            CollisionStore::Hit hit = { store.getOrder(cached), cached };
+            hits.push_back(hit);
+        }
+    }
+    else if (queryMode == QueryMode::Tree)
+    {
+        queryBroadphase(queryMin, queryMax, [&](int entry)
+        {
+            if (store.mayResolve(entry, query))
+            {
+                CollisionStore::Hit hit = { store.getOrder(entry), entry };
+                hits.push_back(hit);
             }
+        });
+    }
+    else
+    {
+        store.gather(query, queryMode == QueryMode::SimdScan, hits);
+    }
+    std::sort(hits.begin(), hits.end());
+}
+
+bool CollisionManager::lookupSupport(SupportCache* support, const glm::vec3& minW, const glm::vec3& maxW,
+    int& outEntry) const
+{
+    if (!support)
+        return false;
+
+    bool inside = support->valid && support->version == worldVersion &&
+        glm::all(glm::greaterThanEqual(minW, support->regionMin)) &&
+        glm::all(glm::lessThanEqual(maxW, support->regionMax));
+    if (!inside)
+    {
+        support->misses++;
+        return false;
+    }
+    support->hits++;
+    outEntry = support->entry;
+    return true;
+}
+
+void CollisionManager::cacheSupport(SupportCache& support, const glm::vec3& center, float halfSize, int entry) const
+{
+    glm::vec3 queryMin = center - glm::vec3(halfSize);
+    glm::vec3 queryMax = center + glm::vec3(halfSize);
+    if (support.entry == entry && support.version == worldVersion &&
+        glm::all(glm::greaterThanEqual(queryMin, support.regionMin)) &&
+        glm::all(glm::lessThanEqual(queryMax, support.regionMax)))
+        return;
+
+    // fat boxes are never smaller than the packed ones, so if no other fat
+    // box reaches into the region no query inside it can gather anything else
+    glm::vec3 regionMin = queryMin - glm::vec3(SUPPORT_CACHE_SLACK);
+    glm::vec3 regionMax = queryMax + glm::vec3(SUPPORT_CACHE_SLACK);
+    bool alone = true;
+    queryBroadphase(regionMin, regionMax, [&](int other)
+    {
+        if (other != entry)
+            alone = false;
+    });
+
+    support.valid = alone;
+    support.entry = entry;
+    support.version = worldVersion;
+    support.regionMin = regionMin;
+    support.regionMax = regionMax;
+}
+
+bool CollisionManager::resolvePointAgainstEntry(int entry, glm::vec3& point, float eyeHeight, float radius,
+    ContactFace& outFace) const
+{
+    if (store.isOriented(entry))
+    {
+        const CollisionStore::OrientedBox& box = store.getOrientedBox(entry);
+        if (box.mesh)
+            return resolvePointAgainstMesh(*box.mesh, box.model, box.inverseModel, point, eyeHeight, radius, outFace);
+        return resolvePointAgainstOBB(box.model, box.inverseModel, box.localMin, box.localMax,
+            point, eyeHeight, outFace);
+    }
+
+    glm::vec3 minW, maxW;
+    store.getBox(entry, minW, maxW);
+    return resolvePointAgainstAABB(minW, maxW, point, eyeHeight, outFace);
+}
+
+bool CollisionManager::getGroundHeight(float x, float z, float& outHeight, glm::vec3* outNormal) const
+{
+    if (!ground || !ground->contains(x, z))
+        return false;
+
+    outHeight = ground->getHeight(x, z);
+    if (outNormal)
+        *outNormal = ground->getNormal(x, z);
+    return true;
+}
+
+CollisionStore::OrientedBox CollisionManager::getShape(int entry) const
+{
+    if (store.isOriented(entry))
+        return store.getOrientedBox(entry);
+
+    CollisionStore::OrientedBox shape;
+    shape.model = glm::mat4(1.0f);
+    shape.inverseModel = glm::mat4(1.0f);
+    store.getBox(entry, shape.localMin, shape.localMax);
+    shape.mesh = nullptr;
+    return shape;
+}
+
+bool CollisionManager::bakeDistanceField(const std::string& cachePath, float cellSize, float bandWidth)
+{
+    // in registration order, so the same world always gives the same cache key
+    std::vector<CollisionStore::Hit> statics;
+    for (const auto& pair : proxies)
+    {
+        const Proxy& proxy = pair.second;
+        if (proxy.isStatic && store.getLayers(proxy.entry) != 0)
+        {
+            CollisionStore::Hit hit = { store.getOrder(proxy.entry), proxy.entry };
+            statics.push_back(hit);
         }
     }
+    std::sort(statics.begin(), statics.end());
 
-    return anyResolved;
+    std::vector<CollisionStore::OrientedBox> shapes;
+    for (const CollisionStore::Hit& hit : statics)
+        shapes.push_back(getShape(hit.entry));
+    return distanceField.loadOrBake(cachePath, shapes, cellSize, bandWidth);
 }
 
-bool CollisionManager::resolvePoint(const ICollidable* collidable, glm::vec3& point, float eyeHeight)
+float CollisionManager::getDistance(const glm::vec3& point) const
+{
+    float distance;
+    if (!distanceField.empty())
+    {
+        distance = distanceField.getDistance(point);
+    }
+    else
+    {
+        distance = DISTANCE_BAND;
+        glm::vec3 band(DISTANCE_BAND);
+        queryBroadphase(point - band, point + band, [&](int entry)
+        {
+            if (store.getLayers(entry) != 0)
+                distance = std::min(distance, DistanceField::getShapeDistance(getShape(entry), point, DISTANCE_BAND));
+        });
+    }
+
+    // to the ground's tangent plane under the point
+    glm::vec3 groundNormal;
+    float groundY;
+    if (getGroundHeight(point.x, point.z, groundY, &groundNormal))
+        distance = std::min(distance, (point.y - groundY) * groundNormal.y);
+    return distance;
+}
+
+glm::vec3 CollisionManager::getDistanceGradient(const glm::vec3& point) const
+{
+    float h = (distanceField.empty() ? DISTANCE_CELL_SIZE : distanceField.getCellSize()) * 0.5f;
+    glm::vec3 gradient(
+        getDistance(point + glm::vec3(h, 0.0f, 0.0f)) - getDistance(point - glm::vec3(h, 0.0f, 0.0f)),
+        getDistance(point + glm::vec3(0.0f, h, 0.0f)) - getDistance(point - glm::vec3(0.0f, h, 0.0f)),
+        getDistance(point + glm::vec3(0.0f, 0.0f, h)) - getDistance(point - glm::vec3(0.0f, 0.0f, h)));
+    float length = glm::length(gradient);
+    return length > 1e-6f ? gradient / length : glm::vec3(0.0f);
+}
+
+bool CollisionManager::resolvePointAgainstGround(glm::vec3& point, float eyeHeight, ContactFace& outFace) const
+{
+    outFace = ContactFace::None;
+
+    float groundY;
+    if (!getGroundHeight(point.x, point.z, groundY))
+        return false;
+
+    // same landing rule as the top of a platform, but there is no underside:
+    // anything below the surface is pushed back up
+    float feetY = point.y - eyeHeight;
+    if (feetY < groundY + collisionMargin)
+    {
+        point.y = groundY + eyeHeight + collisionMargin;
+        outFace = ContactFace::Top;
+        return true;
+    }
+    return false;
+}
+
+bool CollisionManager::resolvePoint(const ICollidable* collidable, glm::vec3& point, float eyeHeight) const
 {
     if (!collidable || !collidable->isCollisionEnabled())
         return false;
 
     ContactFace face;
 
-    if (collidable->usesOBBCollision())
+    if (const TriangleBVH* mesh = collidable->getCollisionMesh())
+    {
+        return resolvePointAgainstMesh(*mesh, collidable->getModelMatrix(), collidable->getInverseModelMatrix(),
+            point, eyeHeight, DEFAULT_CAPSULE_RADIUS, face);
+    }
+    else if (collidable->usesOBBCollision())
     {
         return resolvePointAgainstOBB(collidable, point, eyeHeight, face);
     }
@@ -140,7 +930,7 @@ bool CollisionManager::resolvePoint(const ICollidable* collidable, glm::vec3& po
 }
 
 bool CollisionManager::resolvePointAgainstAABB(const glm::vec3& minW, const glm::vec3& maxW,
-    glm::vec3& point, float eyeHeight, ContactFace& outFace)
+    glm::vec3& point, float eyeHeight, ContactFace& outFace) const
 {
     outFace = ContactFace::None;
 
@@ -228,13 +1018,20 @@ bool CollisionManager::resolvePointAgainstAABB(const glm::vec3& minW, const glm:
 }
 
 bool CollisionManager::resolvePointAgainstOBB(const ICollidable* collidable,
-    glm::vec3& point, float eyeHeight, ContactFace& outFace)
+    glm::vec3& point, float eyeHeight, ContactFace& outFace) const
 {
-    outFace = ContactFace::None;
+    // the model matrix and its inverse are cached by the collidable
+    glm::vec3 localMin, localMax;
+    collidable->getLocalBounds(localMin, localMax);
+    return resolvePointAgainstOBB(collidable->getModelMatrix(), collidable->getInverseModelMatrix(),
+        localMin, localMax, point, eyeHeight, outFace);
+}
 
-    // get the model matrix and its inverse
-    glm::mat4 model = collidable->getModelMatrix();
-    glm::mat4 invModel = glm::inverse(model);
+bool CollisionManager::resolvePointAgainstOBB(const glm::mat4& model, const glm::mat4& invModel,
+    const glm::vec3& localMin, const glm::vec3& localMax,
+    glm::vec3& point, float eyeHeight, ContactFace& outFace) const
+{
+    outFace = ContactFace::None;
 
     // transform player points to local space
     glm::vec3 feetWorld = point - glm::vec3(0.0f, eyeHeight, 0.0f);
@@ -245,10 +1042,6 @@ bool CollisionManager::resolvePointAgainstOBB(const ICollidable* collidable,
     glm::vec3 localPoint(localPoint4.x, localPoint4.y, localPoint4.z);
     glm::vec3 localFeet(localFeet4.x, localFeet4.y, localFeet4.z);
 
-    // get local bounds (unrotated mesh bounds)
-    glm::vec3 localMin, localMax;
-    collidable->getLocalBounds(localMin, localMax);
-
     // quick rejection test - are we even near the object?
     float maxDist = glm::length(localMax - localMin) * 0.5f + 2.0f;
     glm::vec3 center = (localMin + localMax) * 0.5f;
@@ -327,6 +1120,43 @@ bool CollisionManager::resolvePointAgainstOBB(const ICollidable* collidable,
     return resolved;
 }
 
+bool CollisionManager::resolvePointAgainstMesh(const TriangleBVH& mesh, const glm::mat4& model, const glm::mat4& invModel,
+    glm::vec3& point, float eyeHeight, float radius, ContactFace& outFace) const
+{
+    const int ITERATIONS = 4;
+    // pushed a hair further than the contact, so the next pass doesn't
+    // find the same triangle again through rounding
+    const float SKIN = 0.001f;
+
+    outFace = ContactFace::None;
+    bool resolved = false;
+
+    for (int iteration = 0; iteration < ITERATIONS; iteration++)
+    {
+        // the bottom sphere rests on the feet, the top one is centered on the eye
+        glm::vec3 bottom = point - glm::vec3(0.0f, std::max(eyeHeight - radius, 0.0f), 0.0f);
+        TriangleBVH::Contact contact;
+        if (!mesh.collideCapsule(model, invModel, bottom, point, radius, contact))
+            break;
+
+        point += contact.normal * (contact.depth + collisionMargin + SKIN);
+        resolved = true;
+
+        // the same faces the box resolve reports, from the push direction
+        glm::vec3 n = contact.normal;
+        if (n.y > 0.7f)
+            outFace = ContactFace::Top;
+        else if (n.y < -0.7f)
+            outFace = ContactFace::Bottom;
+        else if (fabsf(n.x) > fabsf(n.z))
+            outFace = n.x < 0.0f ? ContactFace::Left : ContactFace::Right;
+        else
+            outFace = n.z < 0.0f ? ContactFace::Back : ContactFace::Front;
+    }
+
+    return resolved;
+}
+
 bool CollisionManager::isPointInsideAABB(const ICollidable* collidable, const glm::vec3& point) const
 {
     if (!collidable)
@@ -4,6 +4,22 @@
 #include <vector>
 #include <algorithm>
 #include <cstdio>
+#include <unordered_map>
+#include "heightfield.h"
+#include "aabbTree.h"
+#include "staticBVH.h"
+#include "collisionStore.h"
+#include "distanceField.h"
+#include "triangleBVH.h"
+
+// Collision layers, a query only resolves against the layers in its filter mask
+enum CollisionLayer : unsigned
+{
+    COLLISION_LAYER_WORLD = 1u << 0,    // platforms, walls, mountains
+    COLLISION_LAYER_HAZARD = 1u << 1,   // spikes
+    COLLISION_LAYER_GROUND = 1u << 2,   // the heightfield
+    COLLISION_LAYER_ALL = ~0u
+};
 
 // Interface for any object that can participate in collision detection
 class ICollidable
@@ -23,6 +39,13 @@ public:
     // Get the model matrix for OBB collision
     virtual glm::mat4 getModelMatrix() const { return glm::mat4(1.0f); }
 
+    // Inverse of the model matrix, objects that cache it should override this
+    virtual glm::mat4 getInverseModelMatrix() const { return glm::inverse(getModelMatrix()); }
+
+    // Recompute cached transforms/bounds after the object moved.
+    // Returns true if anything changed since the last call.
+    virtual bool updateTransform() { return false; }
+
     // Get local (unrotated) bounds
     virtual void getLocalBounds(glm::vec3& outMin, glm::vec3& outMax) const {
         getWorldAABB(outMin, outMax);  // Default: same as world AABB
@@ -31,8 +54,17 @@ public:
     // Check if this object uses OBB collision
     virtual bool usesOBBCollision() const { return false; }
 
+    // Triangles to collide against instead of the box, in model space
+    // (not owned, null to collide as a box)
+    virtual const TriangleBVH* getCollisionMesh() const { return nullptr; }
+
     // Check if this object is a hazard (for damage calculation, etc.)
     virtual bool isHazard() const { return false; }  // Default: not a hazard
+
+    // Layers this object is in (COLLISION_LAYER_*)
+    virtual unsigned getCollisionLayers() const {
+        return isHazard() ? COLLISION_LAYER_HAZARD : COLLISION_LAYER_WORLD;
+    }
 };
 
 
@@ -42,35 +74,246 @@ class CollisionManager
 public:
     enum class ContactFace { None, Top, Bottom, Left, Right, Front, Back };
 
+    // How resolvePointAgainstAll finds the collidables near the point: the
+    // AABB tree, or a scan of every packed box, four per SSE op or one by one
+    enum class QueryMode { Tree, SimdScan, ScalarScan };
+
+    // Static collidables are read once and compiled into an immutable tree
+    // that update() never looks at again; moving one, or switching its
+    // collision, needs an updateCollidable() that builds the tree again.
+    // Dynamic ones sit in the refitting AABB tree and are checked every update().
+    enum class Mobility { Dynamic, Static };
+
     // Struct to hold collision info
     struct CollisionInfo
     {
-        ICollidable* collidable;
+        ICollidable* collidable;    // null for the ground
         ContactFace face;
         glm::vec3 resolvedPosition;
+        glm::vec3 normal;           // world normal of the face
 
-        CollisionInfo() : collidable(nullptr), face(ContactFace::None), resolvedPosition(0.0f) {}
+        CollisionInfo() : collidable(nullptr), face(ContactFace::None), resolvedPosition(0.0f), normal(0.0f) {}
     };
 
+    // Collision meshes see the player as a capsule this wide around the
+    // feet-to-eye segment, boxes still see a point
+    static constexpr float DEFAULT_CAPSULE_RADIUS = 0.5f;
+
+    // Memory of what an entity last stood on (a collidable or the ground),
+    // kept by the entity and handed to its queries. The region around it was
+    // checked to hold no other collidable, so while a query stays inside the
+    // region it skips the broadphase and only looks at the support. Anything
+    // added, removed, moved or switched on or off in the world invalidates it.
+    struct SupportCache
+    {
+        bool valid;
+        int entry;              // store entry of the support, -1 for the ground
+        unsigned version;       // the world version it was made in
+        glm::vec3 regionMin;
+        glm::vec3 regionMax;
+        unsigned hits;          // broadphase lookups skipped
+        unsigned misses;
+
+        SupportCache() : valid(false), entry(-1), version(0), regionMin(0.0f), regionMax(0.0f), hits(0), misses(0) {}
+
+        float getHitRate() const { return hits + misses > 0 ? (float)hits / (hits + misses) : 0.0f; }
+    };
+
+    // How far an entity can move from where its support was cached before
+    // the region has to be rebuilt
+    static constexpr float SUPPORT_CACHE_SLACK = 4.0f;
+
+    // A player-like point for resolvePoints(): the eye at point, the feet
+    // eyeHeight below it, resolved only against the layers in filterMask.
+    // support is the entity's own cache, or null.
+    struct Query
+    {
+        glm::vec3 point;
+        float eyeHeight;
+        float radius;
+        unsigned filterMask;
+        SupportCache* support;
+
+        Query() : point(0.0f), eyeHeight(0.0f), radius(DEFAULT_CAPSULE_RADIUS), filterMask(COLLISION_LAYER_ALL),
+            support(nullptr) {}
+        Query(const glm::vec3& point, float eyeHeight, unsigned filterMask = COLLISION_LAYER_ALL,
+            float radius = DEFAULT_CAPSULE_RADIUS, SupportCache* support = nullptr)
+            : point(point), eyeHeight(eyeHeight), radius(radius), filterMask(filterMask), support(support) {}
+    };
+
+    // Every face a query touched, one entry per collidable and face
+    static const int MAX_CONTACTS = 8;
+
+    struct QueryResult
+    {
+        glm::vec3 position;         // the resolved point
+        bool resolved;              // anything moved it
+        CollisionInfo lastCollision;
+        int candidates;             // collidables the narrow phase looked at
+        CollisionInfo contacts[MAX_CONTACTS];
+        int contactCount;
+
+        QueryResult() : position(0.0f), resolved(false), candidates(0), contactCount(0) {}
+
+        // a contact of the same collidable and face replaces the older one,
+        // past MAX_CONTACTS new ones are dropped
+        void addContact(const CollisionInfo& contact)
+        {
+            for (int i = 0; i < contactCount; i++)
+            {
+                if (contacts[i].collidable == contact.collidable && contacts[i].face == contact.face)
+                {
+                    contacts[i] = contact;
+                    return;
+                }
+            }
+            if (contactCount < MAX_CONTACTS)
+                contacts[contactCount++] = contact;
+        }
+
+        bool touches(ContactFace face) const
+        {
+            for (int i = 0; i < contactCount; i++)
+                if (contacts[i].face == face)
+                    return true;
+            return false;
+        }
+
+        // the first hazard touched, null if none
+        const CollisionInfo* findHazard() const
+        {
+            for (int i = 0; i < contactCount; i++)
+                if (contacts[i].collidable && contacts[i].collidable->isHazard())
+                    return &contacts[i];
+            return nullptr;
+        }
+    };
+
+    // First contact of a query moving along a motion, see sweepCapsule()
+    struct SweepHit
+    {
+        float time;                 // fraction of the motion, 0 to 1
+        glm::vec3 position;         // the eye at the time of impact
+        glm::vec3 normal;           // out of the surface that was hit
+        CollisionInfo contact;      // the narrow phase's resolve of the impact
+
+        SweepHit() : time(1.0f), position(0.0f), normal(0.0f) {}
+    };
+
+    // First thing a raycast() or sphereCast() hits
+    struct RayHit
+    {
+        float distance;             // along the cast, 0 if it starts inside
+        glm::vec3 point;            // origin + direction * distance
+        glm::vec3 normal;           // of the surface, against the cast
+        ICollidable* collidable;    // null for the ground
+
+        RayHit() : distance(0.0f), point(0.0f), normal(0.0f), collidable(nullptr) {}
+    };
+
+    // Sweeps test the motion every SWEEP_STEP units and bisect the first
+    // step that hits, so nothing thicker than this can be passed through
+    static constexpr float SWEEP_STEP = 0.25f;
+    static constexpr int DEFAULT_SLIDE_ITERATIONS = 4;
+
+    // Distance field cells, and how far from a surface it stays exact
+    static constexpr float DISTANCE_CELL_SIZE = 2.0f;
+    static constexpr float DISTANCE_BAND = 4.0f;
+
     CollisionManager();
     ~CollisionManager();
 
-    // Register a collidable object with the manager
-    void addCollidable(ICollidable* collidable);
+    // Register a collidable object with the manager. Static ones wait in the
+    // dynamic tree until the next buildStaticTree() or update().
+    void addCollidable(ICollidable* collidable, Mobility mobility = Mobility::Dynamic);
 
-    // Remove a collidable object from the manager
+    // Remove a collidable object from the manager, in constant time for a
+    // dynamic one. Removing a static one builds the static tree again.
     void removeCollidable(ICollidable* collidable);
 
+    // Refit a collidable that moved, rotated or scaled since it was added.
+    // Cheap for a dynamic one while it stays inside its fat broadphase box,
+    // a static one builds the static tree again.
+    void updateCollidable(ICollidable* collidable);
+
+    // Moves the static collidables added since the last build out of the
+    // dynamic tree and builds the static tree over all of them
+    void buildStaticTree();
+
+    // Per-tick pass before any query: builds the static tree if statics were
+    // added, refreshes the cached transforms of the dynamic collidables that
+    // moved and refits them in the broadphase
+    void update();
+
     // Clear all registered collidables
     void clearAll();
 
+    // Ground heightfield, resolved after the collidables (may be null, not owned)
+    void setHeightfield(const Heightfield* heightfield) { ground = heightfield; }
+    const Heightfield* getHeightfield() const { return ground; }
+
+    // Constant-time ground query under (x, z), false if there is no ground there
+    bool getGroundHeight(float x, float z, float& outHeight, glm::vec3* outNormal = nullptr) const;
+
     // Resolve a point against ALL registered collidables
     // Returns true if any collision was resolved
     bool resolvePointAgainstAll(glm::vec3& point, float eyeHeight);
 
+    // Resolve count queries, results[i] for queries[i]. Const and reentrant:
+    // any number of threads may resolve batches at once, as long as nothing
+    // adds, removes or updates collidables meanwhile.
+    void resolvePoints(const Query* queries, size_t count, QueryResult* results) const;
+    QueryResult resolvePoint(const Query& query) const;
+
+    // Earliest contact of the query moving from query.point by motion, with
+    // its time of impact and normal. Only the collidables are swept (the
+    // heightfield pushes anything below it back up, it can't be tunnelled),
+    // and one the query already starts in is left to the resolve. False if
+    // the whole motion is free. Always goes through the broadphase tree.
+    bool sweepCapsule(const Query& query, const glm::vec3& motion, SweepHit& outHit) const;
+
+    // First collidable (or the ground) in the layers of filterMask along
+    // origin + direction * [0, maxDistance], through the broadphase tree.
+    // direction doesn't have to be unit length.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, RayHit& outHit,
+        unsigned filterMask = COLLISION_LAYER_ALL, SupportCache* support = nullptr) const;
+
+    // The same with a sphere. Boxes are grown by the radius (a little
+    // conservative around their edges), meshes are stepped a radius at a
+    // time, the ground is probed under the sphere's lowest point.
+    bool sphereCast(const glm::vec3& origin, float radius, const glm::vec3& direction, float maxDistance,
+        RayHit& outHit, unsigned filterMask = COLLISION_LAYER_ALL, SupportCache* support = nullptr) const;
+
+    // Moves query.point by motion without passing through anything: stops at
+    // each contact, resolves it like resolvePoint() would and slides the rest
+    // of the motion along the surface, at most maxIterations times, then
+    // resolves the end point. Touching a hazard ends the move. Const and
+    // reentrant like resolvePoints().
+    QueryResult moveCapsule(const Query& query, const glm::vec3& motion,
+        int maxIterations = DEFAULT_SLIDE_ITERATIONS) const;
+
+    // Bakes the distance field of the static collidables registered now on
+    // every core, or reads it from cachePath if it was baked from
+    // the same world, and writes it there otherwise. True if it was read.
+    // Bake again after changing the world, clearAll() drops it.
+    bool bakeDistanceField(const std::string& cachePath, float cellSize = DISTANCE_CELL_SIZE,
+        float bandWidth = DISTANCE_BAND);
+
+    // Approximate distance from point to the nearest solid (the baked
+    // collidables and the ground), negative inside. Anything past the band
+    // only means "at least that far". Without a baked field the collidables
+    // near the point are measured exactly, which costs a broadphase query.
+    float getDistance(const glm::vec3& point) const;
+
+    // Unit direction away from the nearest solid, zero where nothing is
+    // within the band
+    glm::vec3 getDistanceGradient(const glm::vec3& point) const;
+
+    const DistanceField& getDistanceField() const { return distanceField; }
+
     // Resolve a point against a single collidable object
     // Returns true if collision was resolved
-    bool resolvePoint(const ICollidable* collidable, glm::vec3& point, float eyeHeight);
+    bool resolvePoint(const ICollidable* collidable, glm::vec3& point, float eyeHeight) const;
 
     // Get info about the last collision that occurred
     const CollisionInfo& getLastCollisionInfo() const { return lastCollision; }
@@ -88,17 +331,127 @@ public:
     // Helper to convert ContactFace to string for debugging
     static const char* faceToString(ContactFace face);
 
+    void setQueryMode(QueryMode mode) { queryMode = mode; }
+    QueryMode getQueryMode() const { return queryMode; }
+
+    // Registered collidables, in registration order until one is removed
+    // (the last one takes its place)
+    const std::vector<ICollidable*>& getCollidables() const { return collidables; }
+
+    // Broadphase stats for the HUD
+    int getBroadphaseHeight() const { return broadphase.getHeight(); }
+    int getStaticTreeHeight() const { return staticTree.getHeight(); }
+    int getStaticCount() const { return (int)staticTree.getItemCount(); }
+    int getLastCandidateCount() const { return lastCandidateCount; }
+
 private:
+    // broadphase leaf and packed store entry of a collidable
+    struct Proxy
+    {
+        int node;       // in the dynamic tree, NULL_NODE once in the static one
+        int entry;
+        int index;      // in collidables
+        bool isStatic;
+    };
+
     std::vector<ICollidable*> collidables;
+    std::unordered_map<const ICollidable*, Proxy> proxies;
+    AABBTree broadphase;        // dynamic collidables, and statics not built in yet
+    StaticBVH staticTree;
+    bool staticTreeDirty;       // statics are waiting in the dynamic tree
+    CollisionStore store;
+    QueryMode queryMode;
+    unsigned nextOrder;
+    unsigned worldVersion;      // bumped by every change support caches depend on
+    std::vector<CollisionStore::Hit> hitScratch;   // for resolvePointAgainstAll
+    int lastCandidateCount;
+    DistanceField distanceField;
+    const Heightfield* ground;
     float collisionMargin;
     bool debugOutput;
     CollisionInfo lastCollision;
 
     // Internal helper to resolve point against an AABB
     bool resolvePointAgainstAABB(const glm::vec3& minW, const glm::vec3& maxW,
-        glm::vec3& point, float eyeHeight, ContactFace& outFace);
+        glm::vec3& point, float eyeHeight, ContactFace& outFace) const;
+
+    // The whole query, hits is the caller's scratch list
+    void resolveQuery(const Query& query, QueryResult& result, std::vector<CollisionStore::Hit>& hits) const;
+
+    // Store entries after query.afterOrder that can move the point, sorted
+    // by registration order
+    void gatherHits(const CollisionStore::PointQuery& query, SupportCache* support,
+        std::vector<CollisionStore::Hit>& hits) const;
+
+    // True if [minW, maxW] is inside the cached region, outEntry is then
+    // the only collidable there (-1 for none). False if the caller has to
+    // ask the broadphase. Counts the cache's hits and misses.
+    bool lookupSupport(SupportCache* support, const glm::vec3& minW, const glm::vec3& maxW, int& outEntry) const;
+
+    // Makes entry (-1 for the ground), just found under a query reaching
+    // halfSize around center, the cached support if no other collidable is
+    // near enough. Does nothing if it was already tried there.
+    void cacheSupport(SupportCache& support, const glm::vec3& center, float halfSize, int entry) const;
+
+    // Both broadphase trees: visit(entry) for every collidable whose box
+    // overlaps [minW, maxW], or that the cast passes (visit returns the
+    // distance to clip the cast to)
+    template <typename Visitor>
+    void queryBroadphase(const glm::vec3& minW, const glm::vec3& maxW, Visitor&& visit) const
+    {
+        staticTree.query(minW, maxW, visit);
+        broadphase.query(minW, maxW, [&](int node) { visit(broadphase.getUserData(node)); });
+    }
+
+    template <typename Visitor>
+    void raycastBroadphase(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float radius,
+        Visitor&& visit) const
+    {
+        staticTree.raycast(origin, direction, maxDistance, radius, [&](int entry)
+        {
+            maxDistance = visit(entry);
+            return maxDistance;
+        });
+        broadphase.raycast(origin, direction, maxDistance, radius, [&](int node) { return visit(broadphase.getUserData(node)); });
+    }
+
+    // The packed shape of a store entry, AABBs with identity matrices
+    CollisionStore::OrientedBox getShape(int entry) const;
+
+    // Narrow phase against the packed copy of one store entry
+    bool resolvePointAgainstEntry(int entry, glm::vec3& point, float eyeHeight, float radius,
+        ContactFace& outFace) const;
+
+    // Time of impact of one entry along a sweep, tested at samples evenly
+    // spaced steps. False if it's never hit, only hit after limit, or
+    // already hit at the start.
+    bool sweepEntry(int entry, const Query& query, const glm::vec3& motion, int samples, float limit,
+        float& outTime) const;
+
+    // raycast() and sphereCast(), direction is unit length
+    bool cast(const glm::vec3& origin, float radius, const glm::vec3& direction, float maxDistance,
+        unsigned filterMask, SupportCache* support, RayHit& outHit) const;
+
+    // A cast against one store entry, false if it misses within maxDistance
+    bool castAgainstEntry(int entry, const glm::vec3& origin, float radius, const glm::vec3& direction,
+        float maxDistance, float& outDistance, glm::vec3& outNormal) const;
+
+    // World normal of the face a resolve reported, push is how far it moved
+    // the point (meshes report no box face)
+    glm::vec3 contactNormal(int entry, ContactFace face, const glm::vec3& push) const;
+
+    // Capsule around the feet-to-eye segment against a triangle mesh, pushed
+    // out of the deepest contact a few times
+    bool resolvePointAgainstMesh(const TriangleBVH& mesh, const glm::mat4& model, const glm::mat4& invModel,
+        glm::vec3& point, float eyeHeight, float radius, ContactFace& outFace) const;
+
+    // Keeps the feet on or above the heightfield
+    bool resolvePointAgainstGround(glm::vec3& point, float eyeHeight, ContactFace& outFace) const;
 
     // OBB collision check
     bool resolvePointAgainstOBB(const ICollidable* collidable,
-        glm::vec3& point, float eyeHeight, ContactFace& outFace);
+        glm::vec3& point, float eyeHeight, ContactFace& outFace) const;
+    bool resolvePointAgainstOBB(const glm::mat4& model, const glm::mat4& invModel,
+        const glm::vec3& localMin, const glm::vec3& localMax,
+        glm::vec3& point, float eyeHeight, ContactFace& outFace) const;
 };
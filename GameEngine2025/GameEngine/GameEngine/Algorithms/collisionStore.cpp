@@ -0,0 +1,367 @@
+#include "collisionStore.h"
+#include "collision.h"
+#include <emmintrin.h>
+#include <limits>
+
+namespace
+{
+    const float EMPTY_MIN = std::numeric_limits<float>::infinity();
+    const float EMPTY_MAX = -std::numeric_limits<float>::infinity();
+
+    // meshes are placed by their model matrix like OBBs
+    bool isOrientedShape(const ICollidable* collidable)
+    {
+        return collidable->usesOBBCollision() || collidable->getCollisionMesh() != nullptr;
+    }
+
+    // a disabled collidable is in no layer, so no filter matches it
+    unsigned laneLayers(const ICollidable* collidable)
+    {
+        return collidable->isCollisionEnabled() ? collidable->getCollisionLayers() : 0;
+    }
+}
+
+size_t CollisionStore::Lanes::push()
+{
+    size_t lane = count++;
+    if (lane >= minX.size())
+    {
+        size_t padded = minX.size() + 4;
+        minX.resize(padded); minY.resize(padded); minZ.resize(padded);
+        maxX.resize(padded); maxY.resize(padded); maxZ.resize(padded);
+        layers.resize(padded);
+        order.resize(padded);
+        entry.resize(padded);
+        for (size_t i = lane; i < padded; i++)
+            setEmpty(i);
+    }
+    return lane;
+}
+
+// an empty box fails every overlap compare, so padding needs no tail loop
+void CollisionStore::Lanes::setEmpty(size_t lane)
+{
+    minX[lane] = minY[lane] = minZ[lane] = EMPTY_MIN;
+    maxX[lane] = maxY[lane] = maxZ[lane] = EMPTY_MAX;
+    layers[lane] = 0;
+    order[lane] = 0;
+    entry[lane] = -1;
+}
+
+void CollisionStore::Lanes::move(size_t from, size_t to)
+{
+    minX[to] = minX[from]; minY[to] = minY[from]; minZ[to] = minZ[from];
+    maxX[to] = maxX[from]; maxY[to] = maxY[from]; maxZ[to] = maxZ[from];
+    layers[to] = layers[from];
+    order[to] = order[from];
+    entry[to] = entry[from];
+}
+
+void CollisionStore::Lanes::clear()
+{
+    minX.clear(); minY.clear(); minZ.clear();
+    maxX.clear(); maxY.clear(); maxZ.clear();
+    layers.clear();
+    order.clear();
+    entry.clear();
+    count = 0;
+}
+
+CollisionStore::CollisionStore()
+    : freeEntry(-1)
+{
+}
+
+void CollisionStore::clear()
+{
+    entries.clear();
+    freeEntry = -1;
+    boxes.clear();
+    oriented.clear();
+    orientedBoxes.clear();
+}
+
+int CollisionStore::add(ICollidable* collidable, unsigned order)
+{
+    int index;
+    if (freeEntry != -1)
+    {
+        index = freeEntry;
+        freeEntry = entries[index].lane;
+    }
+    else
+    {
+        index = (int)entries.size();
+        entries.push_back(Entry());
+    }
+
+    Entry& entry = entries[index];
+    entry.collidable = collidable;
+    entry.order = order;
+    entry.oriented = isOrientedShape(collidable);
+
+    Lanes& lanes = entry.oriented ? oriented : boxes;
+    entry.lane = (int)lanes.push();
+    if (entry.oriented)
+        orientedBoxes.resize(lanes.minX.size());
+
+    write(index);
+    return index;
+}
+
+void CollisionStore::remove(int index)
+{
+    Entry& entry = entries[index];
+    Lanes& lanes = entry.oriented ? oriented : boxes;
+
+    // the last live lane fills the hole
+    size_t lane = (size_t)entry.lane;
+    size_t last = lanes.count - 1;
+    if (lane != last)
+    {
+        lanes.move(last, lane);
+        entries[lanes.entry[lane]].lane = (int)lane;
+        if (entry.oriented)
+            orientedBoxes[lane] = orientedBoxes[last];
+    }
+    lanes.setEmpty(last);
+    lanes.count--;
+
+    entry.collidable = nullptr;
+    entry.lane = freeEntry;
+    freeEntry = index;
+}
+
+void CollisionStore::refresh(int index)
+{
+    Entry& entry = entries[index];
+    if (isOrientedShape(entry.collidable) != entry.oriented)
+    {
+        // switched between box and OBB collision, change partitions. The
+        // free list hands the same entry id straight back.
+        ICollidable* collidable = entry.collidable;
+        unsigned order = entry.order;
+        remove(index);
+        add(collidable, order);
+        return;
+    }
+    write(index);
+}
+
+bool CollisionStore::refreshFlags(int index)
+{
+    const Entry& entry = entries[index];
+    if (isOrientedShape(entry.collidable) != entry.oriented)
+    {
+        refresh(index);
+        return true;
+    }
+    Lanes& lanes = entry.oriented ? oriented : boxes;
+    unsigned layers = laneLayers(entry.collidable);
+    if (lanes.layers[entry.lane] == layers)
+        return false;
+    lanes.layers[entry.lane] = layers;
+    return true;
+}
+
+void CollisionStore::write(int index)
+{
+    const Entry& entry = entries[index];
+    ICollidable* collidable = entry.collidable;
+    Lanes& lanes = entry.oriented ? oriented : boxes;
+    size_t lane = (size_t)entry.lane;
+
+    glm::vec3 minW, maxW;
+    collidable->getWorldAABB(minW, maxW);
+    lanes.minX[lane] = minW.x; lanes.minY[lane] = minW.y; lanes.minZ[lane] = minW.z;
+    lanes.maxX[lane] = maxW.x; lanes.maxY[lane] = maxW.y; lanes.maxZ[lane] = maxW.z;
+    lanes.layers[lane] = laneLayers(collidable);
+    lanes.order[lane] = entry.order;
+    lanes.entry[lane] = index;
+
+    if (entry.oriented)
+    {
+        OrientedBox& box = orientedBoxes[lane];
+        box.model = collidable->getModelMatrix();
+        box.inverseModel = collidable->getInverseModelMatrix();
+        collidable->getLocalBounds(box.localMin, box.localMax);
+        box.mesh = collidable->getCollisionMesh();
+    }
+}
+
+void CollisionStore::getBox(int index, glm::vec3& outMin, glm::vec3& outMax) const
+{
+    const Entry& entry = entries[index];
+    const Lanes& lanes = entry.oriented ? oriented : boxes;
+    size_t lane = (size_t)entry.lane;
+    outMin = glm::vec3(lanes.minX[lane], lanes.minY[lane], lanes.minZ[lane]);
+    outMax = glm::vec3(lanes.maxX[lane], lanes.maxY[lane], lanes.maxZ[lane]);
+}
+
+unsigned CollisionStore::getLayers(int index) const
+{
+    const Entry& entry = entries[index];
+    const Lanes& lanes = entry.oriented ? oriented : boxes;
+    return lanes.layers[entry.lane];
+}
+
+// Same conditions as CollisionManager::resolvePointAgainstAABB, so a box
+// that passes is always resolved
+bool CollisionStore::boxResolves(const Lanes& lanes, size_t lane, const PointQuery& query)
+{
+    if (!(lanes.layers[lane] & query.filter))
+        return false;
+
+    const glm::vec3& p = query.point;
+    bool insideXZ = p.x >= lanes.minX[lane] && p.x <= lanes.maxX[lane] &&
+        p.z >= lanes.minZ[lane] && p.z <= lanes.maxZ[lane];
+    if (!insideXZ)
+        return false;
+
+    float feetY = p.y - query.eyeHeight;
+    float headY = p.y;
+    float topY = lanes.maxY[lane];
+    float bottomY = lanes.minY[lane];
+    return (feetY < topY + query.margin && headY > topY + query.margin) ||
+        (headY > bottomY && feetY < bottomY) ||
+        (feetY < topY && headY > bottomY);
+}
+
+bool CollisionStore::boxTouchesReach(const Lanes& lanes, size_t lane, const PointQuery& query)
+{
+    if (!(lanes.layers[lane] & query.filter))
+        return false;
+
+    glm::vec3 minQ = query.point - glm::vec3(query.reach);
+    glm::vec3 maxQ = query.point + glm::vec3(query.reach);
+    return lanes.minX[lane] <= maxQ.x && lanes.maxX[lane] >= minQ.x &&
+        lanes.minY[lane] <= maxQ.y && lanes.maxY[lane] >= minQ.y &&
+        lanes.minZ[lane] <= maxQ.z && lanes.maxZ[lane] >= minQ.z;
+}
+
+bool CollisionStore::mayResolve(int index, const PointQuery& query) const
+{
+    const Entry& entry = entries[index];
+    if (entry.order <= query.afterOrder)
+        return false;
+    if (entry.oriented)
+        return boxTouchesReach(oriented, (size_t)entry.lane, query);
+    return boxResolves(boxes, (size_t)entry.lane, query);
+}
+
+void CollisionStore::gather(const PointQuery& query, bool simd, std::vector<Hit>& out) const
+{
+    if (simd)
+    {
+        gatherBoxesSimd(query, out);
+        gatherOrientedSimd(query, out);
+        return;
+    }
+
+    for (size_t lane = 0; lane < boxes.count; lane++)
+    {
+        if (boxes.order[lane] > query.afterOrder && boxResolves(boxes, lane, query))
+        {
+            Hit hit = { boxes.order[lane], boxes.entry[lane] };
+            out.push_back(hit);
+        }
+    }
+    for (size_t lane = 0; lane < oriented.count; lane++)
+    {
+        if (oriented.order[lane] > query.afterOrder && boxTouchesReach(oriented, lane, query))
+        {
+            Hit hit = { oriented.order[lane], oriented.entry[lane] };
+            out.push_back(hit);
+        }
+    }
+}
+
+void CollisionStore::gatherBoxesSimd(const PointQuery& query, std::vector<Hit>& out) const
+{
+    __m128 px = _mm_set1_ps(query.point.x);
+    __m128 pz = _mm_set1_ps(query.point.z);
+    __m128 feet = _mm_set1_ps(query.point.y - query.eyeHeight);
+    __m128 head = _mm_set1_ps(query.point.y);
+    __m128 margin = _mm_set1_ps(query.margin);
+    __m128i filter = _mm_set1_epi32((int)query.filter);
+    __m128i zero = _mm_setzero_si128();
+
+    size_t padded = boxes.minX.size();
+    for (size_t i = 0; i < padded; i += 4)
+    {
+        __m128 minX = _mm_loadu_ps(&boxes.minX[i]);
+        __m128 maxX = _mm_loadu_ps(&boxes.maxX[i]);
+        __m128 minZ = _mm_loadu_ps(&boxes.minZ[i]);
+        __m128 maxZ = _mm_loadu_ps(&boxes.maxZ[i]);
+        __m128 bottom = _mm_loadu_ps(&boxes.minY[i]);
+        __m128 top = _mm_loadu_ps(&boxes.maxY[i]);
+        __m128i layers = _mm_and_si128(_mm_loadu_si128((const __m128i*)&boxes.layers[i]), filter);
+        __m128 filtered = _mm_castsi128_ps(_mm_cmpeq_epi32(layers, zero));
+
+        __m128 insideXZ = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(px, minX), _mm_cmple_ps(px, maxX)),
+            _mm_and_ps(_mm_cmpge_ps(pz, minZ), _mm_cmple_ps(pz, maxZ)));
+
+        // the landing, ceiling and side cases of the scalar resolve
+        __m128 topMargin = _mm_add_ps(top, margin);
+        __m128 landing = _mm_and_ps(_mm_cmplt_ps(feet, topMargin), _mm_cmpgt_ps(head, topMargin));
+        __m128 ceiling = _mm_and_ps(_mm_cmpgt_ps(head, bottom), _mm_cmplt_ps(feet, bottom));
+        __m128 side = _mm_and_ps(_mm_cmplt_ps(feet, top), _mm_cmpgt_ps(head, bottom));
+        __m128 vertical = _mm_or_ps(_mm_or_ps(landing, ceiling), side);
+
+        int mask = _mm_movemask_ps(_mm_andnot_ps(filtered, _mm_and_ps(insideXZ, vertical)));
+        while (mask)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane)))
+                lane++;
+            mask &= mask - 1;
+
+            if (boxes.order[i + lane] > query.afterOrder)
+            {
+                Hit hit = { boxes.order[i + lane], boxes.entry[i + lane] };
+                out.push_back(hit);
+            }
+        }
+    }
+}
+
+void CollisionStore::gatherOrientedSimd(const PointQuery& query, std::vector<Hit>& out) const
+{
+    __m128 minQX = _mm_set1_ps(query.point.x - query.reach);
+    __m128 minQY = _mm_set1_ps(query.point.y - query.reach);
+    __m128 minQZ = _mm_set1_ps(query.point.z - query.reach);
+    __m128 maxQX = _mm_set1_ps(query.point.x + query.reach);
+    __m128 maxQY = _mm_set1_ps(query.point.y + query.reach);
+    __m128 maxQZ = _mm_set1_ps(query.point.z + query.reach);
+    __m128i filter = _mm_set1_epi32((int)query.filter);
+    __m128i zero = _mm_setzero_si128();
+
+    size_t padded = oriented.minX.size();
+    for (size_t i = 0; i < padded; i += 4)
+    {
+        __m128 overlapX = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&oriented.minX[i]), maxQX),
+            _mm_cmpge_ps(_mm_loadu_ps(&oriented.maxX[i]), minQX));
+        __m128 overlapY = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&oriented.minY[i]), maxQY),
+            _mm_cmpge_ps(_mm_loadu_ps(&oriented.maxY[i]), minQY));
+        __m128 overlapZ = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&oriented.minZ[i]), maxQZ),
+            _mm_cmpge_ps(_mm_loadu_ps(&oriented.maxZ[i]), minQZ));
+        __m128i layers = _mm_and_si128(_mm_loadu_si128((const __m128i*)&oriented.layers[i]), filter);
+        __m128 filtered = _mm_castsi128_ps(_mm_cmpeq_epi32(layers, zero));
+
+        int mask = _mm_movemask_ps(_mm_andnot_ps(filtered, _mm_and_ps(_mm_and_ps(overlapX, overlapY), overlapZ)));
+        while (mask)
+        {
+            int lane = 0;
+            while (!(mask & (1 << lane)))
+                lane++;
+            mask &= mask - 1;
+
+            if (oriented.order[i + lane] > query.afterOrder)
+            {
+                Hit hit = { oriented.order[i + lane], oriented.entry[i + lane] };
+                out.push_back(hit);
+            }
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+
+class ICollidable;
+class TriangleBVH;
+
+// Hot collision data of every registered collidable, copied out of the
+// ICollidable objects so queries never make a virtual call or chase a
+// pointer. Axis-aligned and oriented collidables live in separate
+// partitions, each one a padded structure of arrays so a query can test
+// four of them per SSE op. refresh() copies an object again after it moved.
+class CollisionStore
+{
+public:
+    // an OBB, or a triangle mesh when mesh isn't null
+    struct OrientedBox
+    {
+        glm::mat4 model;
+        glm::mat4 inverseModel;
+        glm::vec3 localMin;
+        glm::vec3 localMax;
+        const TriangleBVH* mesh;
+    };
+
+    // an entry a query may resolve against, lists are sorted by order
+    struct Hit
+    {
+        unsigned order;
+        int entry;
+
+        bool operator<(const Hit& other) const { return order < other.order; }
+    };
+
+    // Point-as-player query: eye at point, feet eyeHeight below it. reach is
+    // the half size of the cube around the eye an oriented box or mesh must
+    // touch, capsule radius included.
+    // Only entries sharing a layer with filter are reported.
+    struct PointQuery
+    {
+        glm::vec3 point;
+        float eyeHeight;
+        float margin;
+        float reach;
+        unsigned afterOrder;
+        unsigned filter;
+    };
+
+    CollisionStore();
+
+    // returns a stable entry id, reads the object's current state
+    int add(ICollidable* collidable, unsigned order);
+    void remove(int entry);
+    void refresh(int entry);
+    // only the enabled/OBB flags and layers, for objects that didn't move.
+    // True if any of them changed.
+    bool refreshFlags(int entry);
+    void clear();
+
+    ICollidable* getCollidable(int entry) const { return entries[entry].collidable; }
+    unsigned getOrder(int entry) const { return entries[entry].order; }
+    bool isOriented(int entry) const { return entries[entry].oriented; }
+    void getBox(int entry, glm::vec3& outMin, glm::vec3& outMax) const;
+    // 0 while the collidable has collision disabled
+    unsigned getLayers(int entry) const;
+    const OrientedBox& getOrientedBox(int entry) const { return orientedBoxes[entries[entry].lane]; }
+
+    // Exact for axis-aligned entries (the resolve will move the point),
+    // conservative for oriented ones
+    bool mayResolve(int entry, const PointQuery& query) const;
+
+    // Appends every entry after query.afterOrder that mayResolve(), scanning
+    // both partitions four lanes at a time or one by one
+    void gather(const PointQuery& query, bool simd, std::vector<Hit>& out) const;
+
+    size_t getBoxCount() const { return boxes.count; }
+    size_t getOrientedCount() const { return oriented.count; }
+
+private:
+    struct Entry
+    {
+        ICollidable* collidable;   // null while on the free list
+        unsigned order;
+        int lane;                  // next free entry while on the free list
+        bool oriented;
+    };
+
+    // one partition, always padded to a multiple of 4 with empty boxes
+    struct Lanes
+    {
+        std::vector<float> minX, minY, minZ;
+        std::vector<float> maxX, maxY, maxZ;
+        std::vector<unsigned> layers;   // 0 while collision is disabled
+        std::vector<unsigned> order;
+        std::vector<int> entry;
+        size_t count;
+
+        Lanes() : count(0) {}
+        size_t push();
+        void setEmpty(size_t lane);
+        void move(size_t from, size_t to);
+        void clear();
+    };
+
+    std::vector<Entry> entries;
+    int freeEntry;
+    Lanes boxes;
+    Lanes oriented;
+    std::vector<OrientedBox> orientedBoxes;    // parallel to the oriented lanes
+
+    void write(int entry);
+    static bool boxResolves(const Lanes& lanes, size_t lane, const PointQuery& query);
+    static bool boxTouchesReach(const Lanes& lanes, size_t lane, const PointQuery& query);
+    void gatherBoxesSimd(const PointQuery& query, std::vector<Hit>& out) const;
+    void gatherOrientedSimd(const PointQuery& query, std::vector<Hit>& out) const;
+};
@@ -0,0 +1,385 @@
+#include "distanceField.h"
+#include "triangleBVH.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <thread>
+
+namespace
+{
+    const char FILE_MAGIC[4] = { 'L', 'S', 'D', 'F' };
+    const unsigned FILE_VERSION = 2;
+
+    struct FileHeader
+    {
+        char magic[4];
+        unsigned version;
+        unsigned long long key;
+        float origin[3];
+        float cellSize;
+        float bandWidth;
+        int bricksX, bricksY, bricksZ;
+        int storedBricks;
+    };
+
+    // calls function(i) for every i in [0, count), spread over threadCount
+    // threads (the caller's included) that take the next index as they go
+    template <typename Function>
+    void parallelFor(size_t count, unsigned threadCount, Function function)
+    {
+        std::atomic<size_t> next(0);
+        auto work = [&]()
+        {
+            for (size_t i = next++; i < count; i = next++)
+                function(i);
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < threadCount && t < count; t++)
+            threads.push_back(std::thread(work));
+        work();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void hashBytes(unsigned long long& hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    void getWorldBounds(const CollisionStore::OrientedBox& shape, glm::vec3& outMin, glm::vec3& outMax)
+    {
+        outMin = glm::vec3(std::numeric_limits<float>::max());
+        outMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? shape.localMax.x : shape.localMin.x,
+                (i & 2) ? shape.localMax.y : shape.localMin.y,
+                (i & 4) ? shape.localMax.z : shape.localMin.z);
+            glm::vec3 world = glm::vec3(shape.model * glm::vec4(corner, 1.0f));
+            outMin = glm::min(outMin, world);
+            outMax = glm::max(outMax, world);
+        }
+    }
+
+    float boxGap(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB)
+    {
+        return glm::length(glm::max(glm::max(minA - maxB, minB - maxA), glm::vec3(0.0f)));
+    }
+}
+
+DistanceField::DistanceField()
+    : origin(0.0f)
+    , cellSize(1.0f)
+    , bandWidth(1.0f)
+    , bricksX(0)
+    , bricksY(0)
+    , bricksZ(0)
+{
+}
+
+void DistanceField::clear()
+{
+    bricksX = bricksY = bricksZ = 0;
+    coarse.clear();
+    slots.clear();
+    samples.clear();
+}
+
+float DistanceField::getShapeDistance(const CollisionStore::OrientedBox& shape, const glm::vec3& point, float maxDistance)
+{
+    if (shape.mesh)
+    {
+        glm::vec3 closest;
+        if (!shape.mesh->closestPoint(shape.model, shape.inverseModel, point, maxDistance, closest))
+            return maxDistance;
+        return glm::length(closest - point);
+    }
+
+    // box distance in mesh space, each axis stretched by the model's scale
+    // on it (rotation and scale only, like every collidable's model matrix)
+    glm::mat3 linear(shape.model);
+    glm::vec3 scale(glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+    glm::vec3 local = glm::vec3(shape.inverseModel * glm::vec4(point, 1.0f));
+    glm::vec3 center = (shape.localMin + shape.localMax) * 0.5f;
+    glm::vec3 halfSize = (shape.localMax - shape.localMin) * 0.5f;
+    glm::vec3 q = (glm::abs(local - center) - halfSize) * scale;
+
+    float outside = glm::length(glm::max(q, glm::vec3(0.0f)));
+    float inside = std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+    return glm::clamp(outside + inside, -maxDistance, maxDistance);
+}
+
+glm::vec3 DistanceField::brickMin(int brick) const
+{
+    int x = brick % bricksX;
+    int y = (brick / bricksX) % bricksY;
+    int z = brick / (bricksX * bricksY);
+    return origin + glm::vec3((float)x, (float)y, (float)z) * (cellSize * BRICK_CELLS);
+}
+
+void DistanceField::bake(const std::vector<CollisionStore::OrientedBox>& shapes, float cellSize, float bandWidth,
+    unsigned threadCount)
+{
+    clear();
+    this->cellSize = cellSize;
+    this->bandWidth = bandWidth;
+    if (shapes.empty())
+        return;
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<glm::vec3> shapeMin(shapes.size()), shapeMax(shapes.size());
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < shapes.size(); i++)
+    {
+        getWorldBounds(shapes[i], shapeMin[i], shapeMax[i]);
+        boundsMin = glm::min(boundsMin, shapeMin[i]);
+        boundsMax = glm::max(boundsMax, shapeMax[i]);
+    }
+
+    // everything outside the bricks is more than bandWidth away
+    float brickSize = cellSize * BRICK_CELLS;
+    origin = boundsMin - glm::vec3(bandWidth);
+    glm::vec3 extent = boundsMax + glm::vec3(bandWidth) - origin;
+    bricksX = std::max(1, (int)std::ceil(extent.x / brickSize));
+    bricksY = std::max(1, (int)std::ceil(extent.y / brickSize));
+    bricksZ = std::max(1, (int)std::ceil(extent.z / brickSize));
+    size_t brickCount = (size_t)bricksX * bricksY * bricksZ;
+    coarse.assign(brickCount, 0.0f);
+    slots.assign(brickCount, -1);
+
+    // the shapes whose bounds come within bandWidth of a brick, and how far
+    // the nearest bounds are
+    float halfDiagonal = glm::length(glm::vec3(brickSize)) * 0.5f;
+    auto gatherShapes = [&](int brick, std::vector<int>& out)
+    {
+        glm::vec3 minB = brickMin(brick);
+        glm::vec3 maxB = minB + glm::vec3(brickSize);
+        float nearest = std::numeric_limits<float>::max();
+        out.clear();
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            float gap = boxGap(minB, maxB, shapeMin[i], shapeMax[i]);
+            nearest = std::min(nearest, gap);
+            if (gap <= bandWidth)
+                out.push_back((int)i);
+        }
+        return nearest;
+    };
+
+    // pass 1: which bricks come within bandWidth of a surface. The distance
+    // at the center bounds the whole brick.
+    std::vector<char> stored(brickCount, 0);
+    parallelFor(brickCount, threadCount, [&](size_t brick)
+    {
+        std::vector<int> nearby;
+        float nearest = gatherShapes((int)brick, nearby);
+        if (nearby.empty())
+        {
+            coarse[brick] = nearest;
+            return;
+        }
+
+        glm::vec3 center = brickMin((int)brick) + glm::vec3(brickSize * 0.5f);
+        float limit = bandWidth + halfDiagonal;
+        float distance = limit;
+        for (int i : nearby)
+            distance = std::min(distance, getShapeDistance(shapes[i], center, limit));
+
+        if (distance - halfDiagonal >= bandWidth)
+            coarse[brick] = std::max(distance - halfDiagonal, nearest);
+        else if (distance + halfDiagonal <= -bandWidth)
+            coarse[brick] = distance + halfDiagonal;
+        else
+            stored[brick] = 1;
+    });
+
+    std::vector<int> storedBricks;
+    for (size_t brick = 0; brick < brickCount; brick++)
+    {
+        if (stored[brick])
+        {
+            slots[brick] = (int)storedBricks.size();
+            storedBricks.push_back((int)brick);
+        }
+    }
+    samples.resize(storedBricks.size() * BRICK_VOLUME);
+
+    // pass 2: the samples of the stored bricks
+    parallelFor(storedBricks.size(), threadCount, [&](size_t slot)
+    {
+        int brick = storedBricks[slot];
+        std::vector<int> nearby;
+        gatherShapes(brick, nearby);
+
+        glm::vec3 minB = brickMin(brick);
+        short* out = &samples[slot * BRICK_VOLUME];
+        float scale = SAMPLE_SCALE / bandWidth;
+        for (int z = 0; z < BRICK_SAMPLES; z++)
+        {
+            for (int y = 0; y < BRICK_SAMPLES; y++)
+            {
+                for (int x = 0; x < BRICK_SAMPLES; x++)
+                {
+                    glm::vec3 point = minB + glm::vec3((float)x, (float)y, (float)z) * cellSize;
+                    float distance = bandWidth;
+                    for (int i : nearby)
+                        distance = std::min(distance, getShapeDistance(shapes[i], point, bandWidth));
+                    *out++ = (short)std::lround(distance * scale);
+                }
+            }
+        }
+    });
+}
+
+float DistanceField::getDistance(const glm::vec3& point) const
+{
+    if (empty())
+        return std::numeric_limits<float>::max();
+
+    // in cells from the origin
+    glm::vec3 cell = (point - origin) / cellSize;
+    glm::vec3 size((float)(bricksX * BRICK_CELLS), (float)(bricksY * BRICK_CELLS), (float)(bricksZ * BRICK_CELLS));
+    glm::vec3 outside = glm::max(glm::max(-cell, cell - size), glm::vec3(0.0f));
+    if (outside.x > 0.0f || outside.y > 0.0f || outside.z > 0.0f)
+        return bandWidth + glm::length(outside) * cellSize;
+
+    int bx = std::min((int)(cell.x / BRICK_CELLS), bricksX - 1);
+    int by = std::min((int)(cell.y / BRICK_CELLS), bricksY - 1);
+    int bz = std::min((int)(cell.z / BRICK_CELLS), bricksZ - 1);
+    int brick = brickIndex(bx, by, bz);
+    int slot = slots[brick];
+    if (slot < 0)
+        return coarse[brick];
+
+    glm::vec3 inBrick = cell - glm::vec3((float)bx, (float)by, (float)bz) * (float)BRICK_CELLS;
+    int x = std::min((int)inBrick.x, BRICK_CELLS - 1);
+    int y = std::min((int)inBrick.y, BRICK_CELLS - 1);
+    int z = std::min((int)inBrick.z, BRICK_CELLS - 1);
+    glm::vec3 f = inBrick - glm::vec3((float)x, (float)y, (float)z);
+
+    const short* s = &samples[(size_t)slot * BRICK_VOLUME];
+    auto at = [&](int dx, int dy, int dz)
+    {
+        return (float)s[((z + dz) * BRICK_SAMPLES + (y + dy)) * BRICK_SAMPLES + (x + dx)];
+    };
+    float x00 = glm::mix(at(0, 0, 0), at(1, 0, 0), f.x);
+    float x10 = glm::mix(at(0, 1, 0), at(1, 1, 0), f.x);
+    float x01 = glm::mix(at(0, 0, 1), at(1, 0, 1), f.x);
+    float x11 = glm::mix(at(0, 1, 1), at(1, 1, 1), f.x);
+    return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z) * (bandWidth / SAMPLE_SCALE);
+}
+
+size_t DistanceField::getMemoryBytes() const
+{
+    return coarse.size() * sizeof(float) + slots.size() * sizeof(int) + samples.size() * sizeof(short);
+}
+
+unsigned long long DistanceField::makeKey(const std::vector<CollisionStore::OrientedBox>& shapes,
+    float cellSize, float bandWidth)
+{
+    unsigned long long hash = 14695981039346656037ull;
+    hashBytes(hash, &FILE_VERSION, sizeof(FILE_VERSION));
+    hashBytes(hash, &cellSize, sizeof(cellSize));
+    hashBytes(hash, &bandWidth, sizeof(bandWidth));
+    for (const CollisionStore::OrientedBox& shape : shapes)
+    {
+        hashBytes(hash, &shape.model, sizeof(shape.model));
+        hashBytes(hash, &shape.localMin, sizeof(shape.localMin));
+        hashBytes(hash, &shape.localMax, sizeof(shape.localMax));
+        unsigned long long mesh = shape.mesh ? shape.mesh->getChecksum() : 0;
+        hashBytes(hash, &mesh, sizeof(mesh));
+    }
+    return hash;
+}
+
+bool DistanceField::loadOrBake(const std::string& path, const std::vector<CollisionStore::OrientedBox>& shapes,
+    float cellSize, float bandWidth)
+{
+    unsigned long long key = makeKey(shapes, cellSize, bandWidth);
+    if (load(path, key))
+        return true;
+
+    bake(shapes, cellSize, bandWidth);
+    save(path, key);
+    return false;
+}
+
+bool DistanceField::load(const std::string& path, unsigned long long key)
+{
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    FileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+        header.version != FILE_VERSION || header.key != key ||
+        header.bricksX <= 0 || header.bricksY <= 0 || header.bricksZ <= 0 || header.storedBricks < 0)
+        return false;
+
+    size_t brickCount = (size_t)header.bricksX * header.bricksY * header.bricksZ;
+    std::vector<float> fileCoarse(brickCount);
+    std::vector<int> fileSlots(brickCount);
+    std::vector<short> fileSamples((size_t)header.storedBricks * BRICK_VOLUME);
+    file.read(reinterpret_cast<char*>(fileCoarse.data()), fileCoarse.size() * sizeof(float));
+    file.read(reinterpret_cast<char*>(fileSlots.data()), fileSlots.size() * sizeof(int));
+    file.read(reinterpret_cast<char*>(fileSamples.data()), fileSamples.size() * sizeof(short));
+    if (!file)
+        return false;
+
+    for (int slot : fileSlots)
+    {
+        if (slot >= header.storedBricks)
+            return false;
+    }
+
+    origin = glm::vec3(header.origin[0], header.origin[1], header.origin[2]);
+    cellSize = header.cellSize;
+    bandWidth = header.bandWidth;
+    bricksX = header.bricksX;
+    bricksY = header.bricksY;
+    bricksZ = header.bricksZ;
+    coarse.swap(fileCoarse);
+    slots.swap(fileSlots);
+    samples.swap(fileSamples);
+    return true;
+}
+
+bool DistanceField::save(const std::string& path, unsigned long long key) const
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    FileHeader header;
+    memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.key = key;
+    header.origin[0] = origin.x;
+    header.origin[1] = origin.y;
+    header.origin[2] = origin.z;
+    header.cellSize = cellSize;
+    header.bandWidth = bandWidth;
+    header.bricksX = bricksX;
+    header.bricksY = bricksY;
+    header.bricksZ = bricksZ;
+    header.storedBricks = (int)getStoredBrickCount();
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(coarse.data()), coarse.size() * sizeof(float));
+    file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(int));
+    file.write(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(short));
+    return (bool)file;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <glm.hpp>
+#include <string>
+#include <vector>
+#include "collisionStore.h"
+
+// Sparse signed distance field of static collision shapes, baked once.
+// Space is cut into bricks of BRICK_CELLS^3 cells. Only bricks within
+// bandWidth of a surface keep their samples (trilinear in between), every
+// other brick keeps one value that the whole brick is at least as far as.
+// Distances are negative inside boxes, meshes are surfaces, and the samples
+// are 16 bit fractions of bandWidth: near geometry the field is as good as
+// the cell size, far from it it only says "far".
+class DistanceField
+{
+public:
+    DistanceField();
+
+    // Samples the shapes (an AABB is an OrientedBox with identity matrices)
+    // on threadCount threads, 0 for one per hardware thread
+    void bake(const std::vector<CollisionStore::OrientedBox>& shapes, float cellSize, float bandWidth,
+        unsigned threadCount = 0);
+
+    // Reads the field from path if it was baked from the same shapes and
+    // settings, otherwise bakes it and writes it there. True if it was read.
+    bool loadOrBake(const std::string& path, const std::vector<CollisionStore::OrientedBox>& shapes,
+        float cellSize, float bandWidth);
+
+    void clear();
+    bool empty() const { return coarse.empty(); }
+
+    // trilinear distance to the nearest shape, at least bandWidth away from
+    // the stored bricks
+    float getDistance(const glm::vec3& point) const;
+
+    // exact signed distance to one shape, maxDistance if it's further
+    static float getShapeDistance(const CollisionStore::OrientedBox& shape, const glm::vec3& point, float maxDistance);
+
+    float getCellSize() const { return cellSize; }
+    float getBandWidth() const { return bandWidth; }
+    size_t getBrickCount() const { return coarse.size(); }
+    size_t getStoredBrickCount() const { return samples.size() / BRICK_VOLUME; }
+    size_t getMemoryBytes() const;
+
+private:
+    static const int BRICK_CELLS = 8;
+    static const int BRICK_SAMPLES = BRICK_CELLS + 1;   // corners on both sides
+    static const int BRICK_VOLUME = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+    static constexpr float SAMPLE_SCALE = 32767.0f;
+
+    glm::vec3 origin;           // corner of brick (0, 0, 0)
+    float cellSize;
+    float bandWidth;
+    int bricksX, bricksY, bricksZ;
+    std::vector<float> coarse;  // per brick, how far the whole brick is at least
+    std::vector<int> slots;     // per brick, BRICK_VOLUME samples at slot * BRICK_VOLUME, -1 if none
+    std::vector<short> samples; // distance / bandWidth * SAMPLE_SCALE
+
+    static unsigned long long makeKey(const std::vector<CollisionStore::OrientedBox>& shapes,
+        float cellSize, float bandWidth);
+    bool load(const std::string& path, unsigned long long key);
+    bool save(const std::string& path, unsigned long long key) const;
+
+    int brickIndex(int x, int y, int z) const { return (z * bricksY + y) * bricksX + x; }
+    glm::vec3 brickMin(int brick) const;
+};
@@ -0,0 +1,69 @@
+#include "fixedTimestep.h"
+#include <cmath>
+
+FixedTimestep::FixedTimestep(float tickRate, int maxStepsPerFrame)
+    : tickRate(60.0f)
+    , step(1.0f / 60.0f)
+    , maxStepsPerFrame(1)
+    , accumulator(0.0f)
+    , stepsThisFrame(0)
+    , droppedTime(0.0f)
+{
+    setTickRate(tickRate);
+    setMaxStepsPerFrame(maxStepsPerFrame);
+}
+
+void FixedTimestep::setTickRate(float tickRate)
+{
+    if (tickRate <= 0.0f)
+        return;
+
+    this->tickRate = tickRate;
+    step = 1.0f / tickRate;
+
+    // keep the alpha in range after a rate change
+    if (accumulator >= step)
+        accumulator = 0.0f;
+}
+
+void FixedTimestep::setMaxStepsPerFrame(int maxSteps)
+{
+    maxStepsPerFrame = maxSteps > 0 ? maxSteps : 1;
+}
+
+void FixedTimestep::beginFrame(float frameTime)
+{
+    if (frameTime < 0.0f)
+        frameTime = 0.0f;
+
+    accumulator += frameTime;
+    stepsThisFrame = 0;
+    droppedTime = 0.0f;
+}
+
+bool FixedTimestep::nextStep()
+{
+    if (accumulator < step)
+        return false;
+
+    if (stepsThisFrame >= maxStepsPerFrame)
+    {
+        // too far behind, give up on the backlog instead of catching up
+        // (the game slows down rather than locking up), keep the fraction
+        float remainder = std::fmod(accumulator, step);
+        droppedTime = accumulator - remainder;
+        accumulator = remainder;
+        return false;
+    }
+
+    accumulator -= step;
+    stepsThisFrame++;
+    return true;
+}
+
+void FixedTimestep::reset()
+{
+    accumulator = 0.0f;
+    stepsThisFrame = 0;
+    droppedTime = 0.0f;
+}
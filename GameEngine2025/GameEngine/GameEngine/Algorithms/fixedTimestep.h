@@ -0,0 +1,44 @@
+#pragma once
+
+// fixed-step simulation clock
+// frame time goes into an accumulator which is drained in whole ticks,
+// the leftover fraction is used to interpolate between the last two states
+class FixedTimestep
+{
+public:
+    FixedTimestep(float tickRate = 60.0f, int maxStepsPerFrame = 5);
+
+    // ticks per second, every simulation step advances by 1 / tickRate
+    void setTickRate(float tickRate);
+    float getTickRate() const { return tickRate; }
+    float getStep() const { return step; }
+
+    // more ticks than this in one frame are dropped so a slow frame
+    // can't make the next one slower (spiral of death)
+    void setMaxStepsPerFrame(int maxSteps);
+    int getMaxStepsPerFrame() const { return maxStepsPerFrame; }
+
+    // add the real time that passed since the last frame
+    void beginFrame(float frameTime);
+
+    // true while another tick is due this frame, consumes it
+    bool nextStep();
+
+    // how far the render time is between the previous and the current tick [0, 1]
+    float getAlpha() const { return accumulator / step; }
+
+    // ticks run / time dropped during the last frame
+    int getStepsThisFrame() const { return stepsThisFrame; }
+    float getDroppedTime() const { return droppedTime; }
+
+    void reset();
+
+private:
+    float tickRate;
+    float step;
+    int maxStepsPerFrame;
+
+    float accumulator;
+    int stepsThisFrame;
+    float droppedTime;
+};
@@ -0,0 +1,226 @@
+#include "heightfield.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // hash of a lattice point to [0, 1]
+    float latticeValue(int x, int z, unsigned seed)
+    {
+        unsigned h = (unsigned)x * 374761393u + (unsigned)z * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        h ^= h >> 16;
+        return (h & 0xFFFFFF) / 16777215.0f;
+    }
+
+    // smooth value noise, [0, 1]
+    float valueNoise(float x, float z, unsigned seed)
+    {
+        int x0 = (int)std::floor(x);
+        int z0 = (int)std::floor(z);
+        float fx = x - x0;
+        float fz = z - z0;
+        fx = fx * fx * (3.0f - 2.0f * fx);
+        fz = fz * fz * (3.0f - 2.0f * fz);
+
+        float a = latticeValue(x0, z0, seed);
+        float b = latticeValue(x0 + 1, z0, seed);
+        float c = latticeValue(x0, z0 + 1, seed);
+        float d = latticeValue(x0 + 1, z0 + 1, seed);
+        return (a + (b - a) * fx) + ((c + (d - c) * fx) - (a + (b - a) * fx)) * fz;
+    }
+}
+
+Heightfield::Heightfield()
+    : origin(0.0f)
+    , spacing(1.0f)
+    , samplesX(0)
+    , samplesZ(0)
+{
+}
+
+void Heightfield::create(const glm::vec2& origin, float spacing, int samplesX, int samplesZ, float baseHeight)
+{
+    this->origin = origin;
+    this->spacing = spacing;
+    this->samplesX = samplesX;
+    this->samplesZ = samplesZ;
+    heights.assign((size_t)samplesX * samplesZ, baseHeight);
+}
+
+void Heightfield::addHills(const glm::vec2& flatMin, const glm::vec2& flatMax, float blendWidth,
+    float amplitude, float wavelength, unsigned seed)
+{
+    for (int j = 0; j < samplesZ; j++)
+    {
+        for (int i = 0; i < samplesX; i++)
+        {
+            glm::vec2 p = origin + glm::vec2((float)i, (float)j) * spacing;
+
+            // distance outside the flat rectangle, 0 inside
+            glm::vec2 outside = glm::max(glm::max(flatMin - p, p - flatMax), glm::vec2(0.0f));
+            float t = std::min(glm::length(outside) / blendWidth, 1.0f);
+            float mask = t * t * (3.0f - 2.0f * t);
+            if (mask <= 0.0f)
+                continue;
+
+            // three octaves of value noise
+            float noise = 0.0f;
+            float weight = 0.5f;
+            float frequency = 1.0f / wavelength;
+            for (int octave = 0; octave < 3; octave++)
+            {
+                noise += valueNoise(p.x * frequency, p.y * frequency, seed + octave) * weight;
+                weight *= 0.5f;
+                frequency *= 2.0f;
+            }
+
+            heights[(size_t)j * samplesX + i] += noise / 0.875f * amplitude * mask;
+        }
+    }
+}
+
+bool Heightfield::contains(float x, float z) const
+{
+    glm::vec2 extent = getExtent();
+    return samplesX > 1 && samplesZ > 1 &&
+        x >= origin.x && x <= origin.x + extent.x &&
+        z >= origin.y && z <= origin.y + extent.y;
+}
+
+void Heightfield::locate(float x, float z, int& i, int& j, float& fx, float& fz) const
+{
+    float gx = std::min(std::max((x - origin.x) / spacing, 0.0f), (float)(samplesX - 1));
+    float gz = std::min(std::max((z - origin.y) / spacing, 0.0f), (float)(samplesZ - 1));
+
+    // the last row/column uses the cell before it
+    i = std::min((int)gx, samplesX - 2);
+    j = std::min((int)gz, samplesZ - 2);
+    fx = gx - i;
+    fz = gz - j;
+}
+
+float Heightfield::getHeight(float x, float z) const
+{
+    if (samplesX < 2 || samplesZ < 2)
+        return heights.empty() ? 0.0f : heights[0];
+
+    int i, j;
+    float fx, fz;
+    locate(x, z, i, j, fx, fz);
+
+    float h00 = getSample(i, j);
+    float h10 = getSample(i + 1, j);
+    float h01 = getSample(i, j + 1);
+    float h11 = getSample(i + 1, j + 1);
+    float front = h00 + (h10 - h00) * fx;
+    float back = h01 + (h11 - h01) * fx;
+    return front + (back - front) * fz;
+}
+
+glm::vec3 Heightfield::getNormal(float x, float z) const
+{
+    if (samplesX < 2 || samplesZ < 2)
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+
+    int i, j;
+    float fx, fz;
+    locate(x, z, i, j, fx, fz);
+
+    float h00 = getSample(i, j);
+    float h10 = getSample(i + 1, j);
+    float h01 = getSample(i, j + 1);
+    float h11 = getSample(i + 1, j + 1);
+
+    // partial derivatives of the bilinear patch
+    float dhdx = ((h10 - h00) + ((h11 - h01) - (h10 - h00)) * fz) / spacing;
+    float dhdz = ((h01 - h00) + ((h11 - h10) - (h01 - h00)) * fx) / spacing;
+    return glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+}
+
+bool Heightfield::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& outDistance) const
+{
+    const int BISECTION_STEPS = 12;
+
+    // straight down or up, the common ground probe: one lookup
+    if (direction.x == 0.0f && direction.z == 0.0f)
+    {
+        if (!contains(origin.x, origin.z))
+            return false;
+        float above = origin.y - getHeight(origin.x, origin.z);
+        if (above <= 0.0f)
+        {
+            outDistance = 0.0f;
+            return true;
+        }
+        if (direction.y >= 0.0f || above > maxDistance * -direction.y)
+            return false;
+        outDistance = above / -direction.y;
+        return true;
+    }
+
+    // march in half cells, then bisect the step that went under
+    auto under = [&](float t)
+    {
+        glm::vec3 p = origin + direction * t;
+        return contains(p.x, p.z) && p.y < getHeight(p.x, p.z);
+    };
+    if (under(0.0f))
+    {
+        outDistance = 0.0f;
+        return true;
+    }
+
+    float step = spacing * 0.5f;
+    int steps = std::max(1, (int)std::ceil(maxDistance / step));
+    float aboveT = 0.0f;
+    for (int i = 1; i <= steps; i++)
+    {
+        float belowT = std::min(i * step, maxDistance);
+        if (!under(belowT))
+        {
+            aboveT = belowT;
+            continue;
+        }
+        for (int k = 0; k < BISECTION_STEPS; k++)
+        {
+            float middle = 0.5f * (aboveT + belowT);
+            if (under(middle))
+                belowT = middle;
+            else
+                aboveT = middle;
+        }
+        outDistance = belowT;
+        return true;
+    }
+    return false;
+}
+
+void Heightfield::getHeightRange(const glm::vec2& rectMin, const glm::vec2& rectMax, float& outMin, float& outMax) const
+{
+    outMin = 0.0f;
+    outMax = 0.0f;
+    if (heights.empty())
+        return;
+
+    int i0 = std::max((int)std::floor((rectMin.x - origin.x) / spacing), 0);
+    int j0 = std::max((int)std::floor((rectMin.y - origin.y) / spacing), 0);
+    int i1 = std::min((int)std::ceil((rectMax.x - origin.x) / spacing), samplesX - 1);
+    int j1 = std::min((int)std::ceil((rectMax.y - origin.y) / spacing), samplesZ - 1);
+    if (i0 > i1 || j0 > j1)
+    {
+        outMin = outMax = getHeight((rectMin.x + rectMax.x) * 0.5f, (rectMin.y + rectMax.y) * 0.5f);
+        return;
+    }
+
+    outMin = outMax = getSample(i0, j0);
+    for (int j = j0; j <= j1; j++)
+    {
+        for (int i = i0; i <= i1; i++)
+        {
+            float h = getSample(i, j);
+            outMin = std::min(outMin, h);
+            outMax = std::max(outMax, h);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+
+// Regular grid of ground heights over the XZ plane.
+// Sample (i, j) sits at origin + (i, j) * spacing, queries between samples
+// are bilinear and cost the same anywhere on the map.
+class Heightfield
+{
+public:
+    Heightfield();
+
+    // flat ground of samplesX * samplesZ samples at the given height
+    void create(const glm::vec2& origin, float spacing, int samplesX, int samplesZ, float baseHeight);
+
+    // Raise rolling hills everywhere outside the flat rectangle, blending in
+    // over blendWidth units so the play area itself stays untouched
+    void addHills(const glm::vec2& flatMin, const glm::vec2& flatMax, float blendWidth,
+        float amplitude, float wavelength, unsigned seed);
+
+    bool contains(float x, float z) const;
+
+    // bilinear height, positions outside the grid clamp to the border
+    float getHeight(float x, float z) const;
+
+    // surface normal of the bilinear patch under (x, z)
+    glm::vec3 getNormal(float x, float z) const;
+
+    // Distance along the segment origin + direction * [0, maxDistance] (unit
+    // direction) to where it first goes below the surface, inside the grid.
+    // 0 if it starts below.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& outDistance) const;
+
+    float getSample(int i, int j) const { return heights[(size_t)j * samplesX + i]; }
+    void setSample(int i, int j, float height) { heights[(size_t)j * samplesX + i] = height; }
+
+    const std::vector<float>& getSamples() const { return heights; }
+    const glm::vec2& getOrigin() const { return origin; }
+    float getSpacing() const { return spacing; }
+    int getSamplesX() const { return samplesX; }
+    int getSamplesZ() const { return samplesZ; }
+    glm::vec2 getExtent() const { return glm::vec2((samplesX - 1) * spacing, (samplesZ - 1) * spacing); }
+
+    // lowest and highest sample in a world-space rectangle
+    void getHeightRange(const glm::vec2& rectMin, const glm::vec2& rectMax, float& outMin, float& outMax) const;
+
+private:
+    glm::vec2 origin;
+    float spacing;
+    int samplesX;
+    int samplesZ;
+    std::vector<float> heights;
+
+    // cell coordinates of (x, z), clamped to the grid
+    void locate(float x, float z, int& i, int& j, float& fx, float& fz) const;
+};
@@ -15,8 +15,8 @@ PlayerPhysics::PlayerPhysics()
 
 glm::vec3 PlayerPhysics::update(float deltaTime)
 {
-    // Clamp deltaTime to prevent huge jumps on lag spikes
-    if (deltaTime > 0.1f) deltaTime = 0.1f;
+    // deltaTime is the fixed simulation step, lag spikes are absorbed by the
+    // step limit of the caller's FixedTimestep
     
     // Apply gravity if not grounded
     if (!isGrounded)
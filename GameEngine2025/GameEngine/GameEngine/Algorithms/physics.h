@@ -18,7 +18,7 @@ public:
     bool isGrounded;        // whether player is on the ground
     bool wasGrounded;       // was grounded last frame (for landing detection)
 
-    // update physics for this frame
+    // update physics for one fixed simulation step
     glm::vec3 update(float deltaTime);
 
     // apply movement input (horizontal only, normalized direction)
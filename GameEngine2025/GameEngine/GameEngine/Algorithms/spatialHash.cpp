@@ -0,0 +1,105 @@
+#include "spatialHash.h"
+#include <algorithm>
+
+SpatialHash::SpatialHash(float cellSize)
+    : cellSize(cellSize), maxRadius(0.0f), buckets(BUCKET_COUNT), occupiedBuckets(0)
+{
+}
+
+int SpatialHash::insert(const glm::vec3& position, float radius, unsigned layer, int userData)
+{
+    int entity;
+    if (!freeEntities.empty())
+    {
+        entity = freeEntities.back();
+        freeEntities.pop_back();
+    }
+    else
+    {
+        entity = (int)entities.size();
+        entities.push_back(Entity());
+    }
+
+    Entity& e = entities[entity];
+    e.position = position;
+    e.radius = radius;
+    e.cell = cellOf(position);
+    e.layer = layer;
+    e.userData = userData;
+    maxRadius = std::max(maxRadius, radius);
+    link(entity);
+    return entity;
+}
+
+void SpatialHash::move(int entity, const glm::vec3& position)
+{
+    Entity& e = entities[entity];
+    e.position = position;
+    glm::ivec3 cell = cellOf(position);
+    if (cell == e.cell)
+        return;
+
+    unlink(entity);
+    e.cell = cell;
+    link(entity);
+}
+
+void SpatialHash::remove(int entity)
+{
+    unlink(entity);
+    entities[entity].layer = 0;
+    freeEntities.push_back(entity);
+}
+
+void SpatialHash::clear()
+{
+    for (std::vector<int>& bucket : buckets)
+        bucket.clear();
+    entities.clear();
+    freeEntities.clear();
+    occupiedBuckets = 0;
+    maxRadius = 0.0f;
+}
+
+int SpatialHash::findNearest(const glm::vec3& center, float maxDistance, unsigned layers, int ignore) const
+{
+    int nearest = -1;
+    float nearestDistance = maxDistance;
+    query(center, maxDistance, layers, [&](int entity)
+    {
+        if (entity == ignore)
+            return;
+        const Entity& e = entities[entity];
+        float distance = std::max(0.0f, glm::length(e.position - center) - e.radius);
+        if (nearest < 0 || distance < nearestDistance)
+        {
+            nearest = entity;
+            nearestDistance = distance;
+        }
+    });
+    return nearest;
+}
+
+void SpatialHash::link(int entity)
+{
+    Entity& e = entities[entity];
+    e.bucket = bucketOf(e.cell);
+    std::vector<int>& bucket = buckets[e.bucket];
+    if (bucket.empty())
+        occupiedBuckets++;
+    e.slot = (int)bucket.size();
+    bucket.push_back(entity);
+}
+
+// swap with the bucket's last entity, so leaving a cell is O(1)
+void SpatialHash::unlink(int entity)
+{
+    Entity& e = entities[entity];
+    std::vector<int>& bucket = buckets[e.bucket];
+    int last = bucket.back();
+    bucket[e.slot] = last;
+    entities[last].slot = e.slot;
+    bucket.pop_back();
+    if (bucket.empty())
+        occupiedBuckets--;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <cmath>
+
+// Uniform grid for things that move every tick (the player, aliens, items).
+// Each entity is a sphere filed under the cell its center is in, and the
+// cells are hashed into a fixed number of buckets, so the grid has no
+// bounds and moving within a cell costs nothing. Queries visit the cells
+// their sphere touches, grown by the largest entity radius, and test each
+// entity there: the work is per cell visited, not per entity in the world.
+// Handles stay valid until the entity is removed.
+class SpatialHash
+{
+public:
+    explicit SpatialHash(float cellSize = 8.0f);
+
+    int insert(const glm::vec3& position, float radius, unsigned layer, int userData);
+    void move(int entity, const glm::vec3& position);
+    void remove(int entity);
+    void clear();
+
+    glm::vec3 getPosition(int entity) const { return entities[entity].position; }
+    float getRadius(int entity) const { return entities[entity].radius; }
+    unsigned getLayer(int entity) const { return entities[entity].layer; }
+    int getUserData(int entity) const { return entities[entity].userData; }
+    void setUserData(int entity, int userData) { entities[entity].userData = userData; }
+
+    // calls visit(entity) for every entity in one of the layers whose sphere
+    // overlaps the one at center; don't insert or remove from inside visit
+    template <typename Visitor>
+    void query(const glm::vec3& center, float radius, unsigned layers, Visitor&& visit) const
+    {
+        float reach = radius + maxRadius;
+        glm::ivec3 lo = cellOf(center - glm::vec3(reach));
+        glm::ivec3 hi = cellOf(center + glm::vec3(reach));
+
+        // a query wider than the table: every bucket once is cheaper
+        long long cells = (long long)(hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+        if (cells > BUCKET_COUNT)
+        {
+            for (const std::vector<int>& bucket : buckets)
+            {
+                for (int entity : bucket)
+                {
+                    if (overlaps(entities[entity], center, radius, layers))
+                        visit(entity);
+                }
+            }
+            return;
+        }
+
+        for (int z = lo.z; z <= hi.z; z++)
+        {
+            for (int y = lo.y; y <= hi.y; y++)
+            {
+                for (int x = lo.x; x <= hi.x; x++)
+                {
+                    glm::ivec3 cell(x, y, z);
+                    for (int entity : buckets[bucketOf(cell)])
+                    {
+                        // other cells share the bucket, skip them
+                        const Entity& e = entities[entity];
+                        if (e.cell == cell && overlaps(e, center, radius, layers))
+                            visit(entity);
+                    }
+                }
+            }
+        }
+    }
+
+    // the entity in the layers whose sphere is closest to center, within
+    // maxDistance of it (sphere surface, 0 if inside), -1 if there's none
+    int findNearest(const glm::vec3& center, float maxDistance, unsigned layers, int ignore = -1) const;
+
+    size_t getEntityCount() const { return entities.size() - freeEntities.size(); }
+    size_t getOccupiedBucketCount() const { return occupiedBuckets; }
+    float getCellSize() const { return cellSize; }
+
+private:
+    static const int BUCKET_COUNT = 4096;   // power of two
+
+    struct Entity
+    {
+        glm::vec3 position;
+        float radius;
+        glm::ivec3 cell;
+        unsigned layer;     // 0 while free
+        int userData;
+        int bucket;
+        int slot;           // index in the bucket
+    };
+
+    float cellSize;
+    float maxRadius;        // largest radius ever inserted, only grows
+    std::vector<Entity> entities;
+    std::vector<int> freeEntities;
+    std::vector<std::vector<int>> buckets;
+    size_t occupiedBuckets;
+
+    glm::ivec3 cellOf(const glm::vec3& position) const
+    {
+        return glm::ivec3((int)std::floor(position.x / cellSize), (int)std::floor(position.y / cellSize),
+            (int)std::floor(position.z / cellSize));
+    }
+
+    static int bucketOf(const glm::ivec3& cell)
+    {
+        unsigned hash = (unsigned)cell.x * 73856093u ^ (unsigned)cell.y * 19349663u ^ (unsigned)cell.z * 83492791u;
+        return (int)(hash & (BUCKET_COUNT - 1));
+    }
+
+    static bool overlaps(const Entity& e, const glm::vec3& center, float radius, unsigned layers)
+    {
+        if ((e.layer & layers) == 0)
+            return false;
+        glm::vec3 d = e.position - center;
+        float reach = radius + e.radius;
+        return glm::dot(d, d) <= reach * reach;
+    }
+
+    void link(int entity);
+    void unlink(int entity);
+};
@@ -0,0 +1,166 @@
+#include "staticBVH.h"
+#include <limits>
+
+namespace
+{
+    float surfaceArea(const glm::vec3& minW, const glm::vec3& maxW)
+    {
+        glm::vec3 d = maxW - minW;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    glm::vec3 centroid(const StaticBVH::Item& item)
+    {
+        return (item.minW + item.maxW) * 0.5f;
+    }
+}
+
+StaticBVH::StaticBVH()
+    : height(0)
+{
+}
+
+void StaticBVH::clear()
+{
+    nodes.clear();
+    items.clear();
+    height = 0;
+}
+
+void StaticBVH::build(const std::vector<Item>& source)
+{
+    clear();
+    if (source.empty())
+        return;
+
+    items = source;
+    nodes.reserve(2 * items.size() / LEAF_ITEMS + 1);
+    buildNode(0, (int)items.size(), 1);
+}
+
+// Binned SAH split over all three axes. A split costs one more node to
+// visit plus its children's items weighted by how likely a query is to
+// touch them (their share of the parent's surface area). SAH alone has no
+// depth bound (a skewed layout can peel off one item per level), so past
+// MAX_SAH_DEPTH the items are halved at the median instead, which keeps the
+// whole tree shallow enough for the queries' fixed stack.
+int StaticBVH::buildNode(int begin, int end, int depth)
+{
+    height = std::max(height, depth);
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+
+    Node node;
+    node.minB = glm::vec3(std::numeric_limits<float>::max());
+    node.maxB = glm::vec3(-std::numeric_limits<float>::max());
+    glm::vec3 centerMin(std::numeric_limits<float>::max());
+    glm::vec3 centerMax(-std::numeric_limits<float>::max());
+    for (int i = begin; i < end; i++)
+    {
+        node.minB = glm::min(node.minB, items[i].minW);
+        node.maxB = glm::max(node.maxB, items[i].maxW);
+        glm::vec3 center = centroid(items[i]);
+        centerMin = glm::min(centerMin, center);
+        centerMax = glm::max(centerMax, center);
+    }
+
+    int count = end - begin;
+    if (count <= LEAF_ITEMS)
+    {
+        node.start = begin;
+        node.count = count;
+        nodes[index] = node;
+        return index;
+    }
+
+    float parentArea = std::max(surfaceArea(node.minB, node.maxB), 1e-12f);
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3 && depth < MAX_SAH_DEPTH; axis++)
+    {
+        float extent = centerMax[axis] - centerMin[axis];
+        if (extent <= 0.0f)
+            continue;
+
+        int binCount[SAH_BINS] = {};
+        glm::vec3 binMin[SAH_BINS], binMax[SAH_BINS];
+        for (int b = 0; b < SAH_BINS; b++)
+        {
+            binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+            binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+        }
+        for (int i = begin; i < end; i++)
+        {
+            int b = std::min((int)((centroid(items[i])[axis] - centerMin[axis]) / extent * SAH_BINS), SAH_BINS - 1);
+            binCount[b]++;
+            binMin[b] = glm::min(binMin[b], items[i].minW);
+            binMax[b] = glm::max(binMax[b], items[i].maxW);
+        }
+
+        // area and count right of every split, then sweep from the left
+        float rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        glm::vec3 sweepMin(std::numeric_limits<float>::max());
+        glm::vec3 sweepMax(-std::numeric_limits<float>::max());
+        int sweepCount = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--)
+        {
+            sweepMin = glm::min(sweepMin, binMin[b]);
+            sweepMax = glm::max(sweepMax, binMax[b]);
+            sweepCount += binCount[b];
+            rightArea[b] = sweepCount > 0 ? surfaceArea(sweepMin, sweepMax) : 0.0f;
+            rightCount[b] = sweepCount;
+        }
+
+        sweepMin = glm::vec3(std::numeric_limits<float>::max());
+        sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+        sweepCount = 0;
+        for (int b = 1; b < SAH_BINS; b++)
+        {
+            sweepMin = glm::min(sweepMin, binMin[b - 1]);
+            sweepMax = glm::max(sweepMax, binMax[b - 1]);
+            sweepCount += binCount[b - 1];
+            if (sweepCount == 0 || rightCount[b] == 0)
+                continue;
+
+            float cost = 1.0f + (surfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[b] * rightCount[b]) / parentArea;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    int middle;
+    if (bestAxis != -1)
+    {
+        float extent = centerMax[bestAxis] - centerMin[bestAxis];
+        float lowest = centerMin[bestAxis];
+        Item* split = std::partition(&items[begin], &items[0] + end, [&](const Item& item)
+        {
+            int b = std::min((int)((centroid(item)[bestAxis] - lowest) / extent * SAH_BINS), SAH_BINS - 1);
+            return b < bestSplit;
+        });
+        middle = (int)(split - &items[0]);
+    }
+    else
+    {
+        // too deep, or every centroid in one spot: halve along the widest axis
+        glm::vec3 extent = centerMax - centerMin;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        middle = (begin + end) / 2;
+        std::nth_element(&items[begin], &items[0] + middle, &items[0] + end, [&](const Item& a, const Item& b)
+        {
+            return centroid(a)[axis] < centroid(b)[axis];
+        });
+    }
+
+    buildNode(begin, middle, depth + 1);
+    node.start = buildNode(middle, end, depth + 1);
+    node.count = 0;
+    nodes[index] = node;
+    return index;
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Immutable bounding volume hierarchy over boxes that don't move, built in
+// one go with the surface area heuristic. The nodes sit in one array in
+// depth-first order (a left child right after its parent), so queries walk
+// memory mostly forwards, and nothing is ever refit: changing the set means
+// building it again. Queries have the same shape as AABBTree's but visit
+// the userData of the items directly.
+class StaticBVH
+{
+public:
+    struct Item
+    {
+        glm::vec3 minW;
+        glm::vec3 maxW;
+        int userData;
+    };
+
+    StaticBVH();
+
+    void build(const std::vector<Item>& source);
+    void clear();
+    bool empty() const { return nodes.empty(); }
+
+    // calls visit(userData) for every item whose box overlaps [minW, maxW]
+    template <typename Visitor>
+    void query(const glm::vec3& minW, const glm::vec3& maxW, Visitor&& visit) const
+    {
+        if (nodes.empty())
+            return;
+
+        int stack[STACK_SIZE];
+        int count = 0;
+        stack[count++] = 0;
+        while (count > 0)
+        {
+            int index = stack[--count];
+            const Node& node = nodes[index];
+            if (node.minB.x > maxW.x || node.maxB.x < minW.x ||
+                node.minB.y > maxW.y || node.maxB.y < minW.y ||
+                node.minB.z > maxW.z || node.maxB.z < minW.z)
+                continue;
+
+            if (node.count > 0)
+            {
+                for (int i = node.start; i < node.start + node.count; i++)
+                {
+                    const Item& item = items[i];
+                    if (item.minW.x <= maxW.x && item.maxW.x >= minW.x &&
+                        item.minW.y <= maxW.y && item.maxW.y >= minW.y &&
+                        item.minW.z <= maxW.z && item.maxW.z >= minW.z)
+                        visit(item.userData);
+                }
+            }
+            else if (count + 2 <= STACK_SIZE)
+            {
+                stack[count++] = node.start;
+                stack[count++] = index + 1;
+            }
+        }
+    }
+
+    // calls visit(userData) for every item whose box, grown by radius, the
+    // segment origin + direction * [0, maxDistance] passes through. visit
+    // returns the distance to clip the segment to.
+    template <typename Visitor>
+    void raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float radius,
+        Visitor&& visit) const
+    {
+        if (nodes.empty())
+            return;
+
+        glm::vec3 grow(radius);
+        int stack[STACK_SIZE];
+        int count = 0;
+        stack[count++] = 0;
+        while (count > 0)
+        {
+            int index = stack[--count];
+            const Node& node = nodes[index];
+            if (!segmentHitsBox(node.minB - grow, node.maxB + grow, origin, direction, maxDistance))
+                continue;
+
+            if (node.count > 0)
+            {
+                for (int i = node.start; i < node.start + node.count; i++)
+                {
+                    const Item& item = items[i];
+                    if (segmentHitsBox(item.minW - grow, item.maxW + grow, origin, direction, maxDistance))
+                        maxDistance = visit(item.userData);
+                }
+            }
+            else if (count + 2 <= STACK_SIZE)
+            {
+                stack[count++] = node.start;
+                stack[count++] = index + 1;
+            }
+        }
+    }
+
+    int getHeight() const { return height; }
+    size_t getItemCount() const { return items.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+
+private:
+    static const int LEAF_ITEMS = 4;
+    static const int SAH_BINS = 12;
+    static const int MAX_SAH_DEPTH = 64;
+    // a query keeps at most one pending node per level, and median splits
+    // below MAX_SAH_DEPTH add at most log2(items) more levels
+    static const int STACK_SIZE = 128;
+
+    // count > 0: leaf with items [start, start + count)
+    // count == 0: inner node, left child at index + 1, right child at start
+    struct Node
+    {
+        glm::vec3 minB;
+        int start;
+        glm::vec3 maxB;
+        int count;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Item> items;    // in leaf order
+    int height;
+
+    int buildNode(int begin, int end, int depth);
+
+    static bool segmentHitsBox(const glm::vec3& minW, const glm::vec3& maxW,
+        const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+    {
+        float enter = 0.0f;
+        float exit = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::fabs(direction[axis]) < 1e-12f)
+            {
+                if (origin[axis] < minW[axis] || origin[axis] > maxW[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (minW[axis] - origin[axis]) / direction[axis];
+            float t1 = (maxW[axis] - origin[axis]) / direction[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+            if (enter > exit)
+                return false;
+        }
+        return true;
+    }
+};
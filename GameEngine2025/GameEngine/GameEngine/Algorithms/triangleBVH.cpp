@@ -0,0 +1,505 @@
+#include "triangleBVH.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace
+{
+    // Ericson, Real-Time Collision Detection 5.1.5
+    glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+    {
+        glm::vec3 ab = b - a;
+        glm::vec3 ac = c - a;
+        glm::vec3 ap = p - a;
+        float d1 = glm::dot(ab, ap);
+        float d2 = glm::dot(ac, ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+
+        glm::vec3 bp = p - b;
+        float d3 = glm::dot(ab, bp);
+        float d4 = glm::dot(ac, bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+
+        glm::vec3 cp = p - c;
+        float d5 = glm::dot(ab, cp);
+        float d6 = glm::dot(ac, cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+        float denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // Ericson 5.1.9, closest points c1 on p1q1 and c2 on p2q2
+    void closestPointsSegmentSegment(const glm::vec3& p1, const glm::vec3& q1, const glm::vec3& p2, const glm::vec3& q2,
+        glm::vec3& c1, glm::vec3& c2)
+    {
+        const float EPSILON = 1e-8f;
+        glm::vec3 d1 = q1 - p1;
+        glm::vec3 d2 = q2 - p2;
+        glm::vec3 r = p1 - p2;
+        float a = glm::dot(d1, d1);
+        float e = glm::dot(d2, d2);
+        float f = glm::dot(d2, r);
+        float s, t;
+
+        if (a <= EPSILON && e <= EPSILON)
+        {
+            c1 = p1;
+            c2 = p2;
+            return;
+        }
+        if (a <= EPSILON)
+        {
+            s = 0.0f;
+            t = glm::clamp(f / e, 0.0f, 1.0f);
+        }
+        else
+        {
+            float c = glm::dot(d1, r);
+            if (e <= EPSILON)
+            {
+                t = 0.0f;
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            }
+            else
+            {
+                float b = glm::dot(d1, d2);
+                float denom = a * e - b * b;
+                s = denom != 0.0f ? glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f) : 0.0f;
+                t = (b * s + f) / e;
+                if (t < 0.0f)
+                {
+                    t = 0.0f;
+                    s = glm::clamp(-c / a, 0.0f, 1.0f);
+                }
+                else if (t > 1.0f)
+                {
+                    t = 1.0f;
+                    s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+                }
+            }
+        }
+        c1 = p1 + d1 * s;
+        c2 = p2 + d2 * t;
+    }
+
+    bool pointInTriangle(const glm::vec3& p, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, const glm::vec3& n)
+    {
+        return glm::dot(glm::cross(v1 - v0, p - v0), n) >= 0.0f &&
+            glm::dot(glm::cross(v2 - v1, p - v1), n) >= 0.0f &&
+            glm::dot(glm::cross(v0 - v2, p - v2), n) >= 0.0f;
+    }
+
+    // Moller-Trumbore, two sided. t is in units of d.
+    bool segmentTriangle(const glm::vec3& o, const glm::vec3& d, const glm::vec3& v0, const glm::vec3& v1,
+        const glm::vec3& v2, float& outT)
+    {
+        glm::vec3 e1 = v1 - v0;
+        glm::vec3 e2 = v2 - v0;
+        glm::vec3 p = glm::cross(d, e2);
+        float det = glm::dot(e1, p);
+        if (std::fabs(det) < 1e-12f)
+            return false;
+
+        float inverse = 1.0f / det;
+        glm::vec3 s = o - v0;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, e1);
+        float v = glm::dot(d, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        outT = glm::dot(e2, q) * inverse;
+        return true;
+    }
+
+    bool segmentHitsBox(const glm::vec3& minB, const glm::vec3& maxB, const glm::vec3& o, const glm::vec3& d, float maxT)
+    {
+        float enter = 0.0f;
+        float exit = maxT;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::fabs(d[axis]) < 1e-12f)
+            {
+                if (o[axis] < minB[axis] || o[axis] > maxB[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (minB[axis] - o[axis]) / d[axis];
+            float t1 = (maxB[axis] - o[axis]) / d[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+            if (enter > exit)
+                return false;
+        }
+        return true;
+    }
+
+    // Capsule a-b against one world-space triangle. A segment through the
+    // face pushes its end that is behind the face out to the front, so
+    // closed meshes push outwards however deep the capsule got.
+    bool capsuleTriangle(const glm::vec3& a, const glm::vec3& b, float radius,
+        const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, TriangleBVH::Contact& out)
+    {
+        glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+        float area = glm::length(n);
+        if (area < 1e-12f)
+            return false;
+        n /= area;
+
+        float da = glm::dot(a - v0, n);
+        float db = glm::dot(b - v0, n);
+        if ((da <= 0.0f) != (db <= 0.0f) || (da == 0.0f && db == 0.0f))
+        {
+            float t = da != db ? da / (da - db) : 0.0f;
+            glm::vec3 crossing = a + (b - a) * t;
+            if (pointInTriangle(crossing, v0, v1, v2, n))
+            {
+                out.normal = n;
+                out.depth = radius - std::min(da, db);
+                out.point = crossing;
+                return true;
+            }
+        }
+
+        // otherwise the closest pair: an end against the face, or the
+        // segment against an edge
+        glm::vec3 onSegment = a;
+        glm::vec3 onTriangle = closestPointOnTriangle(a, v0, v1, v2);
+        float best = glm::dot(a - onTriangle, a - onTriangle);
+
+        glm::vec3 candidate = closestPointOnTriangle(b, v0, v1, v2);
+        float distance = glm::dot(b - candidate, b - candidate);
+        if (distance < best)
+        {
+            best = distance;
+            onSegment = b;
+            onTriangle = candidate;
+        }
+
+        const glm::vec3* corners[3] = { &v0, &v1, &v2 };
+        for (int edge = 0; edge < 3; edge++)
+        {
+            glm::vec3 segmentPoint, edgePoint;
+            closestPointsSegmentSegment(a, b, *corners[edge], *corners[(edge + 1) % 3], segmentPoint, edgePoint);
+            distance = glm::dot(segmentPoint - edgePoint, segmentPoint - edgePoint);
+            if (distance < best)
+            {
+                best = distance;
+                onSegment = segmentPoint;
+                onTriangle = edgePoint;
+            }
+        }
+
+        if (best >= radius * radius)
+            return false;
+
+        float length = sqrtf(best);
+        out.normal = length > 1e-6f ? (onSegment - onTriangle) / length : n;
+        out.depth = radius - length;
+        out.point = onTriangle;
+        return true;
+    }
+}
+
+TriangleBVH::TriangleBVH()
+    : checksum(0)
+{
+}
+
+void TriangleBVH::build(const std::vector<glm::vec3>& positions, const std::vector<int>& indices)
+{
+    nodes.clear();
+    triangles.clear();
+    checksum = 0;
+
+    std::vector<Triangle> source;
+    source.reserve(indices.size() / 3);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        Triangle triangle;
+        triangle.v0 = positions[indices[i]];
+        triangle.v1 = positions[indices[i + 1]];
+        triangle.v2 = positions[indices[i + 2]];
+        source.push_back(triangle);
+    }
+    if (source.empty())
+        return;
+
+    std::vector<int> order(source.size());
+    std::vector<glm::vec3> centroids(source.size());
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        order[i] = (int)i;
+        centroids[i] = (source[i].v0 + source[i].v1 + source[i].v2) / 3.0f;
+    }
+
+    nodes.reserve(2 * source.size() / LEAF_TRIANGLES + 1);
+    triangles.reserve(source.size());
+    buildNode(order, centroids, source, 0, (int)source.size());
+
+    // FNV-1a over the triangles in leaf order
+    checksum = 14695981039346656037ull;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(triangles.data());
+    for (size_t i = 0; i < triangles.size() * sizeof(Triangle); i++)
+    {
+        checksum ^= bytes[i];
+        checksum *= 1099511628211ull;
+    }
+}
+
+// Median split on the longest axis of the centroids, depth stays log2(n)
+int TriangleBVH::buildNode(std::vector<int>& order, std::vector<glm::vec3>& centroids,
+    const std::vector<Triangle>& source, int begin, int end)
+{
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+
+    glm::vec3 minB(std::numeric_limits<float>::max());
+    glm::vec3 maxB(-std::numeric_limits<float>::max());
+    glm::vec3 minC = minB;
+    glm::vec3 maxC = maxB;
+    for (int i = begin; i < end; i++)
+    {
+        const Triangle& triangle = source[order[i]];
+        minB = glm::min(minB, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+        maxB = glm::max(maxB, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+        minC = glm::min(minC, centroids[order[i]]);
+        maxC = glm::max(maxC, centroids[order[i]]);
+    }
+
+    if (end - begin <= LEAF_TRIANGLES)
+    {
+        Node& leaf = nodes[index];
+        leaf.minB = minB;
+        leaf.maxB = maxB;
+        leaf.start = (int)triangles.size();
+        leaf.count = end - begin;
+        for (int i = begin; i < end; i++)
+            triangles.push_back(source[order[i]]);
+        return index;
+    }
+
+    glm::vec3 extent = maxC - minC;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    int middle = (begin + end) / 2;
+    std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+        [&](int l, int r) { return centroids[l][axis] < centroids[r][axis]; });
+
+    buildNode(order, centroids, source, begin, middle);
+    int right = buildNode(order, centroids, source, middle, end);
+
+    Node& node = nodes[index];
+    node.minB = minB;
+    node.maxB = maxB;
+    node.start = right;
+    node.count = 0;
+    return index;
+}
+
+bool TriangleBVH::collideCapsule(const glm::mat4& model, const glm::mat4& inverseModel,
+    const glm::vec3& a, const glm::vec3& b, float radius, Contact& outContact) const
+{
+    if (nodes.empty())
+        return false;
+
+    // the capsule's world box, as a box in mesh space
+    glm::vec3 worldMin = glm::min(a, b) - glm::vec3(radius);
+    glm::vec3 worldMax = glm::max(a, b) + glm::vec3(radius);
+    glm::vec3 queryMin(std::numeric_limits<float>::max());
+    glm::vec3 queryMax(-std::numeric_limits<float>::max());
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? worldMax.x : worldMin.x, (i & 2) ? worldMax.y : worldMin.y, (i & 4) ? worldMax.z : worldMin.z);
+        glm::vec3 local = glm::vec3(inverseModel * glm::vec4(corner, 1.0f));
+        queryMin = glm::min(queryMin, local);
+        queryMax = glm::max(queryMax, local);
+    }
+
+    // a mirroring model matrix turns the winding, and the faces, around
+    bool mirrored = glm::dot(glm::cross(glm::vec3(model[0]), glm::vec3(model[1])), glm::vec3(model[2])) < 0.0f;
+
+    bool found = false;
+    outContact.depth = 0.0f;
+
+    int stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = 0;
+    while (count > 0)
+    {
+        const Node& node = nodes[stack[--count]];
+        if (node.minB.x > queryMax.x || node.maxB.x < queryMin.x ||
+            node.minB.y > queryMax.y || node.maxB.y < queryMin.y ||
+            node.minB.z > queryMax.z || node.maxB.z < queryMin.z)
+            continue;
+
+        if (node.count == 0)
+        {
+            if (count + 2 <= STACK_SIZE)
+            {
+                stack[count++] = node.start;
+                stack[count++] = (int)(&node - &nodes[0]) + 1;
+            }
+            continue;
+        }
+
+        for (int i = node.start; i < node.start + node.count; i++)
+        {
+            const Triangle& triangle = triangles[i];
+            glm::vec3 v0 = glm::vec3(model * glm::vec4(triangle.v0, 1.0f));
+            glm::vec3 v1 = glm::vec3(model * glm::vec4(triangle.v1, 1.0f));
+            glm::vec3 v2 = glm::vec3(model * glm::vec4(triangle.v2, 1.0f));
+            if (mirrored)
+                std::swap(v1, v2);
+
+            Contact contact;
+            if (capsuleTriangle(a, b, radius, v0, v1, v2, contact) && contact.depth > outContact.depth)
+            {
+                outContact = contact;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+bool TriangleBVH::raycast(const glm::mat4& inverseModel, const glm::vec3& origin, const glm::vec3& direction,
+    float maxDistance, float& outDistance, glm::vec3& outNormal) const
+{
+    if (nodes.empty())
+        return false;
+
+    // an affine map keeps where along a segment things are, so the whole
+    // test runs in mesh space with t from 0 to 1
+    glm::vec3 localOrigin = glm::vec3(inverseModel * glm::vec4(origin, 1.0f));
+    glm::vec3 localEnd = glm::vec3(inverseModel * glm::vec4(origin + direction * maxDistance, 1.0f));
+    glm::vec3 localDirection = localEnd - localOrigin;
+
+    float closest = 1.0f;
+    int hitTriangle = -1;
+
+    int stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = 0;
+    while (count > 0)
+    {
+        const Node& node = nodes[stack[--count]];
+        if (!segmentHitsBox(node.minB, node.maxB, localOrigin, localDirection, closest))
+            continue;
+
+        if (node.count == 0)
+        {
+            if (count + 2 <= STACK_SIZE)
+            {
+                stack[count++] = node.start;
+                stack[count++] = (int)(&node - &nodes[0]) + 1;
+            }
+            continue;
+        }
+
+        for (int i = node.start; i < node.start + node.count; i++)
+        {
+            const Triangle& triangle = triangles[i];
+            float t;
+            if (segmentTriangle(localOrigin, localDirection, triangle.v0, triangle.v1, triangle.v2, t) &&
+                t >= 0.0f && t <= closest)
+            {
+                closest = t;
+                hitTriangle = i;
+            }
+        }
+    }
+
+    if (hitTriangle == -1)
+        return false;
+
+    const Triangle& triangle = triangles[hitTriangle];
+    glm::vec3 localNormal = glm::cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+    glm::vec3 normal = glm::normalize(glm::transpose(glm::mat3(inverseModel)) * localNormal);
+    outNormal = glm::dot(normal, direction) > 0.0f ? -normal : normal;
+    outDistance = closest * maxDistance;
+    return true;
+}
+
+bool TriangleBVH::closestPoint(const glm::mat4& model, const glm::mat4& inverseModel, const glm::vec3& point,
+    float maxDistance, glm::vec3& outPoint) const
+{
+    if (nodes.empty())
+        return false;
+
+    // a node this far from the point in mesh space is at least that far
+    // times the smallest scale of the model in the world
+    glm::mat3 linear(model);
+    float minScale = std::min(glm::length(linear[0]), std::min(glm::length(linear[1]), glm::length(linear[2])));
+    if (minScale <= 0.0f)
+        return false;
+
+    glm::vec3 localPoint = glm::vec3(inverseModel * glm::vec4(point, 1.0f));
+    auto nodeDistance = [&](int index)
+    {
+        const Node& node = nodes[index];
+        glm::vec3 outside = glm::max(glm::max(node.minB - localPoint, localPoint - node.maxB), glm::vec3(0.0f));
+        return glm::length(outside) * minScale;
+    };
+
+    float closest = maxDistance;
+    bool found = false;
+
+    int stack[STACK_SIZE];
+    int count = 0;
+    stack[count++] = 0;
+    while (count > 0)
+    {
+        int index = stack[--count];
+        const Node& node = nodes[index];
+        if (nodeDistance(index) > closest)
+            continue;
+
+        if (node.count == 0)
+        {
+            // the nearer child goes on top
+            int left = index + 1;
+            int right = node.start;
+            if (count + 2 <= STACK_SIZE)
+            {
+                bool leftNearer = nodeDistance(left) < nodeDistance(right);
+                stack[count++] = leftNearer ? right : left;
+                stack[count++] = leftNearer ? left : right;
+            }
+            continue;
+        }
+
+        for (int i = node.start; i < node.start + node.count; i++)
+        {
+            const Triangle& triangle = triangles[i];
+            glm::vec3 v0 = glm::vec3(model * glm::vec4(triangle.v0, 1.0f));
+            glm::vec3 v1 = glm::vec3(model * glm::vec4(triangle.v1, 1.0f));
+            glm::vec3 v2 = glm::vec3(model * glm::vec4(triangle.v2, 1.0f));
+            glm::vec3 onTriangle = closestPointOnTriangle(point, v0, v1, v2);
+            float distance = glm::length(onTriangle - point);
+            if (distance <= closest)
+            {
+                closest = distance;
+                outPoint = onTriangle;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
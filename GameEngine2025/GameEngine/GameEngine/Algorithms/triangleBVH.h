@@ -0,0 +1,74 @@
+#pragma once
+#include <glm.hpp>
+#include <vector>
+
+// Static bounding volume hierarchy over a mesh's triangles, in the mesh's
+// own (model) space. Built once per loaded mesh and shared by every object
+// drawn with it; the object's model matrix places it in the world at query
+// time, so a capsule test costs O(log n) in the triangle count no matter
+// how the object is scaled or rotated.
+class TriangleBVH
+{
+public:
+    // deepest contact of a query, in world space. normal points from the
+    // triangle towards the capsule, moving the capsule by normal * depth
+    // separates them.
+    struct Contact
+    {
+        glm::vec3 normal;
+        float depth;
+        glm::vec3 point;    // on the triangle
+    };
+
+    TriangleBVH();
+
+    // positions[indices[3 * i + k]] is corner k of triangle i
+    void build(const std::vector<glm::vec3>& positions, const std::vector<int>& indices);
+
+    // Capsule from a to b with radius, in world space, against the mesh
+    // placed by model. False if they don't touch.
+    bool collideCapsule(const glm::mat4& model, const glm::mat4& inverseModel,
+        const glm::vec3& a, const glm::vec3& b, float radius, Contact& outContact) const;
+
+    // First triangle the world-space segment origin + direction * [0,
+    // maxDistance] crosses, from either side. outNormal faces the ray.
+    bool raycast(const glm::mat4& inverseModel, const glm::vec3& origin, const glm::vec3& direction,
+        float maxDistance, float& outDistance, glm::vec3& outNormal) const;
+
+    // Nearest point of the mesh placed by model to a world-space point, if
+    // one is within maxDistance
+    bool closestPoint(const glm::mat4& model, const glm::mat4& inverseModel, const glm::vec3& point,
+        float maxDistance, glm::vec3& outPoint) const;
+
+    size_t getTriangleCount() const { return triangles.size(); }
+    size_t getNodeCount() const { return nodes.size(); }
+    bool empty() const { return triangles.empty(); }
+    // hash of the triangles, changes whenever the mesh does
+    unsigned long long getChecksum() const { return checksum; }
+
+private:
+    static const int LEAF_TRIANGLES = 4;
+    static const int STACK_SIZE = 64;
+
+    // count > 0: leaf with triangles [start, start + count)
+    // count == 0: inner node, left child at index + 1, right child at start
+    struct Node
+    {
+        glm::vec3 minB;
+        int start;
+        glm::vec3 maxB;
+        int count;
+    };
+
+    struct Triangle
+    {
+        glm::vec3 v0, v1, v2;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;    // in leaf order
+    unsigned long long checksum;
+
+    int buildNode(std::vector<int>& order, std::vector<glm::vec3>& centroids,
+        const std::vector<Triangle>& source, int begin, int end);
+};
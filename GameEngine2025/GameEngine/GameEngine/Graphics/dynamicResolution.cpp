@@ -0,0 +1,39 @@
+#include "dynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution()
+{
+	this->scale = 1.0f;
+	this->minScale = 0.5f;
+	this->maxScale = 1.0f;
+	this->budgetMilliseconds = 14.0f;	// leaves some room inside a 60 Hz frame
+	this->maxStep = 0.05f;
+}
+
+void DynamicResolution::update(float gpuMilliseconds)
+{
+	if (gpuMilliseconds <= 0.0f)
+		return;
+
+	// inside the band between 85% and 100% of the budget, leave it alone
+	if (gpuMilliseconds <= budgetMilliseconds && gpuMilliseconds >= budgetMilliseconds * 0.85f)
+		return;
+
+	float target = scale * std::sqrt(budgetMilliseconds / gpuMilliseconds);
+	float step = std::max(-maxStep, std::min(maxStep, target - scale));
+	scale = std::max(minScale, std::min(maxScale, scale + step));
+}
+
+void DynamicResolution::setScaleRange(float minScale, float maxScale)
+{
+	this->minScale = minScale;
+	this->maxScale = std::max(minScale, maxScale);
+	scale = std::max(this->minScale, std::min(this->maxScale, scale));
+}
+
+int DynamicResolution::scaled(int size) const
+{
+	int result = (int)(size * scale + 0.5f);
+	return result > 0 ? result : 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Picks the scene resolution scale from the measured GPU time. Cost is
+// roughly proportional to the pixel count, i.e. scale squared, so the
+// controller steers towards sqrt(budget / measured) with a limited step per
+// frame and a dead band under the budget so it doesn't oscillate.
+class DynamicResolution
+{
+	private:
+		float scale;
+		float minScale;
+		float maxScale;
+		float budgetMilliseconds;
+		float maxStep;
+
+	public:
+		DynamicResolution();
+
+		// feed the latest GPU time of the scene, 0 means no measurement yet
+		void update(float gpuMilliseconds);
+
+		void setBudget(float milliseconds) { budgetMilliseconds = milliseconds; }
+		void setScaleRange(float minScale, float maxScale);
+		void reset() { scale = maxScale; }
+
+		float getScale() const { return scale; }
+		float getBudget() const { return budgetMilliseconds; }
+
+		// scaled size, never below one pixel
+		int scaled(int size) const;
+};
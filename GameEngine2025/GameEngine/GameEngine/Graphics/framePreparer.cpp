@@ -0,0 +1,366 @@
+#include "framePreparer.h"
+#include "impostor.h"
+#include "terrain.h"
+#include "..\Model Loading\mesh.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// row i of a column-major glm matrix
+	glm::vec4 matrixRow(const glm::mat4& m, int i)
+	{
+		return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+
+	// Gribb/Hartmann plane extraction, planes point inwards
+	void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+	{
+		glm::vec4 r0 = matrixRow(viewProjection, 0);
+		glm::vec4 r1 = matrixRow(viewProjection, 1);
+		glm::vec4 r2 = matrixRow(viewProjection, 2);
+		glm::vec4 r3 = matrixRow(viewProjection, 3);
+
+		planes[0] = r3 + r0;	// left
+		planes[1] = r3 - r0;	// right
+		planes[2] = r3 + r1;	// bottom
+		planes[3] = r3 - r1;	// top
+		planes[4] = r3 + r2;	// near
+		planes[5] = r3 - r2;	// far
+	}
+
+	// true if the model-space box ends up completely outside one plane
+	bool isOutsideFrustum(const glm::vec4 planes[6], const glm::mat4& model,
+		const glm::vec3& localMin, const glm::vec3& localMax)
+	{
+		glm::vec3 localCenter = (localMin + localMax) * 0.5f;
+		glm::vec3 localExtent = (localMax - localMin) * 0.5f;
+
+		// world center and world extent of the transformed box
+		glm::vec3 center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+		glm::vec3 extent;
+		for (int i = 0; i < 3; i++)
+		{
+			extent[i] = std::fabs(model[0][i]) * localExtent.x +
+				std::fabs(model[1][i]) * localExtent.y +
+				std::fabs(model[2][i]) * localExtent.z;
+		}
+
+		for (int p = 0; p < 6; p++)
+		{
+			glm::vec3 n(planes[p]);
+			float distance = glm::dot(n, center) + planes[p].w;
+			float radius = glm::dot(glm::abs(n), extent);
+			if (distance + radius < 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	// squared distance from the camera to the object's oriented bounding box
+	float distanceToBoxSquared(const glm::mat4& model, const glm::vec3& localMin, const glm::vec3& localMax,
+		const glm::vec3& localCamera, const glm::vec3& camera)
+	{
+		glm::vec3 closest = glm::clamp(localCamera, localMin, localMax);
+		glm::vec3 offset = glm::vec3(model * glm::vec4(closest, 1.0f)) - camera;
+		return glm::dot(offset, offset);
+	}
+
+	bool closerFirst(const DrawCommand& a, const DrawCommand& b)
+	{
+		return a.viewDepth < b.viewDepth;
+	}
+}
+
+FramePreparer::FramePreparer()
+{
+	this->front = 0;
+	this->generation = 0;
+	this->pendingWorkers = 0;
+	this->inFlight = false;
+	this->ready = false;
+	this->quit = false;
+}
+
+FramePreparer::~FramePreparer()
+{
+	stop();
+}
+
+void FramePreparer::start(unsigned workerCount)
+{
+	if (!workers.empty())
+		return;
+
+	if (workerCount == 0)
+	{
+		unsigned hardware = std::thread::hardware_concurrency();
+		// leave one core for the GL thread
+		workerCount = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	quit = false;
+	resizeSlices(workerCount);
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::thread(&FramePreparer::workerLoop, this, i));
+	}
+}
+
+void FramePreparer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	workCondition.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+	workers.clear();
+	inFlight = false;
+}
+
+void FramePreparer::kick(FrameInput&& frame)
+{
+	// a frame is still being prepared, it has to be consumed first
+	if (inFlight)
+		acquire();
+
+	if (workers.empty())
+	{
+		// not started, prepare inline so acquire() still works
+		input = std::move(frame);
+		resizeSlices(1);
+		lightBins.build(input.lights, input.view, input.projection);
+		packets[1 - front].clusterRanges.resize(CLUSTER_COUNT);
+		prepareSlice(0);
+		binLights(0);
+		mergeSlices();
+		ready = true;
+		inFlight = true;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		input = std::move(frame);
+		// one cheap pass over the lights, the binning itself is split up
+		lightBins.build(input.lights, input.view, input.projection);
+		packets[1 - front].clusterRanges.resize(CLUSTER_COUNT);
+		ready = false;
+		pendingWorkers = (unsigned)workers.size();
+		generation++;
+	}
+	inFlight = true;
+	workCondition.notify_all();
+}
+
+const RenderPacket& FramePreparer::acquire()
+{
+	if (inFlight)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return ready; });
+		inFlight = false;
+		front = 1 - front;
+	}
+	return packets[front];
+}
+
+void FramePreparer::workerLoop(unsigned index)
+{
+	unsigned seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workCondition.wait(lock, [&] { return quit || generation != seenGeneration; });
+			if (quit)
+				return;
+			seenGeneration = generation;
+		}
+
+		// the input is not touched by anyone else until every worker is done
+		prepareSlice(index);
+		binLights(index);
+
+		bool last = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = (--pendingWorkers == 0);
+		}
+
+		if (last)
+		{
+			mergeSlices();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				ready = true;
+			}
+			doneCondition.notify_all();
+		}
+	}
+}
+
+void FramePreparer::prepareSlice(unsigned index)
+{
+	std::vector<DrawCommand>& commands = sliceCommands[index];
+	commands.clear();
+	sliceCulled[index] = 0;
+	sliceImpostors[index].clear();
+	sliceStaticCasters[index].clear();
+	sliceDynamicCasters[index].clear();
+
+	size_t count = input.objects.size();
+	size_t workerCount = sliceCommands.size();
+	size_t begin = count * index / workerCount;
+	size_t end = count * (index + 1) / workerCount;
+
+	glm::mat4 viewProjection = input.projection * input.view;
+	glm::vec4 planes[6];
+	extractFrustumPlanes(viewProjection, planes);
+
+	for (size_t i = begin; i < end; i++)
+	{
+		const RenderObject& object = input.objects[i];
+		glm::mat4 model = composeModelMatrix(object.position, object.rotation, object.scale);
+
+		if (object.shadow != CASTS_NO_SHADOW)
+		{
+			ShadowCaster caster;
+			caster.mesh = object.mesh;
+			caster.MVP = input.shadowViewProjection * model;
+			if (object.shadow == CASTS_STATIC_SHADOW)
+				sliceStaticCasters[index].push_back(caster);
+			else
+				sliceDynamicCasters[index].push_back(caster);
+		}
+
+		if (isOutsideFrustum(planes, model, object.mesh->boundsMin, object.mesh->boundsMax))
+		{
+			sliceCulled[index]++;
+			continue;
+		}
+
+		if (object.impostor && object.impostor->isBaked())
+		{
+			glm::mat4 inverseModel = glm::inverse(model);
+			glm::vec3 localCamera = glm::vec3(inverseModel * glm::vec4(input.cameraPos, 1.0f));
+			float swap = object.impostor->getSwapDistance();
+			if (distanceToBoxSquared(model, object.impostor->getBoundsMin(), object.impostor->getBoundsMax(),
+				localCamera, input.cameraPos) > swap * swap)
+			{
+				ImpostorCommand impostor;
+				impostor.impostor = object.impostor;
+				impostor.MVP = viewProjection * model;
+				impostor.normalMatrix = glm::transpose(glm::mat3(inverseModel));
+				impostor.localCamera = localCamera;
+				impostor.sunDirection = glm::normalize(input.uniforms.lightPos - object.position);
+				sliceImpostors[index].push_back(impostor);
+				continue;
+			}
+		}
+
+		DrawCommand command;
+		command.mesh = object.mesh;
+		command.shader = object.shader;
+		command.model = model;
+		command.MVP = viewProjection * model;
+
+		glm::vec3 offset = object.position - input.cameraPos;
+		command.viewDepth = glm::dot(offset, offset);
+		commands.push_back(command);
+	}
+
+	// front-to-back inside the slice, slices are merged afterwards
+	std::sort(commands.begin(), commands.end(), closerFirst);
+}
+
+void FramePreparer::resizeSlices(unsigned count)
+{
+	sliceCommands.resize(count);
+	sliceImpostors.resize(count);
+	sliceCulled.resize(count, 0);
+	sliceStaticCasters.resize(count);
+	sliceDynamicCasters.resize(count);
+	sliceLightIndices.resize(count);
+	binScratch.resize(count);
+}
+
+void FramePreparer::binLights(unsigned index)
+{
+	// each worker owns a run of depth slices, their grid entries don't overlap
+	unsigned workerCount = (unsigned)sliceLightIndices.size();
+	int begin = (int)(CLUSTERS_Z * index / workerCount);
+	int end = (int)(CLUSTERS_Z * (index + 1) / workerCount);
+
+	sliceLightIndices[index].clear();
+	lightBins.binSlices(begin, end, &packets[1 - front].clusterRanges[0], sliceLightIndices[index], binScratch[index]);
+}
+
+void FramePreparer::mergeSlices()
+{
+	RenderPacket& packet = packets[1 - front];
+	packet.view = input.view;
+	packet.projection = input.projection;
+	packet.cameraPos = input.cameraPos;
+	packet.uniforms = input.uniforms;
+	packet.culledCount = 0;
+	packet.commands.clear();
+	packet.impostors.clear();
+	packet.shadowViewProjection = input.shadowViewProjection;
+	packet.staticShadowVersion = input.staticShadowVersion;
+	packet.staticCasters.clear();
+	packet.dynamicCasters.clear();
+
+	for (size_t i = 0; i < sliceCommands.size(); i++)
+	{
+		size_t middle = packet.commands.size();
+		packet.commands.insert(packet.commands.end(), sliceCommands[i].begin(), sliceCommands[i].end());
+		std::inplace_merge(packet.commands.begin(), packet.commands.begin() + middle, packet.commands.end(), closerFirst);
+		packet.culledCount += sliceCulled[i];
+		packet.impostors.insert(packet.impostors.end(), sliceImpostors[i].begin(), sliceImpostors[i].end());
+		packet.staticCasters.insert(packet.staticCasters.end(), sliceStaticCasters[i].begin(), sliceStaticCasters[i].end());
+		packet.dynamicCasters.insert(packet.dynamicCasters.end(), sliceDynamicCasters[i].begin(), sliceDynamicCasters[i].end());
+	}
+
+	packet.lightData.clear();
+	for (const PointLight& light : input.lights)
+	{
+		packet.lightData.push_back(glm::vec4(light.position, light.radius));
+		packet.lightData.push_back(glm::vec4(light.color, 0.0f));
+	}
+
+	// worker index lists were relative to themselves, make them one list
+	packet.clusterLights.clear();
+	unsigned workerCount = (unsigned)sliceLightIndices.size();
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		unsigned base = (unsigned)packet.clusterLights.size();
+		int begin = (int)(CLUSTERS_Z * i / workerCount) * CLUSTERS_X * CLUSTERS_Y;
+		int end = (int)(CLUSTERS_Z * (i + 1) / workerCount) * CLUSTERS_X * CLUSTERS_Y;
+		for (int c = begin; c < end; c++)
+			packet.clusterRanges[c].offset += base;
+		packet.clusterLights.insert(packet.clusterLights.end(), sliceLightIndices[i].begin(), sliceLightIndices[i].end());
+	}
+
+	// the terrain quadtree walk is cheap, one worker does it
+	packet.terrain = input.terrain;
+	packet.terrainShader = input.terrainShader;
+	packet.terrainPatches.clear();
+	if (input.terrain)
+	{
+		glm::vec4 planes[6];
+		extractFrustumPlanes(input.projection * input.view, planes);
+		input.terrain->select(input.cameraPos, planes, packet.terrainPatches);
+	}
+
+	packet.clusterNear = lightBins.getNearPlane();
+	packet.clusterLogDepthRange = lightBins.getLogDepthRange();
+	packet.visibleLights = lightBins.getVisibleCount();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "renderPacket.h"
+
+// Builds render packets on worker threads. While the GL thread replays the
+// packet of frame N, the workers cull, build matrices, multiply MVPs and sort
+// the snapshot of frame N+1 into the other packet (double buffered).
+// Shadow casters get their sun MVP in the same pass, before camera culling,
+// and far objects with an impostor are turned into impostor quads.
+// Each worker also bins the lights of its share of the cluster depth slices.
+class FramePreparer
+{
+	private:
+		FrameInput input;
+		RenderPacket packets[2];
+		int front;
+
+		// per worker output, merged by whichever worker finishes last
+		std::vector<std::vector<DrawCommand>> sliceCommands;
+		std::vector<std::vector<ImpostorCommand>> sliceImpostors;
+		std::vector<size_t> sliceCulled;
+		std::vector<std::vector<ShadowCaster>> sliceStaticCasters;
+		std::vector<std::vector<ShadowCaster>> sliceDynamicCasters;
+		std::vector<std::vector<unsigned>> sliceLightIndices;
+		std::vector<LightBinScratch> binScratch;
+		LightBins lightBins;
+
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable workCondition;
+		std::condition_variable doneCondition;
+		unsigned generation;
+		unsigned pendingWorkers;
+		bool inFlight;
+		bool ready;
+		bool quit;
+
+		void workerLoop(unsigned index);
+		void prepareSlice(unsigned index);
+		void binLights(unsigned index);
+		void resizeSlices(unsigned count);
+		void mergeSlices();
+
+	public:
+		FramePreparer();
+		~FramePreparer();
+
+		// spawn the workers, 0 picks one per spare hardware thread
+		void start(unsigned workerCount = 0);
+		void stop();
+
+		// hand the snapshot of the next frame to the workers, returns at once
+		void kick(FrameInput&& frame);
+
+		// wait for the kicked frame and make it the front packet.
+		// The returned packet stays valid until the next acquire().
+		const RenderPacket& acquire();
+
+		bool isInFlight() const { return inFlight; }
+		unsigned getWorkerCount() const { return (unsigned)workers.size(); }
+};
@@ -0,0 +1,145 @@
+#include "glStateCache.h"
+
+GLuint GLStateCache::program = GLStateCache::UNKNOWN;
+GLuint GLStateCache::vao = GLStateCache::UNKNOWN;
+GLenum GLStateCache::activeUnit = GLStateCache::UNKNOWN;
+GLuint GLStateCache::texture2D[GLStateCache::MAX_TEXTURE_UNITS];
+GLuint GLStateCache::textureCube[GLStateCache::MAX_TEXTURE_UNITS];
+GLenum GLStateCache::depthFunction = GLStateCache::UNKNOWN;
+int GLStateCache::depthTest = -1;
+int GLStateCache::blend = -1;
+int GLStateCache::stencilTest = -1;
+int GLStateCache::cullFace = -1;
+
+unsigned GLStateCache::elided = 0;
+unsigned GLStateCache::issued = 0;
+unsigned GLStateCache::lastElided = 0;
+unsigned GLStateCache::lastIssued = 0;
+
+namespace
+{
+	// the texture tables start out unknown as well
+	struct TextureTableInit
+	{
+		TextureTableInit() { GLStateCache::invalidate(); }
+	} textureTableInit;
+}
+
+bool GLStateCache::changed(GLuint& current, GLuint value)
+{
+	if (current == value)
+	{
+		elided++;
+		return false;
+	}
+	current = value;
+	issued++;
+	return true;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+	if (changed(GLStateCache::program, program))
+		glUseProgram(program);
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+	if (changed(GLStateCache::vao, vao))
+		glBindVertexArray(vao);
+}
+
+void GLStateCache::activeTexture(GLenum unit)
+{
+	if (changed(activeUnit, unit))
+		glActiveTexture(unit);
+}
+
+void GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+	GLuint index = activeUnit - GL_TEXTURE0;
+	bool tracked = activeUnit != UNKNOWN && index < MAX_TEXTURE_UNITS &&
+		(target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP);
+
+	if (!tracked)
+	{
+		issued++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	GLuint& current = target == GL_TEXTURE_2D ? texture2D[index] : textureCube[index];
+	if (changed(current, texture))
+		glBindTexture(target, texture);
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+	if (changed(depthFunction, func))
+		glDepthFunc(func);
+}
+
+int* GLStateCache::capabilityState(GLenum cap)
+{
+	switch (cap)
+	{
+		case GL_DEPTH_TEST: return &depthTest;
+		case GL_BLEND: return &blend;
+		case GL_STENCIL_TEST: return &stencilTest;
+		case GL_CULL_FACE: return &cullFace;
+		default: return nullptr;
+	}
+}
+
+void GLStateCache::enable(GLenum cap)
+{
+	int* state = capabilityState(cap);
+	if (state && *state == 1)
+	{
+		elided++;
+		return;
+	}
+	if (state)
+		*state = 1;
+	issued++;
+	glEnable(cap);
+}
+
+void GLStateCache::disable(GLenum cap)
+{
+	int* state = capabilityState(cap);
+	if (state && *state == 0)
+	{
+		elided++;
+		return;
+	}
+	if (state)
+		*state = 0;
+	issued++;
+	glDisable(cap);
+}
+
+void GLStateCache::invalidate()
+{
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		texture2D[i] = UNKNOWN;
+		textureCube[i] = UNKNOWN;
+	}
+	depthFunction = UNKNOWN;
+	depthTest = -1;
+	blend = -1;
+	stencilTest = -1;
+	cullFace = -1;
+}
+
+void GLStateCache::beginFrame()
+{
+	lastElided = elided;
+	lastIssued = issued;
+	elided = 0;
+	issued = 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glew.h>
+
+// Thin shadow copy of the GL state the engine touches most: program, VAO,
+// texture units, depth function and a few capabilities. Calls that would set
+// what is already current are skipped and counted.
+// Only the thread that owns the context may use it.
+class GLStateCache
+{
+	public:
+		static const int MAX_TEXTURE_UNITS = 16;
+
+		static void useProgram(GLuint program);
+		static void bindVertexArray(GLuint vao);
+		static void activeTexture(GLenum unit);
+		// binds on the currently active unit, like glBindTexture
+		static void bindTexture(GLenum target, GLuint texture);
+		static void depthFunc(GLenum func);
+		static void enable(GLenum cap);
+		static void disable(GLenum cap);
+
+		// forget everything, the next call of each kind goes through.
+		// Needed after code that changes GL state behind the cache's back.
+		static void invalidate();
+
+		// start a new frame of counters
+		static void beginFrame();
+		static unsigned getElidedCalls() { return lastElided; }
+		static unsigned getIssuedCalls() { return lastIssued; }
+
+	private:
+		static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+		static GLuint program;
+		static GLuint vao;
+		static GLenum activeUnit;
+		static GLuint texture2D[MAX_TEXTURE_UNITS];
+		static GLuint textureCube[MAX_TEXTURE_UNITS];
+		static GLenum depthFunction;
+		static int depthTest;	// -1 unknown, 0 off, 1 on
+		static int blend;
+		static int stencilTest;
+		static int cullFace;
+
+		static unsigned elided;
+		static unsigned issued;
+		static unsigned lastElided;
+		static unsigned lastIssued;
+
+		static int* capabilityState(GLenum cap);
+		static bool changed(GLuint& current, GLuint value);
+};
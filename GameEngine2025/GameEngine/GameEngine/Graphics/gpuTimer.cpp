@@ -0,0 +1,84 @@
+#include "gpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+	for (int i = 0; i < RING_SIZE; i++)
+	{
+		this->queries[i] = 0;
+		this->pending[i] = false;
+	}
+	this->current = 0;
+	this->running = false;
+	this->lastMilliseconds = 0.0f;
+	this->sampleCount = 0;
+}
+
+GpuTimer::~GpuTimer()
+{
+	release();
+}
+
+void GpuTimer::init()
+{
+	if (queries[0] == 0)
+		glGenQueries(RING_SIZE, queries);
+}
+
+void GpuTimer::release()
+{
+	if (queries[0] != 0)
+		glDeleteQueries(RING_SIZE, queries);
+	for (int i = 0; i < RING_SIZE; i++)
+	{
+		queries[i] = 0;
+		pending[i] = false;
+	}
+}
+
+void GpuTimer::begin()
+{
+	if (queries[0] == 0 || running)
+		return;
+
+	collect();
+
+	// every query in the ring is still in flight, skip this frame
+	if (pending[current])
+		return;
+
+	glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	running = true;
+}
+
+void GpuTimer::end()
+{
+	if (!running)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[current] = true;
+	current = (current + 1) % RING_SIZE;
+	running = false;
+}
+
+void GpuTimer::collect()
+{
+	// oldest first, stop at the first one that isn't done yet
+	for (int n = 0; n < RING_SIZE; n++)
+	{
+		int i = (current + n) % RING_SIZE;
+		if (!pending[i])
+			continue;
+
+		GLint available = 0;
+		glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &nanoseconds);
+		lastMilliseconds = nanoseconds / 1000000.0f;
+		sampleCount++;
+		pending[i] = false;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glew.h>
+
+// Measures GPU time between begin() and end() with GL_TIME_ELAPSED queries.
+// Results arrive a few frames late, so the queries rotate through a ring and
+// are only read once the driver says they are available (no stalls).
+class GpuTimer
+{
+	private:
+		static const int RING_SIZE = 4;
+
+		GLuint queries[RING_SIZE];
+		bool pending[RING_SIZE];
+		int current;
+		bool running;
+		float lastMilliseconds;
+		unsigned sampleCount;
+
+		void collect();
+
+	public:
+		GpuTimer();
+		~GpuTimer();
+
+		// needs a current GL context
+		void init();
+		void release();
+
+		void begin();
+		void end();
+
+		// latest finished measurement, 0 until the first one arrives
+		float getMilliseconds() const { return lastMilliseconds; }
+		// measurements collected so far, changes when a new one arrives
+		unsigned getSampleCount() const { return sampleCount; }
+};
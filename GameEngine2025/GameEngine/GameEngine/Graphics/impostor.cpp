@@ -0,0 +1,155 @@
+#include "impostor.h"
+#include "glStateCache.h"
+#include "..\Model Loading\mesh.h"
+#include "..\Shaders\shaderVariants.h"
+#include <gtc\matrix_transform.hpp>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+	GLuint createAtlas(int size)
+	{
+		GLuint texture;
+		glGenTextures(1, &texture);
+		GLStateCache::bindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		return texture;
+	}
+
+	// must match the quad basis built in impostor_vertex.glsl
+	glm::vec3 viewUp(const glm::vec3& direction)
+	{
+		return std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+Impostor::Impostor()
+{
+	this->albedoAtlas = 0;
+	this->normalDepthAtlas = 0;
+	this->frames = 0;
+	this->frameSize = 0;
+	this->boundsMin = glm::vec3(0.0f);
+	this->boundsMax = glm::vec3(0.0f);
+	this->center = glm::vec3(0.0f);
+	this->radius = 0.0f;
+	this->swapDistance = 150.0f;
+}
+
+Impostor::~Impostor()
+{
+	release();
+}
+
+bool Impostor::bake(const Mesh& mesh, ShaderVariants& bakeShaders, int frames, int frameSize)
+{
+	release();
+	this->frames = frames;
+	this->frameSize = frameSize;
+	this->boundsMin = mesh.boundsMin;
+	this->boundsMax = mesh.boundsMax;
+	this->center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+	this->radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f;
+	int size = frames * frameSize;
+
+	GLint previousFbo = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	albedoAtlas = createAtlas(size);
+	normalDepthAtlas = createAtlas(size);
+
+	GLuint depthBuffer;
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoAtlas, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalDepthAtlas, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	if (complete)
+	{
+		// empty texels have zero coverage, the views don't overlap so one depth clear does
+		const GLfloat empty[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		const GLfloat farDepth = 1.0f;
+		glClearBufferfv(GL_COLOR, 0, empty);
+		glClearBufferfv(GL_COLOR, 1, empty);
+		glClearBufferfv(GL_DEPTH, 0, &farDepth);
+
+		GLStateCache::enable(GL_DEPTH_TEST);
+		GLStateCache::depthFunc(GL_LESS);
+		Shader& shader = bakeShaders.get(mesh.packed ? SHADER_PACKED : 0);
+		shader.use();
+		GLuint MatrixID = glGetUniformLocation(shader.getId(), "MVP");
+
+		// orthographic views from 2 radii away, the center lands at depth 0.5
+		glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+		for (int y = 0; y < frames; y++)
+		{
+			for (int x = 0; x < frames; x++)
+			{
+				glm::vec3 direction = frameDirection(x, y, frames);
+				glm::mat4 view = glm::lookAt(center + direction * (2.0f * radius), center, viewUp(direction));
+				glm::mat4 MVP = projection * view;
+
+				glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+				glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
+				mesh.draw(shader);
+			}
+		}
+
+		GLStateCache::activeTexture(GL_TEXTURE0);
+		GLStateCache::bindTexture(GL_TEXTURE_2D, albedoAtlas);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		GLStateCache::bindTexture(GL_TEXTURE_2D, normalDepthAtlas);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteRenderbuffers(1, &depthBuffer);
+
+	if (!complete)
+	{
+		std::cout << "Error creating " << size << "x" << size << " impostor atlas!" << std::endl;
+		release();
+	}
+	return complete;
+}
+
+void Impostor::release()
+{
+	if (albedoAtlas) glDeleteTextures(1, &albedoAtlas);
+	if (normalDepthAtlas) glDeleteTextures(1, &normalDepthAtlas);
+	albedoAtlas = 0;
+	normalDepthAtlas = 0;
+
+	// deleted names may be handed out again, don't let the cache skip their binds
+	GLStateCache::invalidate();
+}
+
+glm::vec3 Impostor::frameDirection(int x, int y, int frames)
+{
+	// view centers on [-1, 1]^2, unfolded back onto the upper half octahedron
+	float gx = (x + 0.5f) / frames * 2.0f - 1.0f;
+	float gy = (y + 0.5f) / frames * 2.0f - 1.0f;
+	float dx = (gx + gy) * 0.5f;
+	float dz = (gx - gy) * 0.5f;
+	float dy = 1.0f - std::fabs(dx) - std::fabs(dz);
+	return glm::normalize(glm::vec3(dx, dy, dz));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+
+class Mesh;
+class ShaderVariants;
+
+// Octahedral impostor of a static mesh. The mesh is rendered from a grid of
+// directions over the upper hemisphere (hemi-octahedral mapping, the camera
+// never looks at the world from below) into two atlases: albedo + coverage
+// and mesh-space normal + depth. Far away the renderer swaps the mesh for a
+// single quad that blends the four views closest to the camera direction.
+class Impostor
+{
+	private:
+		GLuint albedoAtlas;
+		GLuint normalDepthAtlas;
+		int frames;		// views per atlas side
+		int frameSize;	// pixels per view
+
+		// mesh-space bounds, the views are framed on the bounding sphere
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		glm::vec3 center;
+		float radius;
+
+		float swapDistance;
+
+	public:
+		Impostor();
+		~Impostor();
+
+		// renders the views, needs a current GL context. The bake shaders are
+		// impostor_bake_vertex/fragment, PACKED_VERTEX is picked for packed meshes.
+		bool bake(const Mesh& mesh, ShaderVariants& bakeShaders, int frames = 8, int frameSize = 256);
+		void release();
+		bool isBaked() const { return albedoAtlas != 0; }
+
+		// the impostor is used once the camera is further than this from the
+		// mesh's oriented bounding box
+		void setSwapDistance(float distance) { swapDistance = distance; }
+		float getSwapDistance() const { return swapDistance; }
+
+		GLuint getAlbedoAtlas() const { return albedoAtlas; }
+		GLuint getNormalDepthAtlas() const { return normalDepthAtlas; }
+		int getFrames() const { return frames; }
+		const glm::vec3& getBoundsMin() const { return boundsMin; }
+		const glm::vec3& getBoundsMax() const { return boundsMax; }
+		const glm::vec3& getCenter() const { return center; }
+		float getRadius() const { return radius; }
+
+		// mesh-space direction of view (x, y) of the grid, y up.
+		// impostor_vertex.glsl has the inverse mapping.
+		static glm::vec3 frameDirection(int x, int y, int frames);
+};
@@ -0,0 +1,182 @@
+#include "lightClusters.h"
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+namespace
+{
+	// padding entries that can never overlap a slice or a tile
+	const float NO_DEPTH = 1e30f;
+	const int NO_TILE = 1 << 30;
+
+	int tileIndex(float ndc, int tiles)
+	{
+		int tile = (int)std::floor((ndc * 0.5f + 0.5f) * tiles);
+		return std::max(0, std::min(tiles - 1, tile));
+	}
+}
+
+LightBins::LightBins()
+{
+	this->nearPlane = 0.1f;
+	this->logDepthRange = 1.0f;
+	this->count = 0;
+}
+
+float LightBins::sliceDepth(int slice) const
+{
+	return nearPlane * std::exp(logDepthRange * slice / CLUSTERS_Z);
+}
+
+void LightBins::push(unsigned index, float zMin, float zMax, int x0, int x1, int y0, int y1)
+{
+	depthMin.push_back(zMin);
+	depthMax.push_back(zMax);
+	tileMinX.push_back(x0);
+	tileMaxX.push_back(x1);
+	tileMinY.push_back(y0);
+	tileMaxY.push_back(y1);
+	lightIndex.push_back(index);
+}
+
+void LightBins::build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection)
+{
+	// near and far from a standard perspective matrix
+	float a = projection[2][2];
+	float b = projection[3][2];
+	nearPlane = b / (a - 1.0f);
+	float farPlane = b / (a + 1.0f);
+	logDepthRange = std::log(farPlane / nearPlane);
+
+	depthMin.clear();
+	depthMax.clear();
+	tileMinX.clear();
+	tileMaxX.clear();
+	tileMinY.clear();
+	tileMaxY.clear();
+	lightIndex.clear();
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		const PointLight& light = lights[i];
+		glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		float depth = -center.z;
+		float r = light.radius;
+
+		// entirely behind the camera or past the far plane
+		if (depth + r < nearPlane || depth - r > farPlane)
+			continue;
+
+		int x0 = 0, x1 = CLUSTERS_X - 1;
+		int y0 = 0, y1 = CLUSTERS_Y - 1;
+
+		// sphere crossing the near plane covers an unknown part of the screen,
+		// otherwise use the projected corners of its view space box
+		if (depth - r > nearPlane)
+		{
+			glm::vec2 ndcMin(1e30f), ndcMax(-1e30f);
+			for (int c = 0; c < 8; c++)
+			{
+				glm::vec3 corner = center + glm::vec3((c & 1) ? r : -r, (c & 2) ? r : -r, (c & 4) ? r : -r);
+				glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+
+			if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+				continue;
+
+			x0 = tileIndex(ndcMin.x, CLUSTERS_X);
+			x1 = tileIndex(ndcMax.x, CLUSTERS_X);
+			y0 = tileIndex(ndcMin.y, CLUSTERS_Y);
+			y1 = tileIndex(ndcMax.y, CLUSTERS_Y);
+		}
+
+		push((unsigned)i, depth - r, depth + r, x0, x1, y0, y1);
+	}
+
+	count = lightIndex.size();
+	while (lightIndex.size() % 4 != 0)
+		push(0, NO_DEPTH, -NO_DEPTH, NO_TILE, -1, NO_TILE, -1);
+}
+
+void LightBins::binSlices(int sliceBegin, int sliceEnd, ClusterRange* grid,
+	std::vector<unsigned>& indices, LightBinScratch& scratch) const
+{
+	size_t padded = lightIndex.size();
+
+	for (int z = sliceBegin; z < sliceEnd; z++)
+	{
+		// lights whose depth range touches this slice, four at a time
+		__m128 sliceNear = _mm_set1_ps(sliceDepth(z));
+		__m128 sliceFar = _mm_set1_ps(sliceDepth(z + 1));
+
+		scratch.minX.clear();
+		scratch.maxX.clear();
+		scratch.minY.clear();
+		scratch.maxY.clear();
+		scratch.light.clear();
+
+		for (size_t i = 0; i < padded; i += 4)
+		{
+			__m128 zMin = _mm_loadu_ps(&depthMin[i]);
+			__m128 zMax = _mm_loadu_ps(&depthMax[i]);
+			int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(zMin, sliceFar), _mm_cmpge_ps(zMax, sliceNear)));
+
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (!(mask & (1 << lane)))
+					continue;
+				scratch.minX.push_back(tileMinX[i + lane]);
+				scratch.maxX.push_back(tileMaxX[i + lane]);
+				scratch.minY.push_back(tileMinY[i + lane]);
+				scratch.maxY.push_back(tileMaxY[i + lane]);
+				scratch.light.push_back(lightIndex[i + lane]);
+			}
+		}
+
+		size_t sliceCount = scratch.light.size();
+		while (scratch.light.size() % 4 != 0)
+		{
+			scratch.minX.push_back(NO_TILE);
+			scratch.maxX.push_back(-1);
+			scratch.minY.push_back(NO_TILE);
+			scratch.maxY.push_back(-1);
+			scratch.light.push_back(0);
+		}
+
+		// then the screen tiles of the slice against those lights
+		for (int y = 0; y < CLUSTERS_Y; y++)
+		{
+			__m128i tileY = _mm_set1_epi32(y);
+			for (int x = 0; x < CLUSTERS_X; x++)
+			{
+				__m128i tileX = _mm_set1_epi32(x);
+				ClusterRange& range = grid[(z * CLUSTERS_Y + y) * CLUSTERS_X + x];
+				range.offset = (unsigned)indices.size();
+
+				for (size_t i = 0; i < sliceCount; i += 4)
+				{
+					__m128i minX = _mm_loadu_si128((const __m128i*)&scratch.minX[i]);
+					__m128i maxX = _mm_loadu_si128((const __m128i*)&scratch.maxX[i]);
+					__m128i minY = _mm_loadu_si128((const __m128i*)&scratch.minY[i]);
+					__m128i maxY = _mm_loadu_si128((const __m128i*)&scratch.maxY[i]);
+
+					__m128i outside = _mm_or_si128(
+						_mm_or_si128(_mm_cmpgt_epi32(minX, tileX), _mm_cmpgt_epi32(tileX, maxX)),
+						_mm_or_si128(_mm_cmpgt_epi32(minY, tileY), _mm_cmpgt_epi32(tileY, maxY)));
+					int inside = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+
+					for (int lane = 0; lane < 4; lane++)
+					{
+						if (inside & (1 << lane))
+							indices.push_back(scratch.light[i + lane]);
+					}
+				}
+
+				range.count = (unsigned)indices.size() - range.offset;
+			}
+		}
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <glm.hpp>
+#include <vector>
+
+// A dynamic point light, color already multiplied by its intensity
+struct PointLight
+{
+	glm::vec3 position;
+	float radius;
+	glm::vec3 color;
+
+	PointLight(const glm::vec3& position, float radius, const glm::vec3& color)
+		: position(position), radius(radius), color(color) {}
+};
+
+// The view frustum is cut into CLUSTERS_X x CLUSTERS_Y screen tiles and
+// CLUSTERS_Z depth slices that grow exponentially from the near plane.
+// fragment_shader.glsl (CLUSTERED) finds its cluster the same way.
+const int CLUSTERS_X = 16;
+const int CLUSTERS_Y = 9;
+const int CLUSTERS_Z = 24;
+const int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+// a cluster's slice of the light index list
+struct ClusterRange
+{
+	unsigned offset;
+	unsigned count;
+};
+
+// reusable per-thread storage for binSlices()
+struct LightBinScratch
+{
+	std::vector<int> minX, maxX, minY, maxY;
+	std::vector<unsigned> light;
+};
+
+// Cluster-space bounds of every visible light of a frame, kept as padded
+// structure of arrays so the binning can test four lights per SSE op.
+// build() runs once per frame, binSlices() can then run on several threads
+// for disjoint slice ranges.
+class LightBins
+{
+	private:
+		float nearPlane;
+		float logDepthRange;	// log(far / near)
+		size_t count;
+
+		std::vector<float> depthMin, depthMax;
+		std::vector<int> tileMinX, tileMaxX, tileMinY, tileMaxY;
+		std::vector<unsigned> lightIndex;	// into the input list
+
+		void push(unsigned index, float zMin, float zMax, int x0, int x1, int y0, int y1);
+
+	public:
+		LightBins();
+
+		void build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection);
+
+		// bin slices [sliceBegin, sliceEnd): fills their entries of grid with
+		// offsets relative to the start of indices and appends to indices
+		void binSlices(int sliceBegin, int sliceEnd, ClusterRange* grid,
+			std::vector<unsigned>& indices, LightBinScratch& scratch) const;
+
+		// view depth where a slice starts, slice CLUSTERS_Z is the far plane
+		float sliceDepth(int slice) const;
+
+		float getNearPlane() const { return nearPlane; }
+		float getLogDepthRange() const { return logDepthRange; }
+		size_t getVisibleCount() const { return count; }
+};
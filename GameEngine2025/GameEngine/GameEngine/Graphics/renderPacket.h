@@ -0,0 +1,142 @@
+#pragma once
+
+#include <glm.hpp>
+#include <gtc\matrix_transform.hpp>
+#include <vector>
+#include "lightClusters.h"
+
+class Impostor;
+class Mesh;
+class Shader;
+class Terrain;
+
+// Builds a model matrix the same way Platform does:
+// translate, rotate around Y then X then Z (radians), then scale
+inline glm::mat4 composeModelMatrix(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale)
+{
+	glm::mat4 model(1.0f);
+	model = glm::translate(model, position);
+	model = glm::rotate(model, rotation.y, glm::vec3(0, 1, 0));
+	model = glm::rotate(model, rotation.x, glm::vec3(1, 0, 0));
+	model = glm::rotate(model, rotation.z, glm::vec3(0, 0, 1));
+	model = glm::scale(model, scale);
+	return model;
+}
+
+// How an object takes part in the sun's shadow map
+enum ShadowCasting
+{
+	CASTS_NO_SHADOW,
+	CASTS_STATIC_SHADOW,	// drawn into the cached map, see ShadowMap
+	CASTS_DYNAMIC_SHADOW	// drawn again every frame
+};
+
+// One drawable as captured from the scene on the main thread.
+// Only plain transform values are copied, the workers build the matrices.
+struct RenderObject
+{
+	const Mesh* mesh;
+	Shader* shader;
+	glm::vec3 position;
+	glm::vec3 rotation;
+	glm::vec3 scale;
+	ShadowCasting shadow;
+	const Impostor* impostor;	// drawn instead of the mesh when far enough, may be null
+
+	RenderObject(const Mesh* mesh, Shader* shader, const glm::vec3& position,
+		const glm::vec3& rotation = glm::vec3(0.0f), const glm::vec3& scale = glm::vec3(1.0f),
+		ShadowCasting shadow = CASTS_NO_SHADOW)
+		: mesh(mesh), shader(shader), position(position), rotation(rotation), scale(scale), shadow(shadow), impostor(nullptr) {}
+};
+
+// Uniforms that are the same for every draw of a frame
+struct FrameUniforms
+{
+	glm::vec3 lightPos;
+	glm::vec3 lightColor;
+	glm::vec3 viewPos;
+};
+
+// Snapshot of the scene handed to the frame preparer
+struct FrameInput
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPos;
+	FrameUniforms uniforms;
+	std::vector<RenderObject> objects;
+	std::vector<PointLight> lights;
+
+	// sun shadow camera, and a counter bumped whenever a static caster moves
+	glm::mat4 shadowViewProjection;
+	unsigned staticShadowVersion;
+
+	// heightfield ground, its patches are picked by the preparer (may be null)
+	const Terrain* terrain;
+	Shader* terrainShader;
+
+	FrameInput() : shadowViewProjection(1.0f), staticShadowVersion(0), terrain(nullptr), terrainShader(nullptr) {}
+};
+
+// A fully prepared draw, nothing left to compute on the GL thread
+struct DrawCommand
+{
+	const Mesh* mesh;
+	Shader* shader;
+	glm::mat4 MVP;
+	glm::mat4 model;
+	float viewDepth;	// squared distance from the camera, sort key
+};
+
+// A far mesh replaced by its impostor quad
+struct ImpostorCommand
+{
+	const Impostor* impostor;
+	glm::mat4 MVP;
+	glm::mat3 normalMatrix;
+	glm::vec3 localCamera;	// camera in mesh space
+	glm::vec3 sunDirection;
+};
+
+// A draw into the shadow map, the MVP is the sun's
+struct ShadowCaster
+{
+	const Mesh* mesh;
+	glm::mat4 MVP;
+};
+
+// Culled, sorted and packed draws of one frame. Immutable once the
+// preparer publishes it, so the GL thread can replay it without locking.
+struct RenderPacket
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 cameraPos;
+	FrameUniforms uniforms;
+	std::vector<DrawCommand> commands;
+	std::vector<ImpostorCommand> impostors;
+	size_t culledCount;
+
+	// clustered lights, laid out exactly as the shader reads them
+	std::vector<glm::vec4> lightData;	// per light: position + radius, color + 0
+	std::vector<ClusterRange> clusterRanges;	// CLUSTER_COUNT entries
+	std::vector<unsigned> clusterLights;	// light indices, see ClusterRange
+	float clusterNear;
+	float clusterLogDepthRange;
+	size_t visibleLights;
+
+	// shadow casters are not culled against the camera, they can be off screen
+	glm::mat4 shadowViewProjection;
+	unsigned staticShadowVersion;
+	std::vector<ShadowCaster> staticCasters;
+	std::vector<ShadowCaster> dynamicCasters;
+
+	// terrain patches: corner xz, size, level (see Terrain::select)
+	const Terrain* terrain;
+	Shader* terrainShader;
+	std::vector<glm::vec4> terrainPatches;
+
+	RenderPacket() : view(1.0f), projection(1.0f), cameraPos(0.0f), culledCount(0),
+		clusterNear(0.1f), clusterLogDepthRange(1.0f), visibleLights(0),
+		shadowViewProjection(1.0f), staticShadowVersion(0), terrain(nullptr), terrainShader(nullptr) {}
+};
@@ -0,0 +1,84 @@
+#include "renderTarget.h"
+#include <iostream>
+
+RenderTarget::RenderTarget()
+{
+	this->fbo = 0;
+	this->colorBuffer = 0;
+	this->depthStencilBuffer = 0;
+	this->capacityWidth = 0;
+	this->capacityHeight = 0;
+	this->width = 0;
+	this->height = 0;
+}
+
+RenderTarget::~RenderTarget()
+{
+	release();
+}
+
+bool RenderTarget::ensureCapacity(int width, int height)
+{
+	if (fbo && width <= capacityWidth && height <= capacityHeight)
+		return true;
+
+	release();
+	capacityWidth = width;
+	capacityHeight = height;
+
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	// stencil is needed by the overdraw counter
+	glGenRenderbuffers(1, &depthStencilBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthStencilBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilBuffer);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete)
+	{
+		std::cout << "Error creating render target " << width << "x" << height << "!" << std::endl;
+		release();
+	}
+	return complete;
+}
+
+void RenderTarget::release()
+{
+	if (fbo) glDeleteFramebuffers(1, &fbo);
+	if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+	if (depthStencilBuffer) glDeleteRenderbuffers(1, &depthStencilBuffer);
+	fbo = 0;
+	colorBuffer = 0;
+	depthStencilBuffer = 0;
+	capacityWidth = 0;
+	capacityHeight = 0;
+}
+
+void RenderTarget::bind(int width, int height)
+{
+	this->width = width < capacityWidth ? width : capacityWidth;
+	this->height = height < capacityHeight ? height : capacityHeight;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glViewport(0, 0, this->width, this->height);
+}
+
+void RenderTarget::blitToScreen(int screenWidth, int screenHeight)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, screenWidth, screenHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, screenWidth, screenHeight);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glew.h>
+
+// Offscreen color + depth/stencil framebuffer. Storage is allocated for the
+// full window once, frames may then render into any smaller corner of it so
+// changing the resolution scale never reallocates.
+class RenderTarget
+{
+	private:
+		GLuint fbo;
+		GLuint colorBuffer;
+		GLuint depthStencilBuffer;
+		int capacityWidth, capacityHeight;
+		int width, height;	// area in use this frame
+
+	public:
+		RenderTarget();
+		~RenderTarget();
+
+		// (re)allocate if the storage is smaller than the request
+		bool ensureCapacity(int width, int height);
+		void release();
+
+		// draw into the lower left width x height corner
+		void bind(int width, int height);
+
+		// stretch the used area over the whole default framebuffer and make
+		// the default framebuffer current again
+		void blitToScreen(int screenWidth, int screenHeight);
+
+		int getWidth() const { return width; }
+		int getHeight() const { return height; }
+};
@@ -0,0 +1,346 @@
+#include "renderer.h"
+#include "glStateCache.h"
+#include "impostor.h"
+#include "terrain.h"
+#include "..\Objects\skybox.h"
+
+Renderer::Renderer()
+{
+	this->packet = nullptr;
+	this->depthShaders = nullptr;
+	this->impostorShader = nullptr;
+	this->impostorVao = 0;
+	this->impostorVbo = 0;
+	this->viewportWidth = 1;
+	this->viewportHeight = 1;
+	for (int i = 0; i < 3; i++)
+	{
+		this->lightBuffers[i] = 0;
+		this->lightTextures[i] = 0;
+	}
+	this->depthPrepass = false;
+	this->overdrawDebug = false;
+	this->averageOverdraw = 0.0f;
+	this->overdrawCoverage = 0.0f;
+}
+
+Renderer::~Renderer()
+{
+	delete depthShaders;
+	delete impostorShader;
+}
+
+void Renderer::init()
+{
+	depthShaders = new ShaderVariants("Shaders/depth_vertex.glsl", "Shaders/depth_fragment.glsl");
+	depthShaders->get(0);
+
+	glGenBuffers(3, lightBuffers);
+	glGenTextures(3, lightTextures);
+	GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, lightTextures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], lightBuffers[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	shadowMap.init();
+
+	impostorShader = new Shader("Shaders/impostor_vertex.glsl", "Shaders/impostor_fragment.glsl");
+	const float corners[8] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+	glGenVertexArrays(1, &impostorVao);
+	glGenBuffers(1, &impostorVbo);
+	GLStateCache::bindVertexArray(impostorVao);
+	glBindBuffer(GL_ARRAY_BUFFER, impostorVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	GLStateCache::bindVertexArray(0);
+}
+
+void Renderer::release()
+{
+	if (lightTextures[0])
+		glDeleteTextures(3, lightTextures);
+	if (lightBuffers[0])
+		glDeleteBuffers(3, lightBuffers);
+	for (int i = 0; i < 3; i++)
+	{
+		lightBuffers[i] = 0;
+		lightTextures[i] = 0;
+	}
+	shadowMap.release();
+
+	if (impostorVao) glDeleteVertexArrays(1, &impostorVao);
+	if (impostorVbo) glDeleteBuffers(1, &impostorVbo);
+	impostorVao = 0;
+	impostorVbo = 0;
+}
+
+void Renderer::beginFrame(const RenderPacket& packet, int width, int height)
+{
+	this->packet = &packet;
+	this->viewportWidth = width > 0 ? width : 1;
+	this->viewportHeight = height > 0 ? height : 1;
+
+	uploadLights();
+
+	// unit 4 is the sun's shadow map
+	shadowMap.render(packet, *depthShaders);
+	GLStateCache::activeTexture(GL_TEXTURE4);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, shadowMap.getTexture());
+	GLStateCache::activeTexture(GL_TEXTURE0);
+
+	if (overdrawDebug)
+	{
+		// every fragment that passes the depth test bumps its pixel's stencil value
+		GLStateCache::enable(GL_STENCIL_TEST);
+		glStencilFunc(GL_ALWAYS, 0, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+	}
+}
+
+void Renderer::drawOpaque()
+{
+	if (!packet)
+		return;
+
+	if (depthPrepass && depthShaders)
+	{
+		drawDepthPrepass();
+
+		// depth is already final, shade only the visible surface
+		GLStateCache::depthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+		drawShadingPass();
+		glDepthMask(GL_TRUE);
+		GLStateCache::depthFunc(GL_LESS);
+	}
+	else
+	{
+		drawShadingPass();
+	}
+}
+
+void Renderer::drawDepthPrepass()
+{
+	// the prepass must not touch the overdraw counters
+	if (overdrawDebug)
+		glStencilMask(0x00);
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	Shader* current = nullptr;
+	GLuint MatrixID = 0;
+
+	for (const DrawCommand& command : packet->commands)
+	{
+		// packed meshes need the variant that decodes their positions
+		Shader* wanted = &depthShaders->get(command.mesh->packed ? SHADER_PACKED : 0);
+		if (wanted != current)
+		{
+			current = wanted;
+			current->use();
+			MatrixID = glGetUniformLocation(current->getId(), "MVP");
+		}
+
+		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &command.MVP[0][0]);
+		command.mesh->drawGeometry(*current);
+	}
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	if (overdrawDebug)
+		glStencilMask(0xFF);
+}
+
+void Renderer::drawShadingPass()
+{
+	const FrameUniforms& uniforms = packet->uniforms;
+	Shader* current = nullptr;
+	GLuint MatrixID = 0;
+	GLuint ModelMatrixID = 0;
+
+	for (const DrawCommand& command : packet->commands)
+	{
+		if (command.shader != current)
+		{
+			current = command.shader;
+			current->use();
+			MatrixID = glGetUniformLocation(current->getId(), "MVP");
+			ModelMatrixID = glGetUniformLocation(current->getId(), "model");
+
+			// per-frame uniforms, programs that don't use them get location -1
+			glUniform3f(glGetUniformLocation(current->getId(), "lightColor"), uniforms.lightColor.x, uniforms.lightColor.y, uniforms.lightColor.z);
+			glUniform3f(glGetUniformLocation(current->getId(), "lightPos"), uniforms.lightPos.x, uniforms.lightPos.y, uniforms.lightPos.z);
+			glUniform3f(glGetUniformLocation(current->getId(), "viewPos"), uniforms.viewPos.x, uniforms.viewPos.y, uniforms.viewPos.z);
+			setLightUniforms(*current);
+			setShadowUniforms(*current);
+		}
+
+		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &command.MVP[0][0]);
+		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &command.model[0][0]);
+		command.mesh->draw(*current);
+	}
+}
+
+void Renderer::uploadLights()
+{
+	// orphan and refill, the GPU may still be reading last frame's lists
+	const void* data[3] = { packet->lightData.data(), packet->clusterRanges.data(), packet->clusterLights.data() };
+	size_t sizes[3] = {
+		packet->lightData.size() * sizeof(glm::vec4),
+		packet->clusterRanges.size() * sizeof(ClusterRange),
+		packet->clusterLights.size() * sizeof(unsigned)
+	};
+
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizes[i] > 0 ? sizes[i] : 16, NULL, GL_STREAM_DRAW);
+		if (sizes[i] > 0)
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// units 1-3, unit 0 stays with the diffuse textures
+	for (int i = 0; i < 3; i++)
+	{
+		GLStateCache::activeTexture(GL_TEXTURE1 + i);
+		GLStateCache::bindTexture(GL_TEXTURE_BUFFER, lightTextures[i]);
+	}
+	GLStateCache::activeTexture(GL_TEXTURE0);
+}
+
+void Renderer::setLightUniforms(Shader& shader)
+{
+	// programs without the CLUSTERED feature get location -1 for all of these
+	GLuint id = shader.getId();
+	glUniform1i(glGetUniformLocation(id, "lightData"), 1);
+	glUniform1i(glGetUniformLocation(id, "clusterRanges"), 2);
+	glUniform1i(glGetUniformLocation(id, "clusterLights"), 3);
+	glUniform3i(glGetUniformLocation(id, "clusterCount"), CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z);
+	glUniform2f(glGetUniformLocation(id, "clusterScreenSize"), (float)viewportWidth, (float)viewportHeight);
+	glUniform2f(glGetUniformLocation(id, "clusterDepth"), packet->clusterNear, packet->clusterLogDepthRange);
+	glUniformMatrix4fv(glGetUniformLocation(id, "view"), 1, GL_FALSE, &packet->view[0][0]);
+}
+
+void Renderer::setShadowUniforms(Shader& shader)
+{
+	// clip space of the sun to [0, 1] texture space
+	static const glm::mat4 bias(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, 0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.5f, 0.0f,
+		0.5f, 0.5f, 0.5f, 1.0f);
+	glm::mat4 shadowMatrix = bias * packet->shadowViewProjection;
+
+	GLuint id = shader.getId();
+	glUniform1i(glGetUniformLocation(id, "shadowMap"), 4);
+	glUniformMatrix4fv(glGetUniformLocation(id, "shadowMatrix"), 1, GL_FALSE, &shadowMatrix[0][0]);
+}
+
+void Renderer::drawTerrain()
+{
+	if (!packet || !packet->terrain || !packet->terrainShader || packet->terrainPatches.empty())
+		return;
+
+	Shader& shader = *packet->terrainShader;
+	shader.use();
+	GLuint id = shader.getId();
+
+	const FrameUniforms& uniforms = packet->uniforms;
+	glm::mat4 viewProjection = packet->projection * packet->view;
+	glUniformMatrix4fv(glGetUniformLocation(id, "viewProjection"), 1, GL_FALSE, &viewProjection[0][0]);
+	glUniform3f(glGetUniformLocation(id, "cameraPos"), packet->cameraPos.x, packet->cameraPos.y, packet->cameraPos.z);
+	glUniform3f(glGetUniformLocation(id, "lightColor"), uniforms.lightColor.x, uniforms.lightColor.y, uniforms.lightColor.z);
+	glUniform3f(glGetUniformLocation(id, "lightPos"), uniforms.lightPos.x, uniforms.lightPos.y, uniforms.lightPos.z);
+	glUniform3f(glGetUniformLocation(id, "viewPos"), uniforms.viewPos.x, uniforms.viewPos.y, uniforms.viewPos.z);
+	setLightUniforms(shader);
+	setShadowUniforms(shader);
+
+	packet->terrain->draw(packet->terrainPatches, shader);
+}
+
+void Renderer::drawImpostors()
+{
+	if (!packet || packet->impostors.empty() || !impostorShader)
+		return;
+
+	impostorShader->use();
+	GLuint id = impostorShader->getId();
+	GLuint MatrixID = glGetUniformLocation(id, "MVP");
+	GLuint NormalMatrixID = glGetUniformLocation(id, "normalMatrix");
+	GLuint CameraID = glGetUniformLocation(id, "localCamera");
+	GLuint SunID = glGetUniformLocation(id, "sunDirection");
+	GLuint CenterID = glGetUniformLocation(id, "center");
+	GLuint RadiusID = glGetUniformLocation(id, "radius");
+	GLuint FramesID = glGetUniformLocation(id, "frames");
+
+	// units 5 and 6, the scene's textures, lights and shadow map stay bound
+	glUniform1i(glGetUniformLocation(id, "albedoAtlas"), 5);
+	glUniform1i(glGetUniformLocation(id, "normalDepthAtlas"), 6);
+	GLStateCache::bindVertexArray(impostorVao);
+
+	for (const ImpostorCommand& command : packet->impostors)
+	{
+		const Impostor& impostor = *command.impostor;
+		GLStateCache::activeTexture(GL_TEXTURE5);
+		GLStateCache::bindTexture(GL_TEXTURE_2D, impostor.getAlbedoAtlas());
+		GLStateCache::activeTexture(GL_TEXTURE6);
+		GLStateCache::bindTexture(GL_TEXTURE_2D, impostor.getNormalDepthAtlas());
+
+		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &command.MVP[0][0]);
+		glUniformMatrix3fv(NormalMatrixID, 1, GL_FALSE, &command.normalMatrix[0][0]);
+		glUniform3f(CameraID, command.localCamera.x, command.localCamera.y, command.localCamera.z);
+		glUniform3f(SunID, command.sunDirection.x, command.sunDirection.y, command.sunDirection.z);
+		glUniform3f(CenterID, impostor.getCenter().x, impostor.getCenter().y, impostor.getCenter().z);
+		glUniform1f(RadiusID, impostor.getRadius());
+		glUniform1f(FramesID, (float)impostor.getFrames());
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+
+	GLStateCache::activeTexture(GL_TEXTURE0);
+}
+
+void Renderer::drawSkybox(Skybox& skybox)
+{
+	if (packet)
+		skybox.draw(packet->view, packet->projection);
+}
+
+void Renderer::endFrame(int width, int height)
+{
+	if (!overdrawDebug)
+		return;
+
+	GLStateCache::disable(GL_STENCIL_TEST);
+	resolveOverdraw(width, height);
+}
+
+void Renderer::resolveOverdraw(int width, int height)
+{
+	if (width <= 0 || height <= 0)
+		return;
+
+	// debug only: this readback stalls the pipeline
+	stencilReadback.resize((size_t)width * height);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, &stencilReadback[0]);
+
+	unsigned long long shaded = 0;
+	unsigned long long overdrawn = 0;
+	for (unsigned char count : stencilReadback)
+	{
+		shaded += count;
+		if (count > 1)
+			overdrawn++;
+	}
+
+	float pixels = (float)stencilReadback.size();
+	averageOverdraw = shaded / pixels;
+	overdrawCoverage = overdrawn / pixels;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "renderPacket.h"
+#include "shadowMap.h"
+#include "..\Model Loading\mesh.h"
+#include "..\Shaders\shader.h"
+#include "..\Shaders\shaderVariants.h"
+
+class Skybox;
+
+// Replays prepared render packets on the GL thread: opaques front-to-back,
+// optionally behind a position-only depth prepass, with the skybox last.
+// The sun's shadow map is brought up to date before the opaques.
+class Renderer
+{
+	private:
+		const RenderPacket* packet;
+		ShaderVariants* depthShaders;	// plain and PACKED_VERTEX
+		int viewportWidth, viewportHeight;
+
+		// buffer textures with the packet's clustered lights:
+		// light data, cluster ranges, light indices
+		GLuint lightBuffers[3];
+		GLuint lightTextures[3];
+
+		ShadowMap shadowMap;
+
+		// one quad shared by every impostor
+		Shader* impostorShader;
+		GLuint impostorVao, impostorVbo;
+
+		bool depthPrepass;
+		bool overdrawDebug;
+
+		// overdraw stats from the last counted frame
+		float averageOverdraw;
+		float overdrawCoverage;	// fraction of pixels shaded more than once
+		std::vector<unsigned char> stencilReadback;
+
+		void drawDepthPrepass();
+		void drawShadingPass();
+		void resolveOverdraw(int width, int height);
+		void uploadLights();
+		void setLightUniforms(Shader& shader);
+		void setShadowUniforms(Shader& shader);
+
+	public:
+		Renderer();
+		~Renderer();
+
+		// sets up the depth prepass programs, light buffers and the shadow map,
+		// needs a current GL context
+		void init();
+		void release();
+
+		// the packet must stay untouched until endFrame(),
+		// the size is the viewport the scene is drawn into.
+		// Renders the shadow map and leaves the bound framebuffer as it was.
+		void beginFrame(const RenderPacket& packet, int width, int height);
+
+		// draw the packet's opaques, already culled and sorted by the preparer
+		void drawOpaque();
+
+		// heightfield ground, after the opaques so covered ground is depth rejected
+		void drawTerrain();
+
+		// far meshes swapped for their impostor quads, after the opaques
+		void drawImpostors();
+
+		// skybox goes after every opaque so it only fills uncovered pixels
+		void drawSkybox(Skybox& skybox);
+
+		// finish the frame, reads the overdraw counters back if enabled
+		void endFrame(int width, int height);
+
+		void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+		bool isDepthPrepassEnabled() const { return depthPrepass; }
+
+		void setOverdrawDebug(bool enabled) { overdrawDebug = enabled; }
+		bool isOverdrawDebugEnabled() const { return overdrawDebug; }
+
+		float getAverageOverdraw() const { return averageOverdraw; }
+		float getOverdrawCoverage() const { return overdrawCoverage; }
+		size_t getOpaqueCount() const { return packet ? packet->commands.size() : 0; }
+		size_t getCulledCount() const { return packet ? packet->culledCount : 0; }
+		size_t getImpostorCount() const { return packet ? packet->impostors.size() : 0; }
+		size_t getTerrainPatchCount() const { return packet ? packet->terrainPatches.size() : 0; }
+		size_t getLightCount() const { return packet ? packet->lightData.size() / 2 : 0; }
+		size_t getVisibleLightCount() const { return packet ? packet->visibleLights : 0; }
+		size_t getClusterLightReferences() const { return packet ? packet->clusterLights.size() : 0; }
+		size_t getDynamicCasterCount() const { return packet ? packet->dynamicCasters.size() : 0; }
+		unsigned getShadowCacheRebuilds() const { return shadowMap.getCacheRebuilds(); }
+};
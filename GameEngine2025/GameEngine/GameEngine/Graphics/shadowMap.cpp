@@ -0,0 +1,156 @@
+#include "shadowMap.h"
+#include "glStateCache.h"
+#include "..\Model Loading\mesh.h"
+#include "..\Shaders\shaderVariants.h"
+#include <iostream>
+
+ShadowMap::ShadowMap()
+{
+	this->staticFbo = 0;
+	this->staticDepth = 0;
+	this->frameFbo = 0;
+	this->frameDepth = 0;
+	this->size = 0;
+	this->cacheValid = false;
+	this->cachedVersion = 0;
+	this->cachedViewProjection = glm::mat4(1.0f);
+	this->cacheRebuilds = 0;
+}
+
+ShadowMap::~ShadowMap()
+{
+	release();
+}
+
+bool ShadowMap::init(int size)
+{
+	release();
+	this->size = size;
+
+	if (!createTarget(staticFbo, staticDepth) || !createTarget(frameFbo, frameDepth))
+	{
+		std::cout << "Error creating " << size << "x" << size << " shadow map!" << std::endl;
+		release();
+		return false;
+	}
+
+	cacheValid = false;
+	return true;
+}
+
+bool ShadowMap::createTarget(GLuint& fbo, GLuint& texture)
+{
+	glGenTextures(1, &texture);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// outside the map counts as lit
+	float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+
+	// sampler2DShadow, the hardware does the depth compare and filters it
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+void ShadowMap::release()
+{
+	if (staticFbo) glDeleteFramebuffers(1, &staticFbo);
+	if (frameFbo) glDeleteFramebuffers(1, &frameFbo);
+	if (staticDepth) glDeleteTextures(1, &staticDepth);
+	if (frameDepth) glDeleteTextures(1, &frameDepth);
+	staticFbo = 0;
+	frameFbo = 0;
+	staticDepth = 0;
+	frameDepth = 0;
+	cacheValid = false;
+
+	// deleted names may be handed out again, don't let the cache skip their binds
+	GLStateCache::invalidate();
+}
+
+void ShadowMap::render(const RenderPacket& packet, ShaderVariants& depthShaders)
+{
+	if (!frameFbo)
+		return;
+
+	GLint previousFbo = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFbo);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	glViewport(0, 0, size, size);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);	// keeps lit surfaces from shadowing themselves
+
+	// the static world only changes when something static moves or the sun does
+	if (!cacheValid || cachedVersion != packet.staticShadowVersion ||
+		cachedViewProjection != packet.shadowViewProjection)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, staticFbo);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		drawCasters(packet.staticCasters, depthShaders);
+
+		cacheValid = true;
+		cachedVersion = packet.staticShadowVersion;
+		cachedViewProjection = packet.shadowViewProjection;
+		cacheRebuilds++;
+	}
+
+	// start from the cache, then add whatever moves
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameFbo);
+	glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, frameFbo);
+	drawCasters(packet.dynamicCasters, depthShaders);
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFbo);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+void ShadowMap::drawCasters(const std::vector<ShadowCaster>& casters, ShaderVariants& depthShaders)
+{
+	Shader* current = nullptr;
+	GLuint MatrixID = 0;
+
+	for (const ShadowCaster& caster : casters)
+	{
+		Shader* wanted = &depthShaders.get(caster.mesh->packed ? SHADER_PACKED : 0);
+		if (wanted != current)
+		{
+			current = wanted;
+			current->use();
+			MatrixID = glGetUniformLocation(current->getId(), "MVP");
+		}
+
+		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &caster.MVP[0][0]);
+		caster.mesh->drawGeometry(*current);
+	}
+}
+
+glm::mat4 ShadowMap::sunViewProjection(const glm::vec3& lightPos, const glm::vec3& center, float radius)
+{
+	float distance = glm::length(lightPos - center);
+	glm::mat4 view = glm::lookAt(lightPos, center, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, distance - radius, distance + radius);
+	return projection * view;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "renderPacket.h"
+
+class ShaderVariants;
+
+// Depth map for the fixed sun. The static world is drawn once into a cached
+// map and only redrawn when the packet says the static casters changed; every
+// frame the cache is copied into the sampled map and just the dynamic casters
+// are drawn on top of it.
+class ShadowMap
+{
+	private:
+		GLuint staticFbo, staticDepth;	// cache, never sampled
+		GLuint frameFbo, frameDepth;	// cache + dynamic casters, sampled by the scene
+		int size;
+
+		bool cacheValid;
+		unsigned cachedVersion;
+		glm::mat4 cachedViewProjection;
+		unsigned cacheRebuilds;
+
+		bool createTarget(GLuint& fbo, GLuint& texture);
+		void drawCasters(const std::vector<ShadowCaster>& casters, ShaderVariants& depthShaders);
+
+	public:
+		ShadowMap();
+		~ShadowMap();
+
+		// allocates both maps, needs a current GL context
+		bool init(int size = 2048);
+		void release();
+
+		// Brings the sampled map up to date for the packet. Restores the
+		// framebuffer and viewport that were bound before.
+		void render(const RenderPacket& packet, ShaderVariants& depthShaders);
+
+		// force the static casters to be drawn again next frame
+		void invalidate() { cacheValid = false; }
+
+		GLuint getTexture() const { return frameDepth; }
+		unsigned getCacheRebuilds() const { return cacheRebuilds; }
+
+		// orthographic sun camera looking from lightPos at a sphere around center
+		static glm::mat4 sunViewProjection(const glm::vec3& lightPos, const glm::vec3& center, float radius);
+};
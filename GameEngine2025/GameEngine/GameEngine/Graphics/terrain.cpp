@@ -0,0 +1,287 @@
+#include "terrain.h"
+#include "glStateCache.h"
+#include "..\Shaders\shader.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	bool boxOutsideFrustum(const glm::vec4 planes[6], const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		for (int p = 0; p < 6; p++)
+		{
+			// the corner furthest along the plane normal
+			glm::vec3 corner(
+				planes[p].x >= 0.0f ? boxMax.x : boxMin.x,
+				planes[p].y >= 0.0f ? boxMax.y : boxMin.y,
+				planes[p].z >= 0.0f ? boxMax.z : boxMin.z);
+			if (glm::dot(glm::vec3(planes[p]), corner) + planes[p].w < 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	bool sphereTouchesBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+	{
+		glm::vec3 offset = glm::clamp(center, boxMin, boxMax) - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+}
+
+Terrain::Terrain()
+{
+	this->heightfield = nullptr;
+	this->leafSize = 32.0f;
+	this->textureScale = glm::vec2(1.0f / 32.0f);
+	this->topNodesX = 0;
+	this->topNodesZ = 0;
+	this->heightTexture = 0;
+	this->diffuseTexture = 0;
+	this->vao = 0;
+	this->vbo = 0;
+	this->ibo = 0;
+	this->instanceVbo = 0;
+	this->indexCount = 0;
+
+	// each level covers twice the distance of the one before, the last one everything
+	const float ranges[LOD_LEVELS] = { 96.0f, 192.0f, 384.0f, 100000.0f };
+	setLodRanges(ranges);
+}
+
+Terrain::~Terrain()
+{
+	release();
+}
+
+void Terrain::setLodRanges(const float ranges[LOD_LEVELS])
+{
+	for (int i = 0; i < LOD_LEVELS; i++)
+		lodRanges[i] = ranges[i];
+}
+
+bool Terrain::init(const Heightfield& heightfield, GLuint diffuseTexture, float leafSize)
+{
+	release();
+	this->heightfield = &heightfield;
+	this->diffuseTexture = diffuseTexture;
+	this->leafSize = leafSize;
+
+	float topSize = leafSize * (1 << (LOD_LEVELS - 1));
+	glm::vec2 extent = heightfield.getExtent();
+	topNodesX = std::max((int)std::ceil(extent.x / topSize), 1);
+	topNodesZ = std::max((int)std::ceil(extent.y / topSize), 1);
+	buildNodeHeights();
+
+	// heights as a float texture, filtered like the CPU queries
+	glGenTextures(1, &heightTexture);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, heightTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, heightfield.getSamplesX(), heightfield.getSamplesZ(), 0,
+		GL_RED, GL_FLOAT, heightfield.getSamples().data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, 0);
+
+	// one grid shared by every patch, [0, 1]^2
+	std::vector<glm::vec2> grid;
+	for (int z = 0; z <= GRID_RESOLUTION; z++)
+	{
+		for (int x = 0; x <= GRID_RESOLUTION; x++)
+			grid.push_back(glm::vec2((float)x, (float)z) / (float)GRID_RESOLUTION);
+	}
+
+	std::vector<unsigned> indices;
+	int row = GRID_RESOLUTION + 1;
+	for (int z = 0; z < GRID_RESOLUTION; z++)
+	{
+		for (int x = 0; x < GRID_RESOLUTION; x++)
+		{
+			unsigned corner = z * row + x;
+			indices.push_back(corner);
+			indices.push_back(corner + row);
+			indices.push_back(corner + 1);
+			indices.push_back(corner + 1);
+			indices.push_back(corner + row);
+			indices.push_back(corner + row + 1);
+		}
+	}
+	indexCount = (GLsizei)indices.size();
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ibo);
+	glGenBuffers(1, &instanceVbo);
+
+	GLStateCache::bindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(glm::vec2), &grid[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), &indices[0], GL_STATIC_DRAW);
+
+	// per patch: corner xz, size, level
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+	glVertexAttribDivisor(3, 1);
+
+	GLStateCache::bindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return true;
+}
+
+void Terrain::release()
+{
+	if (heightTexture) glDeleteTextures(1, &heightTexture);
+	if (vao) glDeleteVertexArrays(1, &vao);
+	if (vbo) glDeleteBuffers(1, &vbo);
+	if (ibo) glDeleteBuffers(1, &ibo);
+	if (instanceVbo) glDeleteBuffers(1, &instanceVbo);
+	heightTexture = 0;
+	vao = 0;
+	vbo = 0;
+	ibo = 0;
+	instanceVbo = 0;
+	indexCount = 0;
+
+	// deleted names may be handed out again, don't let the cache skip their binds
+	GLStateCache::invalidate();
+}
+
+void Terrain::buildNodeHeights()
+{
+	nodeHeights.assign(LOD_LEVELS, std::vector<glm::vec2>());
+	glm::vec2 origin = heightfield->getOrigin();
+
+	// leaves scan the heightfield, every other level merges its four children
+	nodeHeights[0].resize((size_t)nodesX(0) * nodesZ(0));
+	for (int z = 0; z < nodesZ(0); z++)
+	{
+		for (int x = 0; x < nodesX(0); x++)
+		{
+			glm::vec2 corner = origin + glm::vec2((float)x, (float)z) * leafSize;
+			glm::vec2& range = nodeHeights[0][(size_t)z * nodesX(0) + x];
+			heightfield->getHeightRange(corner, corner + glm::vec2(leafSize), range.x, range.y);
+		}
+	}
+
+	for (int level = 1; level < LOD_LEVELS; level++)
+	{
+		const std::vector<glm::vec2>& children = nodeHeights[level - 1];
+		int childRow = nodesX(level - 1);
+		nodeHeights[level].resize((size_t)nodesX(level) * nodesZ(level));
+		for (int z = 0; z < nodesZ(level); z++)
+		{
+			for (int x = 0; x < nodesX(level); x++)
+			{
+				glm::vec2 range = children[(size_t)(2 * z) * childRow + 2 * x];
+				for (int i = 1; i < 4; i++)
+				{
+					const glm::vec2& child = children[(size_t)(2 * z + i / 2) * childRow + 2 * x + i % 2];
+					range.x = std::min(range.x, child.x);
+					range.y = std::max(range.y, child.y);
+				}
+				nodeHeights[level][(size_t)z * nodesX(level) + x] = range;
+			}
+		}
+	}
+}
+
+void Terrain::select(const glm::vec3& cameraPos, const glm::vec4 planes[6], std::vector<glm::vec4>& patches) const
+{
+	patches.clear();
+	if (!heightfield)
+		return;
+
+	for (int z = 0; z < topNodesZ; z++)
+	{
+		for (int x = 0; x < topNodesX; x++)
+			selectNode(LOD_LEVELS - 1, x, z, cameraPos, planes, patches);
+	}
+}
+
+bool Terrain::selectNode(int level, int x, int z, const glm::vec3& cameraPos, const glm::vec4 planes[6],
+	std::vector<glm::vec4>& patches) const
+{
+	float size = leafSize * (1 << level);
+	glm::vec2 corner = heightfield->getOrigin() + glm::vec2((float)x, (float)z) * size;
+	const glm::vec2& heights = nodeHeights[level][(size_t)z * nodesX(level) + x];
+	glm::vec3 boxMin(corner.x, heights.x, corner.y);
+	glm::vec3 boxMax(corner.x + size, heights.y, corner.y + size);
+
+	// out of this level's range, the parent covers the area with its own grid
+	if (!sphereTouchesBox(cameraPos, lodRanges[level], boxMin, boxMax))
+		return false;
+
+	// handled, just nothing to draw
+	if (boxOutsideFrustum(planes, boxMin, boxMax))
+		return true;
+
+	if (level == 0 || !sphereTouchesBox(cameraPos, lodRanges[level - 1], boxMin, boxMax))
+	{
+		patches.push_back(glm::vec4(corner.x, corner.y, size, (float)level));
+		return true;
+	}
+
+	// finer children where they are in range, quarters of this node's grid elsewhere
+	float half = size * 0.5f;
+	for (int i = 0; i < 4; i++)
+	{
+		int childX = 2 * x + i % 2;
+		int childZ = 2 * z + i / 2;
+		if (!selectNode(level - 1, childX, childZ, cameraPos, planes, patches))
+		{
+			glm::vec2 childCorner = corner + glm::vec2((float)(i % 2), (float)(i / 2)) * half;
+			patches.push_back(glm::vec4(childCorner.x, childCorner.y, half, (float)level));
+		}
+	}
+	return true;
+}
+
+void Terrain::draw(const std::vector<glm::vec4>& patches, Shader& shader) const
+{
+	if (patches.empty() || !vao)
+		return;
+
+	// orphan, last frame's patches may still be in use
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	glBufferData(GL_ARRAY_BUFFER, patches.size() * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, patches.size() * sizeof(glm::vec4), &patches[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// morph into the next level over the last third of each range
+	float morph[LOD_LEVELS * 2];
+	for (int i = 0; i < LOD_LEVELS; i++)
+	{
+		float start = i > 0 ? lodRanges[i - 1] : 0.0f;
+		morph[i * 2] = start + (lodRanges[i] - start) * 0.66f;
+		morph[i * 2 + 1] = lodRanges[i];
+	}
+
+	GLuint id = shader.getId();
+	glm::vec2 origin = heightfield->getOrigin();
+	glUniform2f(glGetUniformLocation(id, "terrainOrigin"), origin.x, origin.y);
+	glUniform1f(glGetUniformLocation(id, "terrainInverseSpacing"), 1.0f / heightfield->getSpacing());
+	glUniform1f(glGetUniformLocation(id, "terrainSpacing"), heightfield->getSpacing());
+	glUniform2f(glGetUniformLocation(id, "heightTexel"), 1.0f / heightfield->getSamplesX(), 1.0f / heightfield->getSamplesZ());
+	glUniform1f(glGetUniformLocation(id, "leafSize"), leafSize);
+	glUniform1f(glGetUniformLocation(id, "gridResolution"), (float)GRID_RESOLUTION);
+	glUniform2fv(glGetUniformLocation(id, "morphRanges"), LOD_LEVELS, morph);
+	glUniform2f(glGetUniformLocation(id, "textureScale"), textureScale.x, textureScale.y);
+	glUniform1i(glGetUniformLocation(id, "heightMap"), 7);
+	glUniform1i(glGetUniformLocation(id, "texture1"), 0);
+
+	// unit 7 for the heights, the diffuse on unit 0 like every other mesh
+	GLStateCache::activeTexture(GL_TEXTURE7);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, heightTexture);
+	GLStateCache::activeTexture(GL_TEXTURE0);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, diffuseTexture);
+
+	GLStateCache::bindVertexArray(vao);
+	glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)patches.size());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glew.h>
+#include <glm.hpp>
+#include <vector>
+#include "..\Algorithms\heightfield.h"
+
+class Shader;
+
+// Heightfield ground drawn with CDLOD: a quadtree of square patches, each one
+// the same grid mesh displaced by the heightmap in the vertex shader. Patches
+// are picked by distance to the camera and vertices morph continuously into
+// the next coarser grid near the end of their range, so there are no seams
+// and no popping. The heightfield itself stays on the CPU for collision.
+class Terrain
+{
+	public:
+		static const int LOD_LEVELS = 4;	// leaf patches and 3 coarser levels
+		static const int GRID_RESOLUTION = 32;	// quads per patch side
+
+	private:
+		const Heightfield* heightfield;
+		float leafSize;		// world size of a level 0 patch
+		float lodRanges[LOD_LEVELS];
+		glm::vec2 textureScale;
+
+		// min/max height per node, one grid per level
+		int topNodesX, topNodesZ;
+		std::vector<std::vector<glm::vec2>> nodeHeights;
+
+		GLuint heightTexture;
+		GLuint diffuseTexture;
+		GLuint vao, vbo, ibo, instanceVbo;
+		GLsizei indexCount;
+
+		int nodesX(int level) const { return topNodesX << (LOD_LEVELS - 1 - level); }
+		int nodesZ(int level) const { return topNodesZ << (LOD_LEVELS - 1 - level); }
+		void buildNodeHeights();
+		bool selectNode(int level, int x, int z, const glm::vec3& cameraPos, const glm::vec4 planes[6],
+			std::vector<glm::vec4>& patches) const;
+
+	public:
+		Terrain();
+		~Terrain();
+
+		// Uploads the heightmap and builds the shared grid, needs a current GL
+		// context. The heightfield must outlive the terrain. The covered area is
+		// rounded up to whole top level patches.
+		bool init(const Heightfield& heightfield, GLuint diffuseTexture, float leafSize = 32.0f);
+		void release();
+
+		// level 0 is used up to ranges[0], level 1 up to ranges[1], ...
+		void setLodRanges(const float ranges[LOD_LEVELS]);
+		// diffuse uv per world unit
+		void setTextureScale(const glm::vec2& scale) { textureScale = scale; }
+
+		// Picks the patches for a camera, thread safe. Each patch is
+		// (x, z of its corner, size, level). The planes are the view frustum's,
+		// pointing inwards.
+		void select(const glm::vec3& cameraPos, const glm::vec4 planes[6], std::vector<glm::vec4>& patches) const;
+
+		// Draws the patches instanced with the terrain_vertex.glsl program,
+		// which the caller has bound with its per-frame uniforms set
+		void draw(const std::vector<glm::vec4>& patches, Shader& shader) const;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single producer / single consumer exchange of the latest value.
+// The producer always has a slot to write into and the consumer always has a
+// complete slot to read from; the third slot sits in the middle and is swapped
+// atomically, tagged when it holds something the consumer hasn't seen yet.
+template <typename T>
+class TripleBuffer
+{
+	private:
+		static const int INDEX_MASK = 0x3;
+		static const int FRESH = 0x4;
+
+		T buffers[3];
+		std::atomic<int> middle;
+		int writeIndex;	// owned by the producer
+		int readIndex;	// owned by the consumer
+
+	public:
+		TripleBuffer() : middle(1), writeIndex(0), readIndex(2) {}
+
+		// producer side: fill this slot completely, then publish it.
+		// The slot handed back afterwards holds stale data from an older frame.
+		T& writeBuffer() { return buffers[writeIndex]; }
+
+		void publish()
+		{
+			int previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+			writeIndex = previous & INDEX_MASK;
+		}
+
+		// consumer side: grab the newest published slot if there is one.
+		// Returns false (and keeps the current slot) when nothing new arrived.
+		bool consume()
+		{
+			if ((middle.load(std::memory_order_acquire) & FRESH) == 0)
+				return false;
+
+			int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+			readIndex = previous & INDEX_MASK;
+			return true;
+		}
+
+		const T& readBuffer() const { return buffers[readIndex]; }
+
+		// either side: a published slot is waiting that the consumer hasn't taken
+		bool isFresh() const { return (middle.load(std::memory_order_acquire) & FRESH) != 0; }
+};
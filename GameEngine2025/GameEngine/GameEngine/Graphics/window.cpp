@@ -43,6 +43,9 @@ void Window::init()
 		std::cout << "Successfully initializing glfw!" << std::endl;
 	}
 
+	// stencil is used by the renderer's overdraw counter
+	glfwWindowHint(GLFW_STENCIL_BITS, 8);
+
 	window = glfwCreateWindow(width, height, name, NULL, NULL);
 
 	if (window == NULL)
@@ -73,16 +76,36 @@ void Window::init()
 }
 
 void Window::update()
+{
+	pollEvents();
+	present(width, height);
+}
+
+void Window::pollEvents()
 {
 	glfwPollEvents();
 	glfwGetFramebufferSize(window, &width, &height);
+}
+
+void Window::present(int width, int height)
+{
 	glViewport(0, 0, width, height);
 	glfwSwapBuffers(window);
 }
 
+void Window::makeContextCurrent()
+{
+	glfwMakeContextCurrent(window);
+}
+
+void Window::releaseContext()
+{
+	glfwMakeContextCurrent(NULL);
+}
+
 void Window::clear()
 {
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 }
 
 GLFWwindow* Window::getWindow()
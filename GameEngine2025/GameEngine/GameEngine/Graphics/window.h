@@ -40,6 +40,13 @@ class Window
 		void update();
 		void clear();
 
+		// update() split in two so input and presentation can run on different threads:
+		// pollEvents() stays on the main thread, present() runs wherever the context is current
+		void pollEvents();
+		void present(int width, int height);
+		void makeContextCurrent();
+		void releaseContext();
+
 		void setKey(int key, bool ok);
 		void setMouseButton(int button, bool ok);
 		void setMousePos(double xpos, double ypos);
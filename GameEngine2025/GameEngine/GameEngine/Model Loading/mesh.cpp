@@ -1,12 +1,14 @@
 #include "mesh.h"
+#include "..\Graphics\glStateCache.h"
 
-Mesh::Mesh() {}
+Mesh::Mesh() : boundsMin(0.0f), boundsMax(0.0f), packed(false), packScale(1.0f), packBias(0.0f) {}
 
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<int> indices)
 {
 	this->vertices = vertices;
 	this->indices = indices;
 
+	computeBounds();
 	setup2();
 }
 
@@ -16,11 +18,12 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<int> indices, std::vector<T
 	this->indices = indices;
 	this->textures = textures;
 
+	computeBounds();
 	setup();
 }
 
 // render the mesh
-void Mesh::draw(Shader shader) const
+void Mesh::draw(Shader& shader) const
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
@@ -29,7 +32,7 @@ void Mesh::draw(Shader shader) const
 
 	for (unsigned int i = 0; i < textures.size(); i++)
 	{
-		glActiveTexture(GL_TEXTURE0 + i); 
+		GLStateCache::activeTexture(GL_TEXTURE0 + i);
 											
 		std::string number;
 		std::string name = textures[i].type;
@@ -43,25 +46,37 @@ void Mesh::draw(Shader shader) const
 			number = std::to_string(heightNr++); 
 
 		glUniform1i(glGetUniformLocation(shader.getId(), (name + number).c_str()), i);
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		GLStateCache::bindTexture(GL_TEXTURE_2D, textures[i].id);
 	}
 
-	glBindVertexArray(vao);
+	if (packed)
+		setPackedUniforms(shader);
+
+	// the VAO stays bound, the next mesh with the same one skips the bind
+	GLStateCache::bindVertexArray(vao);
 	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+}
 
-	glActiveTexture(GL_TEXTURE0);
+void Mesh::drawGeometry(Shader& shader) const
+{
+	if (packed)
+		setPackedUniforms(shader);
+
+	GLStateCache::bindVertexArray(vao);
+	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 }
 
 void Mesh::setup()
 {
+	packed = false;
+
 	//create buffers
 	glGenVertexArrays(1, &vao);
 	glGenBuffers(1, &vbo);
 	glGenBuffers(1, &ibo);
 
 	//bind buffers
-	glBindVertexArray(vao);
+	GLStateCache::bindVertexArray(vao);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
@@ -77,17 +92,19 @@ void Mesh::setup()
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, textureCoords));
 
-	glBindVertexArray(0);
+	GLStateCache::bindVertexArray(0);
 }
 
 //no textures yet
 void Mesh::setup2()
 {
+	packed = false;
+
 	glGenVertexArrays(1, &vao);
 	glGenBuffers(1, &vbo);
 	glGenBuffers(1, &ibo);
 
-	glBindVertexArray(vao);
+	GLStateCache::bindVertexArray(vao);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
@@ -98,7 +115,85 @@ void Mesh::setup2()
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
 
-	glBindVertexArray(0);
+	GLStateCache::bindVertexArray(0);
+}
+
+void Mesh::computeBounds()
+{
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	if (vertices.empty())
+		return;
+
+	boundsMin = vertices[0].pos;
+	boundsMax = vertices[0].pos;
+	for (const auto& v : vertices)
+	{
+		boundsMin = glm::min(boundsMin, v.pos);
+		boundsMax = glm::max(boundsMax, v.pos);
+	}
+}
+
+namespace
+{
+	// signed normalized 10 bit per component, w unused
+	unsigned int packNormal(const glm::vec3& n)
+	{
+		unsigned int result = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			float c = glm::clamp(n[i], -1.0f, 1.0f);
+			int value = (int)floorf(c * 511.0f + 0.5f);
+			result |= ((unsigned int)value & 0x3FF) << (10 * i);
+		}
+		return result;
+	}
+}
+
+void Mesh::pack()
+{
+	if (vertices.empty() || packed)
+		return;
+
+	packBias = (boundsMin + boundsMax) * 0.5f;
+	packScale = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-6f));
+
+	std::vector<PackedVertex> packedVertices(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& v = vertices[i];
+		PackedVertex& p = packedVertices[i];
+
+		glm::vec3 local = glm::clamp((v.pos - packBias) / packScale, -1.0f, 1.0f);
+		for (int c = 0; c < 3; c++)
+			p.pos[c] = (short)floorf(local[c] * 32767.0f + 0.5f);
+		p.pos[3] = 0;
+		p.normal = packNormal(v.normals);
+		p.textureCoords[0] = v.textureCoords.x;
+		p.textureCoords[1] = v.textureCoords.y;
+	}
+
+	GLStateCache::bindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, packedVertices.size() * sizeof(PackedVertex), &packedVertices[0], GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, pos));
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, textureCoords));
+
+	GLStateCache::bindVertexArray(0);
+	packed = true;
+}
+
+void Mesh::setPackedUniforms(Shader& shader) const
+{
+	glUniform3f(glGetUniformLocation(shader.getId(), "positionScale"), packScale.x, packScale.y, packScale.z);
+	glUniform3f(glGetUniformLocation(shader.getId(), "positionBias"), packBias.x, packBias.y, packBias.z);
 }
 
 void Mesh::setTextures(std::vector<Texture> textures)
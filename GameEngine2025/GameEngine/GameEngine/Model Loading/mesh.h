@@ -58,6 +58,15 @@ struct Vertex
 	}
 };
 
+// compact copy of a Vertex for static meshes, 20 bytes instead of 32:
+// snorm16 position over the mesh bounds, 2_10_10_10 normal, float uv
+struct PackedVertex
+{
+	short pos[4];	// xyz + padding
+	unsigned int normal;
+	float textureCoords[2];
+};
+
 struct Texture 
 {
 	unsigned int id;
@@ -73,6 +82,15 @@ class Mesh
 
 		unsigned int vao, vbo, ibo;
 
+		// model-space bounds, used for culling
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+
+		// set by pack(), the shader needs PACKED_VERTEX and these to decode positions
+		bool packed;
+		glm::vec3 packScale;
+		glm::vec3 packBias;
+
 		Mesh();	
 		Mesh(std::vector<Vertex> vertices, std::vector<int> indices, std::vector<Texture> textures);
 		Mesh(std::vector<Vertex> vertices, std::vector<int> indices);
@@ -81,6 +99,14 @@ class Mesh
 		void setTextures(std::vector<Texture> textures);
 		void setup();
 		void setup2();
-		void draw(Shader shader) const;
+		void computeBounds();
+		// re-upload the vertices as PackedVertex, for meshes that never change
+		void pack();
+		void draw(Shader& shader) const;
+		// positions only, no texture binds (depth passes)
+		void drawGeometry(Shader& shader) const;
+
+	private:
+		void setPackedUniforms(Shader& shader) const;
 };
 
@@ -1,4 +1,5 @@
 #include "texture.h"
+#include "..\Graphics\glStateCache.h"
 #include <iostream>
 
 GLuint loadBMP(const char * imagepath) {
@@ -53,7 +54,7 @@ GLuint loadBMP(const char * imagepath) {
 	GLuint textureID;
 	glGenTextures(1, &textureID);
 
-	glBindTexture(GL_TEXTURE_2D, textureID);
+	GLStateCache::bindTexture(GL_TEXTURE_2D, textureID);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
 
@@ -5,6 +5,8 @@ Alien::Alien(Mesh* mesh, glm::vec3 position, float patrolDistance) {
     this->mesh = mesh;
     this->position = position;
     this->startPosition = position;
+    this->previousPosition = position;
+    this->pendingPosition = position;
     this->patrolDistance = patrolDistance;
 
     this->moveSpeed = 15.0f; // Speed of the alien
@@ -25,39 +27,46 @@ Alien::Alien(Mesh* mesh, glm::vec3 position, float patrolDistance) {
 
 Alien::~Alien() {}
 
-void Alien::update(float deltaTime, CollisionManager& collisionManager) {
-    if (dead)
-        return;
+void Alien::update(float deltaTime, const CollisionManager& collisionManager) {
+    CollisionManager::Query probe;
+    if (beginUpdate(deltaTime, probe))
+        endUpdate(collisionManager.resolvePoint(probe), collisionManager);
+}
 
-  
-   
+bool Alien::beginUpdate(float deltaTime, CollisionManager::Query& outProbe) {
+    if (dead)
+        return false;
 
-    // Clamp deltaTime to prevent tunneling on lag spikes
+    // deltaTime is the fixed simulation step, no clamping needed here
     float dt = deltaTime;
-    if (dt > 0.1f)
-        dt = 0.1f;
+    previousPosition = position;
 
     // 1. Apply Gravity
     float gravity = 30.0f; // Strong gravity
     verticalVelocity -= gravity * dt;
 
     // 2. Propose Movement
-    glm::vec3 nextPos = position;
-    nextPos.x += moveSpeed * direction * dt;
-    nextPos.y += verticalVelocity * dt;
-
+    pendingPosition = position;
+    pendingPosition.x += moveSpeed * direction * dt;
+    pendingPosition.y += verticalVelocity * dt;
 
-  
-
-    glm::vec3 collisionProbe = nextPos;
+    // 3. The probe sits at the top, like the player's eye
+    glm::vec3 collisionProbe = pendingPosition;
     collisionProbe.y += height; // Use actual height instead of hardcoded 5.0f
+    outProbe = CollisionManager::Query(collisionProbe, height);
+    outProbe.support = &support;
+    return true;
+}
 
-    if (collisionManager.resolvePointAgainstAll(collisionProbe, height)) {
+void Alien::endUpdate(const CollisionManager::QueryResult& probe, const CollisionManager& collisionManager) {
+    glm::vec3 nextPos = pendingPosition;
+
+    if (probe.resolved) {
        
-        nextPos = collisionProbe;
+        nextPos = probe.position;
         nextPos.y -= height; // Use height here too
 
-        const auto& info = collisionManager.getLastCollisionInfo();
+        const auto& info = probe.lastCollision;
         if (info.face == CollisionManager::ContactFace::Top) {
             // Landed on ground
             verticalVelocity = 0.0f;
@@ -66,18 +75,12 @@ void Alien::update(float deltaTime, CollisionManager& collisionManager) {
             // grounded) Check Wall ahead (using simple bounds check or s   econdary
             // probe) Check Cliff ahead
             glm::vec3 cliffProbe = nextPos;
-            cliffProbe.y += 5.0f;               // Eye height
+            cliffProbe.y -= 1.0f;               // Below the feet
             cliffProbe.x += (direction * 3.0f); // Look ahead
 
-
-            glm::vec3 floorCheck = cliffProbe;
-            floorCheck.y -= 2.0f; // Lower slightly
-
-            // If resolving this point returns FALSE, it means it didn't hit anything
-            // -> Empty space -> Cliff! Warning: resolvePointAgainstAll modifies the
-            // vector. Use a copy.
-            glm::vec3 testPoint = floorCheck;
-            if (!collisionManager.resolvePointAgainstAll(testPoint, 5.0f)) {
+            // If nothing solid is within a unit of there, there's no floor
+            // within 2 units of the feet -> Empty space -> Cliff!
+            if (collisionManager.getDistance(cliffProbe) > 1.0f) {
                 // Cliff ahead!
                 direction *= -1;
                 // std::cout << "Cliff detected! Turning." << std::endl;
@@ -105,6 +108,10 @@ void Alien::update(float deltaTime, CollisionManager& collisionManager) {
         rotation.y = -90.0f;
 }
 
+glm::vec3 Alien::getInterpolatedPosition(float alpha) const {
+    return glm::mix(previousPosition, position, alpha);
+}
+
 void Alien::draw(Shader& shader, const glm::mat4& view,
     const glm::mat4& projection) {
     if (dead)
@@ -114,13 +121,7 @@ void Alien::draw(Shader& shader, const glm::mat4& view,
     GLuint MatrixID = glGetUniformLocation(shader.getId(), "MVP");
     GLuint ModelMatrixID = glGetUniformLocation(shader.getId(), "model");
 
-    glm::mat4 ModelMatrix = glm::translate(glm::mat4(1.0f), position);
-    ModelMatrix = glm::rotate(ModelMatrix, glm::radians(rotation.y),
-        glm::vec3(0.0f, 1.0f, 0.0f));
-    // Visual fix: No extra offset needed - position is already at feet level
-    // The model origin should be at feet, scale handles the rest
-    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
-
+    glm::mat4 ModelMatrix = getModelMatrix();
     glm::mat4 MVP = projection * view * ModelMatrix;
 
     glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
@@ -129,6 +130,16 @@ void Alien::draw(Shader& shader, const glm::mat4& view,
     mesh->draw(shader);
 }
 
+glm::mat4 Alien::getModelMatrix() const {
+    glm::mat4 ModelMatrix = glm::translate(glm::mat4(1.0f), position);
+    ModelMatrix = glm::rotate(ModelMatrix, glm::radians(rotation.y),
+        glm::vec3(0.0f, 1.0f, 0.0f));
+    // Visual fix: No extra offset needed - position is already at feet level
+    // The model origin should be at feet, scale handles the rest
+    ModelMatrix = glm::scale(ModelMatrix, glm::vec3(5.0f, 5.0f, 5.0f));
+    return ModelMatrix;
+}
+
 bool Alien::checkPlayerCollision(glm::vec3 playerPos, glm::vec3 playerVelocity,
     bool& outStomped) {
     if (dead)
@@ -171,3 +182,10 @@ bool Alien::checkPlayerCollision(glm::vec3 playerPos, glm::vec3 playerVelocity,
 
     return false;
 }
+
+void Alien::getContactSphere(glm::vec3& outCenter, float& outRadius) const {
+    // the player's eye counts from the feet up to 2 above the head
+    glm::vec3 half(width / 2.0f, (height + 2.0f) / 2.0f, depth / 2.0f);
+    outCenter = position + glm::vec3(0.0f, half.y, 0.0f);
+    outRadius = glm::length(half);
+}
@@ -13,21 +13,38 @@ public:
     Alien(Mesh* mesh, glm::vec3 position, float patrolDistance = 100.0f);
     ~Alien();
 
-    void update(float deltaTime, CollisionManager& collisionManager);
+    void update(float deltaTime, const CollisionManager& collisionManager);
+    // update() in two halves, so all aliens can resolve in one collision
+    // batch: beginUpdate() moves and fills the probe to resolve (false when
+    // dead), endUpdate() applies the probe's result
+    bool beginUpdate(float deltaTime, CollisionManager::Query& outProbe);
+    void endUpdate(const CollisionManager::QueryResult& probe, const CollisionManager& collisionManager);
     void draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection);
 
     // Collision checks
     // Returns true if player should die
     bool checkPlayerCollision(glm::vec3 playerPos, glm::vec3 playerVelocity,
         bool& outStomped);
+    // sphere around the box checkPlayerCollision tests, for the entity grid
+    void getContactSphere(glm::vec3& outCenter, float& outRadius) const;
 
     bool isDead() const { return dead; }
     glm::vec3 getPosition() const { return position; }
+    // position between the last two updates, alpha in [0, 1]
+    glm::vec3 getInterpolatedPosition(float alpha) const;
+    const Mesh& getMesh() const { return *mesh; }
+    glm::mat4 getModelMatrix() const;
+    // rotation in the radians/Y-X-Z convention of composeModelMatrix
+    glm::vec3 getRotationRadians() const { return glm::radians(rotation); }
+    const CollisionManager::SupportCache& getSupportCache() const { return support; }
 
 private:
     Mesh* mesh; // Shared mesh pointer
     glm::vec3 position;
     glm::vec3 startPosition;
+    glm::vec3 previousPosition; // position before the last update
+    glm::vec3 pendingPosition;  // proposed by beginUpdate()
+    CollisionManager::SupportCache support; // what it stands on, for its queries
 
     // Movement
     float moveSpeed;
@@ -11,9 +11,12 @@ Platform::Platform(const Mesh& m, const char* platformName)
 	collisionEnabled(true),
 	useOBBCollision(false),
 	m_isHazard(false), 
-	name(platformName)
+	name(platformName),
+	collisionMesh(nullptr),
+	transformDirty(true)
 {
 	computeMeshBounds();
+	updateTransform();
 
 	// DEBUG: Print mesh info
 	printf("Platform '%s' created:\n", platformName);
@@ -47,15 +50,40 @@ void Platform::computeMeshBounds()
 	}
 }
 
+void Platform::buildCollisionMesh(const Mesh& mesh, TriangleBVH& outBVH)
+{
+	std::vector<glm::vec3> positions(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+		positions[i] = mesh.vertices[i].pos;
+	outBVH.build(positions, mesh.indices);
+}
+
+bool Platform::updateTransform()
+{
+	if (!transformDirty)
+		return false;
+
+	modelMatrix = composeModelMatrix(position, rotation, scale);
+	inverseModelMatrix = glm::inverse(modelMatrix);
+	computeWorldAABB(modelMatrix, worldMin, worldMax);
+	transformDirty = false;
+	return true;
+}
+
+// The getters stay correct between a setter and the next updateTransform(),
+// they just don't hit the cache then.
 glm::mat4 Platform::getModelMatrix() const
 {
-	glm::mat4 model(1.0f);
-	model = glm::translate(model, position);
-	model = glm::rotate(model, rotation.y, glm::vec3(0, 1, 0));
-	model = glm::rotate(model, rotation.x, glm::vec3(1, 0, 0));
-	model = glm::rotate(model, rotation.z, glm::vec3(0, 0, 1));
-	model = glm::scale(model, scale);
-	return model;
+	if (transformDirty)
+		return composeModelMatrix(position, rotation, scale);
+	return modelMatrix;
+}
+
+glm::mat4 Platform::getInverseModelMatrix() const
+{
+	if (transformDirty)
+		return glm::inverse(composeModelMatrix(position, rotation, scale));
+	return inverseModelMatrix;
 }
 
 void Platform::draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection) const
@@ -75,9 +103,18 @@ void Platform::draw(Shader& shader, const glm::mat4& view, const glm::mat4& proj
 
 void Platform::getWorldAABB(glm::vec3& outMin, glm::vec3& outMax) const
 {
-	// Transform the 8 corners of the mesh AABB and compute world min/max.
-	glm::mat4 model = getModelMatrix();
+	if (transformDirty)
+	{
+		computeWorldAABB(getModelMatrix(), outMin, outMax);
+		return;
+	}
+	outMin = worldMin;
+	outMax = worldMax;
+}
 
+void Platform::computeWorldAABB(const glm::mat4& model, glm::vec3& outMin, glm::vec3& outMax) const
+{
+	// Transform the 8 corners of the mesh AABB and compute world min/max.
 	glm::vec3 corners[8];
 	corners[0] = glm::vec3(meshMin.x, meshMin.y, meshMin.z);
 	corners[1] = glm::vec3(meshMax.x, meshMin.y, meshMin.z);
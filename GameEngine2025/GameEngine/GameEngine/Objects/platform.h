@@ -2,6 +2,7 @@
 #include "../Model Loading/mesh.h"
 #include "../Shaders/shader.h"
 #include "../Algorithms/collision.h"
+#include "../Graphics/renderPacket.h"
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 #include <vector>
@@ -17,28 +18,42 @@ private:
 	bool useOBBCollision;
 	bool m_isHazard;  // Renamed: use m_ prefix to avoid conflict with isHazard() method
 	std::string name;
+	const TriangleBVH* collisionMesh;
 
 	glm::vec3 meshMin;
 	glm::vec3 meshMax;
 
+	// cached from position/rotation/scale by updateTransform()
+	glm::mat4 modelMatrix;
+	glm::mat4 inverseModelMatrix;
+	glm::vec3 worldMin;
+	glm::vec3 worldMax;
+	bool transformDirty;
+
 	void computeMeshBounds();
+	void computeWorldAABB(const glm::mat4& model, glm::vec3& outMin, glm::vec3& outMax) const;
 
 public:
 	Platform(const Mesh& mesh, const char* platformName = "Platform");
 	
-	void setPosition(const glm::vec3& p) { position = p; }
-	void setRotation(const glm::vec3& r) { rotation = r; }
-	void setScale(const glm::vec3& s) { scale = s; }
+	void setPosition(const glm::vec3& p) { position = p; transformDirty = true; }
+	void setRotation(const glm::vec3& r) { rotation = r; transformDirty = true; }
+	void setScale(const glm::vec3& s) { scale = s; transformDirty = true; }
 	void setName(const char* n) { name = n; }
 	
 	glm::vec3 getPosition() const { return position; }
 	glm::vec3 getRotation() const { return rotation; }
 	glm::vec3 getScale() const { return scale; }
+	const Mesh& getMesh() const { return mesh; }
 
 	void setCollisionEnabled(bool enabled) { collisionEnabled = enabled; }
 	void setUseOBBCollision(bool use) { useOBBCollision = use; }
 	void setIsHazard(bool hazard) { m_isHazard = hazard; }
 	bool getIsHazard() const { return m_isHazard; }
+	// Collide against these triangles instead of the box. Build them once per
+	// loaded mesh with buildCollisionMesh() and share them, they're not owned.
+	void setCollisionMesh(const TriangleBVH* bvh) { collisionMesh = bvh; }
+	static void buildCollisionMesh(const Mesh& mesh, TriangleBVH& outBVH);
 
 	void draw(Shader& shader, const glm::mat4& view, const glm::mat4& projection) const;
 
@@ -48,6 +63,8 @@ public:
 	bool isHazard() const override { return m_isHazard; }  // Override from ICollidable
 	const char* getName() const override { return name.c_str(); }
 	glm::mat4 getModelMatrix() const override;
+	glm::mat4 getInverseModelMatrix() const override;
+	bool updateTransform() override;
 	
 	void getLocalBounds(glm::vec3& outMin, glm::vec3& outMax) const override {
 		outMin = meshMin;
@@ -55,4 +72,5 @@ public:
 	}
 	
 	bool usesOBBCollision() const override { return useOBBCollision; }
+	const TriangleBVH* getCollisionMesh() const override { return collisionMesh; }
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "skybox.h"
+#include "../Graphics/glStateCache.h"
 #include <cstdio>
 
 // Skybox vertices (cube centered at origin)
@@ -58,18 +59,18 @@ Skybox::~Skybox() {
 void Skybox::setupMesh() {
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
-    glBindVertexArray(vao);
+    GLStateCache::bindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
+    GLStateCache::bindVertexArray(0);
 }
 
 GLuint Skybox::loadCubemap(const std::vector<std::string>& faces) {
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLStateCache::bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     
     glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
@@ -133,7 +134,7 @@ bool Skybox::load(const std::vector<std::string>& faces) {
 
 
 void Skybox::draw(const glm::mat4& view, const glm::mat4& projection) {
-    glDepthFunc(GL_LEQUAL);
+    GLStateCache::depthFunc(GL_LEQUAL);
     shader->use();
 
     // Remove translation from view matrix
@@ -142,12 +143,11 @@ void Skybox::draw(const glm::mat4& view, const glm::mat4& projection) {
     glUniformMatrix4fv(glGetUniformLocation(shader->getId(), "view"), 1, GL_FALSE, &skyboxView[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(shader->getId(), "projection"), 1, GL_FALSE, &projection[0][0]);
 
-    glBindVertexArray(vao);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    GLStateCache::bindVertexArray(vao);
+    GLStateCache::activeTexture(GL_TEXTURE0);
+    GLStateCache::bindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
     glUniform1i(glGetUniformLocation(shader->getId(), "skybox"), 0);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
 
-    glDepthFunc(GL_LESS);
+    GLStateCache::depthFunc(GL_LESS);
 }
\ No newline at end of file
@@ -0,0 +1,6 @@
+#version 400
+
+// depth only, color writes are masked off by the renderer
+void main()
+{
+}
@@ -0,0 +1,24 @@
+#version 400
+
+layout (location = 0) in vec3 pos;
+
+uniform mat4 MVP;
+
+// the shading pass tests against this depth with GL_LEQUAL, so both must
+// compute gl_Position the same way (see vertex_shader.glsl)
+invariant gl_Position;
+
+#ifdef PACKED_VERTEX
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+#endif
+
+void main()
+{
+#ifdef PACKED_VERTEX
+	vec4 position = vec4(pos * positionScale + positionBias, 1.0f);
+#else
+	vec4 position = vec4(pos, 1.0f);
+#endif
+	gl_Position = MVP * position;
+}
@@ -1,19 +1,123 @@
 #version 400
+// feature defines are inserted above by ShaderVariants, see shaderVariants.h
 
-in vec2 textureCoord; 
+#if defined(LIT) || defined(CLUSTERED)
+#define NEEDS_SURFACE
+#endif
+
+#ifdef TEXTURED
+in vec2 textureCoord;
+uniform sampler2D texture1;
+#endif
+
+#ifdef NEEDS_SURFACE
 in vec3 norm;
 in vec3 fragPos;
+#endif
 
-out vec4 fragColor;
-
-uniform sampler2D texture1;
+#ifdef LIT
 uniform vec3 lightColor;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
+#endif
+
+#ifdef CLUSTERED
+// filled by the renderer from the frame's binned lights, see lightClusters.h
+uniform samplerBuffer lightData;		// 2 texels per light: position + radius, color
+uniform usamplerBuffer clusterRanges;	// offset + count per cluster
+uniform usamplerBuffer clusterLights;	// light indices
+uniform ivec3 clusterCount;
+uniform vec2 clusterScreenSize;
+uniform vec2 clusterDepth;				// near plane, log(far / near)
+uniform mat4 view;
+
+vec3 clusteredLights(vec3 albedo, vec3 N)
+{
+	// same cluster mapping as LightBins on the CPU
+	float depth = -(view * vec4(fragPos, 1.0f)).z;
+	ivec3 cell;
+	cell.xy = ivec2(gl_FragCoord.xy / clusterScreenSize * vec2(clusterCount.xy));
+	cell.z = int(log(max(depth, clusterDepth.x) / clusterDepth.x) / clusterDepth.y * float(clusterCount.z));
+	cell = clamp(cell, ivec3(0), clusterCount - 1);
+
+	int cluster = (cell.z * clusterCount.y + cell.y) * clusterCount.x + cell.x;
+	uvec2 range = texelFetch(clusterRanges, cluster).xy;
+
+	vec3 result = vec3(0.0f);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = int(texelFetch(clusterLights, int(range.x + i)).x);
+		vec4 positionRadius = texelFetch(lightData, light * 2);
+		vec3 color = texelFetch(lightData, light * 2 + 1).rgb;
+
+		vec3 toLight = positionRadius.xyz - fragPos;
+		float dist = length(toLight);
+		float falloff = clamp(1.0f - dist / positionRadius.w, 0.0f, 1.0f);
+		float diff = max(dot(N, toLight / max(dist, 0.0001f)), 0.0f);
+		result += albedo * color * diff * falloff * falloff;
+	}
+	return result;
+}
+#endif
+
+#ifdef SHADOWED
+in vec4 shadowCoord;
+uniform sampler2DShadow shadowMap;
+
+// 1 fully lit by the sun, 0 fully shadowed, 4 filtered taps
+float sunVisibility()
+{
+	vec3 coord = shadowCoord.xyz / shadowCoord.w;
+	if (coord.z >= 1.0f)
+		return 1.0f;
+
+	vec2 texel = 1.0f / vec2(textureSize(shadowMap, 0));
+	float lit = 0.0f;
+	lit += texture(shadowMap, vec3(coord.xy + vec2(-0.5f, -0.5f) * texel, coord.z));
+	lit += texture(shadowMap, vec3(coord.xy + vec2(0.5f, -0.5f) * texel, coord.z));
+	lit += texture(shadowMap, vec3(coord.xy + vec2(-0.5f, 0.5f) * texel, coord.z));
+	lit += texture(shadowMap, vec3(coord.xy + vec2(0.5f, 0.5f) * texel, coord.z));
+	return lit * 0.25f;
+}
+#endif
+
+out vec4 fragColor;
 
 void main()
 {
-	//TO DO: Add illumination from Lab 9
+#ifdef TEXTURED
+	vec4 baseColor = texture(texture1, textureCoord);
+#else
+	vec4 baseColor = vec4(1.0f);
+#endif
+
+#ifdef LIT
+	// basic Blinn-Phong
+	vec3 N = normalize(norm);
+	vec3 L = normalize(lightPos - fragPos);
+	float diff = max(dot(N, L), 0.0f);
+
+	vec3 V = normalize(viewPos - fragPos);
+	vec3 H = normalize(L + V);
+	float spec = pow(max(dot(N, H), 0.0f), 64.0f);
+
+	vec3 ambient = 0.12f * baseColor.rgb;
+	vec3 diffuse = diff * baseColor.rgb * lightColor;
+	vec3 specular = spec * lightColor * 0.3f;
+
+	vec3 color = ambient + diffuse + specular;
+#else
+	vec3 color = baseColor.rgb;
+#endif
+
+#ifdef SHADOWED
+	color *= mix(0.55f, 1.0f, sunVisibility());
+#endif
+
+#ifdef CLUSTERED
+	// point lights add on top of whatever the base shading is
+	color += clusteredLights(baseColor.rgb, normalize(norm));
+#endif
 
-	fragColor = texture(texture1, textureCoord);
-}
\ No newline at end of file
+	fragColor = vec4(color, baseColor.a);
+}
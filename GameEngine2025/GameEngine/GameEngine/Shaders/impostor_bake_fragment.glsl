@@ -0,0 +1,16 @@
+#version 400
+
+in vec2 textureCoord;
+in vec3 norm;
+
+uniform sampler2D texture1;
+
+layout (location = 0) out vec4 albedo;		// alpha is coverage
+layout (location = 1) out vec4 normalDepth;	// mesh-space normal, view depth
+
+void main()
+{
+	albedo = vec4(texture(texture1, textureCoord).rgb, 1.0f);
+	// orthographic bake, window depth is linear in view distance
+	normalDepth = vec4(normalize(norm) * 0.5f + 0.5f, gl_FragCoord.z);
+}
@@ -0,0 +1,29 @@
+#version 400
+// renders one view of a mesh into the impostor atlases, see impostor.h
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec3 normals;
+layout (location = 2) in vec2 texCoord;
+
+out vec2 textureCoord;
+out vec3 norm;
+
+uniform mat4 MVP;
+
+#ifdef PACKED_VERTEX
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+#endif
+
+void main()
+{
+#ifdef PACKED_VERTEX
+	vec4 position = vec4(pos * positionScale + positionBias, 1.0f);
+#else
+	vec4 position = vec4(pos, 1.0f);
+#endif
+
+	gl_Position = MVP * position;
+	textureCoord = texCoord;
+	norm = normals;	// mesh space, the impostor applies the model's rotation later
+}
@@ -0,0 +1,57 @@
+#version 400
+
+in vec2 frameUV;
+in vec3 quadPosition;
+flat in vec3 viewDirection;
+flat in vec2 gridBase;
+flat in vec2 gridWeight;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+uniform float frames;
+uniform float radius;
+uniform mat4 MVP;
+uniform mat3 normalMatrix;	// mesh to world
+uniform vec3 sunDirection;
+
+out vec4 fragColor;
+
+vec2 atlasCoord(vec2 frame)
+{
+	return (frame + frameUV) / frames;
+}
+
+void main()
+{
+	vec2 frame[4] = vec2[4](gridBase, gridBase + vec2(1.0f, 0.0f), gridBase + vec2(0.0f, 1.0f), gridBase + vec2(1.0f, 1.0f));
+	float weight[4] = float[4](
+		(1.0f - gridWeight.x) * (1.0f - gridWeight.y),
+		gridWeight.x * (1.0f - gridWeight.y),
+		(1.0f - gridWeight.x) * gridWeight.y,
+		gridWeight.x * gridWeight.y);
+
+	vec4 albedo = vec4(0.0f);
+	vec4 normalDepth = vec4(0.0f);
+	for (int i = 0; i < 4; i++)
+	{
+		albedo += texture(albedoAtlas, atlasCoord(frame[i])) * weight[i];
+		normalDepth += texture(normalDepthAtlas, atlasCoord(frame[i])) * weight[i];
+	}
+
+	if (albedo.a < 0.5f)
+		discard;
+
+	// empty texels are all zero, renormalize by the coverage that was hit
+	albedo.rgb /= albedo.a;
+	normalDepth /= albedo.a;
+
+	// faces turned away from the sun get the same darkening the shadow map gives the mesh
+	vec3 N = normalize(normalMatrix * (normalDepth.xyz * 2.0f - 1.0f));
+	float lit = smoothstep(-0.1f, 0.1f, dot(N, sunDirection));
+	fragColor = vec4(albedo.rgb * mix(0.55f, 1.0f, lit), 1.0f);
+
+	// push the quad back to the baked surface so it intersects the ground properly
+	vec3 surface = quadPosition + viewDirection * radius * (1.0f - 2.0f * normalDepth.w);
+	vec4 clip = MVP * vec4(surface, 1.0f);
+	gl_FragDepth = clip.z / clip.w * 0.5f + 0.5f;
+}
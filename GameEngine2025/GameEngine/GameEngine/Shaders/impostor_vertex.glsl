@@ -0,0 +1,42 @@
+#version 400
+// Camera-facing quad standing in for a baked mesh, see impostor.h.
+// The quad is built in mesh space so non-uniform scales stay correct.
+
+layout (location = 0) in vec2 corner;	// [-1, 1]^2
+
+uniform mat4 MVP;
+uniform vec3 localCamera;	// camera position in mesh space
+uniform vec3 center;		// mesh-space bounding sphere
+uniform float radius;
+uniform float frames;		// views per atlas side
+
+out vec2 frameUV;
+out vec3 quadPosition;
+flat out vec3 viewDirection;
+flat out vec2 gridBase;		// lower left of the 4 views that get blended
+flat out vec2 gridWeight;
+
+void main()
+{
+	// the atlas only holds the upper hemisphere
+	vec3 d = localCamera - center;
+	d.y = max(d.y, 0.0f);
+	d = normalize(d);
+
+	// same basis the bake's lookAt used, see viewUp() in impostor.cpp
+	vec3 up = abs(d.y) > 0.999f ? vec3(0.0f, 0.0f, -1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 s = normalize(cross(-d, up));
+	vec3 u = cross(s, -d);
+
+	quadPosition = center + (corner.x * s + corner.y * u) * radius;
+	gl_Position = MVP * vec4(quadPosition, 1.0f);
+	frameUV = corner * 0.5f + 0.5f;
+	viewDirection = d;
+
+	// hemi-octahedral encoding, inverse of Impostor::frameDirection
+	vec3 o = d / (abs(d.x) + abs(d.y) + abs(d.z));
+	vec2 g = vec2(o.x + o.z, o.x - o.z) * 0.5f + 0.5f;
+	vec2 grid = clamp(g * frames - 0.5f, vec2(0.0f), vec2(frames - 1.0f));
+	gridBase = min(floor(grid), vec2(max(frames - 2.0f, 0.0f)));
+	gridWeight = grid - gridBase;
+}
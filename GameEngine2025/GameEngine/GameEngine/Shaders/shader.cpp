@@ -1,10 +1,15 @@
 #include "shader.h"
+#include "..\Graphics\glStateCache.h"
+#include <direct.h>
 #include <iostream>
+#include <iterator>
 #include <vector>
 
 using namespace std;
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+static bool binariesSupported = false;
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines)
 {
 	std::string vertexCode;
 	std::string fragmentCode;
@@ -30,85 +35,238 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 	{
 		std::cout << "Error reading shader!" << std::endl;
 	}
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
 
-	//compile shaders
-	unsigned int vertex, fragment;
-	int success;
+	injectDefines(vertexCode, defines);
+	injectDefines(fragmentCode, defines);
 
-	// vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
+	initCompiler();
 
-	// compile errors 
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-	if (!success)
+	vertex = 0;
+	fragment = 0;
+	pending = false;
+	id = 0;
+
+	// cache key: both sources plus the driver, binaries don't survive driver updates
+	std::string driver;
+	const char* strings[] = {
+		(const char*)glGetString(GL_VENDOR),
+		(const char*)glGetString(GL_RENDERER),
+		(const char*)glGetString(GL_VERSION)
+	};
+	for (const char* str : strings)
 	{
-		std::cout << "Error compiling vertex shader! " << std::endl;
+		if (str)
+			driver += str;
+		driver += '\n';
 	}
 
-	// fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-
-	// compile errors
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-	if (!success)
+	unsigned long long hash = 14695981039346656037ULL;	// FNV-1a
+	for (const std::string* part : { &vertexCode, &fragmentCode, &driver })
 	{
-		std::cout << "Error compiling fragment shader! " << std::endl;
+		for (unsigned char c : *part)
+		{
+			hash ^= c;
+			hash *= 1099511628211ULL;
+		}
+		hash ^= 0xFF;	// separator, "ab"+"c" and "a"+"bc" must differ
+		hash *= 1099511628211ULL;
 	}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
+	if (binariesSupported)
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "ShaderCache/%016llx.bin", hash);
+		cacheFile = name;
 
-	// Check Vertex Shader
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(vertex, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if (InfoLogLength > 0) {
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(vertex, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+		if (loadBinary())
+			return;
 	}
 
-	// Check Fragment Shader
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(fragment, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if (InfoLogLength > 0) {
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(fragment, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+	compile(vertexCode.c_str(), fragmentCode.c_str());
+}
+
+void Shader::initCompiler()
+{
+	static bool initialized = false;
+	if (initialized)
+		return;
+	initialized = true;
+
+	// let the driver compile and link on its own threads, 0xFFFFFFFF = as many as it likes
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
+	GLint formats = 0;
+	if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	binariesSupported = formats > 0;
+
+	if (binariesSupported)
+		_mkdir("ShaderCache");
+}
+
+void Shader::injectDefines(std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return;
+
+	// #version has to stay the first statement
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+	{
+		source.insert(0, defines);
+		return;
 	}
 
-	// shader Program
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		source += "\n" + defines;
+	else
+		source.insert(lineEnd + 1, defines);
+}
+
+void Shader::compile(const char* vShaderCode, const char* fShaderCode)
+{
+	// no status queries here, they would wait for the compiler
+	vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex, 1, &vShaderCode, NULL);
+	glCompileShader(vertex);
+
+	fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment, 1, &fShaderCode, NULL);
+	glCompileShader(fragment);
+
 	id = glCreateProgram();
 	glAttachShader(id, vertex);
 	glAttachShader(id, fragment);
+	if (binariesSupported)
+		glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(id);
 
-	// linking errors
+	pending = true;
+}
+
+bool Shader::loadBinary()
+{
+	std::ifstream file(cacheFile, std::ios::binary);
+	if (!file)
+		return false;
+
+	GLenum format = 0;
+	file.read((char*)&format, sizeof(format));
+	if (!file)
+		return false;
+
+	std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (binary.empty())
+		return false;
+
+	id = glCreateProgram();
+	glProgramBinary(id, format, &binary[0], (GLsizei)binary.size());
+
+	// a binary from another driver build is simply rejected, compile from source then
+	GLint success = GL_FALSE;
+	glGetProgramiv(id, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(id);
+		id = 0;
+		return false;
+	}
+	return true;
+}
+
+void Shader::saveBinary()
+{
+	GLint length = 0;
+	glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(id, length, NULL, &format, &binary[0]);
+
+	std::ofstream file(cacheFile, std::ios::binary);
+	if (!file)
+		return;
+	file.write((const char*)&format, sizeof(format));
+	file.write(&binary[0], length);
+}
+
+void Shader::finishLink()
+{
+	pending = false;
+
+	int success;
 	glGetProgramiv(id, GL_LINK_STATUS, &success);
 	if (!success)
 	{
+		GLint Result = GL_FALSE;
+		int InfoLogLength;
+
+		// Check Vertex Shader
+		glGetShaderiv(vertex, GL_COMPILE_STATUS, &Result);
+		if (!Result)
+		{
+			std::cout << "Error compiling vertex shader! " << std::endl;
+		}
+		glGetShaderiv(vertex, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 0) {
+			std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
+			glGetShaderInfoLog(vertex, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
+			printf("%s\n", &VertexShaderErrorMessage[0]);
+		}
+
+		// Check Fragment Shader
+		glGetShaderiv(fragment, GL_COMPILE_STATUS, &Result);
+		if (!Result)
+		{
+			std::cout << "Error compiling fragment shader! " << std::endl;
+		}
+		glGetShaderiv(fragment, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 0) {
+			std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
+			glGetShaderInfoLog(fragment, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
+			printf("%s\n", &FragmentShaderErrorMessage[0]);
+		}
+
 		std::cout << "Error linking shader!" << std::endl;
 	}
- 
+	else if (binariesSupported)
+	{
+		saveBinary();
+	}
+
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+	vertex = 0;
+	fragment = 0;
 }
 
 void Shader::use()
 {
-	glUseProgram(id);
+	if (pending)
+		finishLink();
+	GLStateCache::useProgram(id);
 }
 
 int Shader::getId()
 {
+	if (pending)
+		finishLink();
 	return id;
 }
 
 Shader::~Shader()
 {
+	// never used: the stages compiled for the deferred link are still around
+	if (pending)
+	{
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+	}
+	glDeleteProgram(id);
 }
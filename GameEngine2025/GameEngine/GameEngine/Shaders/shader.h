@@ -6,15 +6,36 @@
 #include <sstream>
 #include <iostream>
 
+// Linked programs are cached in ShaderCache/ as driver binaries, keyed by a
+// hash of both sources and the GL vendor/renderer/version strings. On a miss
+// the sources are compiled without waiting (in parallel where the driver has
+// GL_KHR_parallel_shader_compile) and the link result is only checked the
+// first time the program is actually needed.
 class Shader
 {
 public:
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// defines are inserted right after the #version line of both stages
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "");
 	~Shader();
 	void use();
 	int getId();
 
 private:
 	unsigned int id;
-};
+	unsigned int vertex;	// only kept while a compile is pending
+	unsigned int fragment;
+	bool pending;
+	std::string cacheFile;
+
+	void compile(const char* vShaderCode, const char* fShaderCode);
+	bool loadBinary();
+	void saveBinary();
+	void finishLink();
 
+	static void initCompiler();
+	static void injectDefines(std::string& source, const std::string& defines);
+
+	// no copies, a pending compile would be finished and deleted twice
+	Shader(const Shader&);
+	Shader& operator=(const Shader&);
+};
@@ -0,0 +1,42 @@
+#include "shaderVariants.h"
+
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath)
+{
+	this->vertexPath = vertexPath;
+	this->fragmentPath = fragmentPath;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	for (auto& variant : variants)
+		delete variant.second;
+}
+
+Shader& ShaderVariants::get(unsigned features)
+{
+	auto found = variants.find(features);
+	if (found != variants.end())
+		return *found->second;
+
+	Shader* shader = new Shader(vertexPath.c_str(), fragmentPath.c_str(), definesFor(features));
+	variants[features] = shader;
+	return *shader;
+}
+
+std::string ShaderVariants::definesFor(unsigned features)
+{
+	std::string defines;
+	if (features & SHADER_LIT)
+		defines += "#define LIT\n";
+	if (features & SHADER_TEXTURED)
+		defines += "#define TEXTURED\n";
+	if (features & SHADER_INSTANCED)
+		defines += "#define INSTANCED\n";
+	if (features & SHADER_PACKED)
+		defines += "#define PACKED_VERTEX\n";
+	if (features & SHADER_CLUSTERED)
+		defines += "#define CLUSTERED\n";
+	if (features & SHADER_SHADOWED)
+		defines += "#define SHADOWED\n";
+	return defines;
+}
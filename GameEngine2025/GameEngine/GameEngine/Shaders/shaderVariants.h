@@ -0,0 +1,40 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "shader.h"
+
+// feature bits, each one becomes a #define in the generated source
+enum ShaderFeature
+{
+	SHADER_LIT = 1 << 0,		// LIT: normals, Blinn-Phong
+	SHADER_TEXTURED = 1 << 1,	// TEXTURED: uv + diffuse sampler
+	SHADER_INSTANCED = 1 << 2,	// INSTANCED: per-instance model matrix at location 3
+	SHADER_PACKED = 1 << 3,		// PACKED_VERTEX: 16 bit positions relative to the mesh bounds
+	SHADER_CLUSTERED = 1 << 4,	// CLUSTERED: adds the point lights binned for the fragment's cluster
+	SHADER_SHADOWED = 1 << 5	// SHADOWED: darkens what the sun's shadow map says is occluded
+};
+
+// One source pair, many programs. Each feature mask is compiled the first
+// time it is asked for and kept, so a draw only pays for what it uses.
+// get() may compile, so only call it on the thread that owns the context.
+class ShaderVariants
+{
+public:
+	ShaderVariants(const char* vertexPath, const char* fragmentPath);
+	~ShaderVariants();
+
+	Shader& get(unsigned features);
+
+	// "#define LIT\n#define TEXTURED\n..." for a mask
+	static std::string definesFor(unsigned features);
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::map<unsigned, Shader*> variants;
+
+	// no copies, the variants are owned
+	ShaderVariants(const ShaderVariants&);
+	ShaderVariants& operator=(const ShaderVariants&);
+};
@@ -1,10 +0,0 @@
-#version 400
-
-out vec4 fragColor;
-
-uniform sampler2D texture1;
-
-void main()
-{
-    fragColor = vec4(1.0f);
-}
\ No newline at end of file
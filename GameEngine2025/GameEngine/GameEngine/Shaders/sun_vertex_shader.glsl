@@ -1,11 +0,0 @@
-#version 400
-
-layout (location = 0) in vec3 pos;
-
-
-uniform mat4 MVP;
-
-void main()
-{
-    gl_Position = MVP * vec4(pos, 1.0f);
-}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#version 400
+// CDLOD terrain patch, see terrain.h. Pairs with fragment_shader.glsl, the
+// feature defines (TEXTURED, LIT, CLUSTERED, SHADOWED) are inserted above
+// by ShaderVariants.
+
+#if defined(LIT) || defined(CLUSTERED)
+#define NEEDS_SURFACE
+#endif
+
+#define LOD_LEVELS 4
+
+layout (location = 0) in vec2 gridPos;		// [0, 1]^2
+layout (location = 3) in vec4 patchData;	// corner xz, size, level
+
+#ifdef TEXTURED
+out vec2 textureCoord;
+#endif
+#ifdef NEEDS_SURFACE
+out vec3 norm;
+out vec3 fragPos;
+#endif
+#ifdef SHADOWED
+out vec4 shadowCoord;
+uniform mat4 shadowMatrix;
+#endif
+
+uniform mat4 viewProjection;
+uniform vec3 cameraPos;
+
+uniform sampler2D heightMap;
+uniform vec2 terrainOrigin;
+uniform float terrainSpacing;
+uniform float terrainInverseSpacing;
+uniform vec2 heightTexel;			// 1 / heightmap size
+uniform float leafSize;
+uniform float gridResolution;
+uniform vec2 morphRanges[LOD_LEVELS];	// start, end
+uniform vec2 textureScale;
+
+float heightAt(vec2 xz)
+{
+	// sample centers sit on the heightfield's grid points
+	vec2 uv = ((xz - terrainOrigin) * terrainInverseSpacing + 0.5f) * heightTexel;
+	return textureLod(heightMap, uv, 0.0f).r;
+}
+
+void main()
+{
+	float size = patchData.z;
+	int level = int(patchData.w);
+
+	// a quarter of a coarser node uses half the grid, the extra vertices collapse
+	float resolution = gridResolution * size / (leafSize * exp2(float(level)));
+	vec2 grid = floor(gridPos * resolution + 0.5f) / resolution;
+	vec2 world = patchData.xy + grid * size;
+
+	// slide odd vertices onto the coarser grid as the camera moves away
+	float distance = length(cameraPos - vec3(world.x, heightAt(world), world.y));
+	vec2 range = morphRanges[level];
+	float morph = clamp((distance - range.x) / (range.y - range.x), 0.0f, 1.0f);
+	vec2 odd = fract(grid * resolution * 0.5f) * 2.0f / resolution;
+	world -= odd * size * morph;
+
+	vec4 position = vec4(world.x, heightAt(world), world.y, 1.0f);
+	gl_Position = viewProjection * position;
+
+#ifdef TEXTURED
+	textureCoord = world * textureScale + 0.5f;
+#endif
+#ifdef NEEDS_SURFACE
+	fragPos = position.xyz;
+	float left = heightAt(world - vec2(terrainSpacing, 0.0f));
+	float right = heightAt(world + vec2(terrainSpacing, 0.0f));
+	float back = heightAt(world - vec2(0.0f, terrainSpacing));
+	float front = heightAt(world + vec2(0.0f, terrainSpacing));
+	norm = normalize(vec3(left - right, 2.0f * terrainSpacing, back - front));
+#endif
+#ifdef SHADOWED
+	shadowCoord = shadowMatrix * position;
+#endif
+}
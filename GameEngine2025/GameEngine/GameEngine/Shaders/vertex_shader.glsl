@@ -1,20 +1,78 @@
 #version 400
+// feature defines (LIT, TEXTURED, INSTANCED, PACKED_VERTEX, CLUSTERED,
+// SHADOWED) are inserted above by ShaderVariants, see shaderVariants.h
+
+#if defined(LIT) || defined(CLUSTERED)
+#define NEEDS_SURFACE
+#endif
 
 layout (location = 0) in vec3 pos;
+#ifdef NEEDS_SURFACE
 layout (location = 1) in vec3 normals;
+#endif
+#ifdef TEXTURED
 layout (location = 2) in vec2 texCoord;
+#endif
+#ifdef INSTANCED
+layout (location = 3) in mat4 instanceModel;	// takes locations 3-6
+#endif
 
+#ifdef TEXTURED
 out vec2 textureCoord;
+#endif
+#ifdef NEEDS_SURFACE
 out vec3 norm;
 out vec3 fragPos;
+#endif
+#ifdef SHADOWED
+out vec4 shadowCoord;
+#endif
+
+// must match the depth prepass exactly (depth_vertex.glsl), which this pass
+// tests against with GL_LEQUAL
+invariant gl_Position;
 
+#ifdef INSTANCED
+uniform mat4 viewProjection;
+#else
 uniform mat4 MVP;
 uniform mat4 model;
+#endif
+
+#ifdef SHADOWED
+uniform mat4 shadowMatrix;	// world to shadow map texture space
+#endif
+
+#ifdef PACKED_VERTEX
+// positions arrive as snorm16 in [-1, 1] over the mesh bounds
+uniform vec3 positionScale;
+uniform vec3 positionBias;
+#endif
 
 void main()
 {
+#ifdef PACKED_VERTEX
+	vec4 position = vec4(pos * positionScale + positionBias, 1.0f);
+#else
+	vec4 position = vec4(pos, 1.0f);
+#endif
+
+#ifdef INSTANCED
+	mat4 modelMatrix = instanceModel;
+	gl_Position = viewProjection * modelMatrix * position;
+#else
+	mat4 modelMatrix = model;
+	gl_Position = MVP * position;
+#endif
+
+#ifdef TEXTURED
 	textureCoord = texCoord;
-	fragPos = vec3(model * vec4(pos, 1.0f));
-	norm = mat3(transpose(inverse(model)))*normals;
-	gl_Position = MVP * vec4(pos, 1.0f);
-}
\ No newline at end of file
+#endif
+#ifdef NEEDS_SURFACE
+	fragPos = vec3(modelMatrix * position);
+	norm = mat3(transpose(inverse(modelMatrix))) * normals;
+#endif
+#ifdef SHADOWED
+	shadowCoord = shadowMatrix * modelMatrix * position;
+#endif
+}
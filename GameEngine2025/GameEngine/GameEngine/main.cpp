@@ -1,6 +1,18 @@
 #include "Algorithms\collision.h"
+#include "Algorithms\fixedTimestep.h"
+#include "Algorithms\heightfield.h"
 #include "Algorithms\physics.h"
+#include "Algorithms\spatialHash.h"
 #include "Camera\camera.h"
+#include "Graphics\framePreparer.h"
+#include "Graphics\dynamicResolution.h"
+#include "Graphics\glStateCache.h"
+#include "Graphics\gpuTimer.h"
+#include "Graphics\impostor.h"
+#include "Graphics\renderer.h"
+#include "Graphics\renderTarget.h"
+#include "Graphics\shadowMap.h"
+#include "Graphics\terrain.h"
 #include "Graphics\window.h"
 #include "Model Loading\mesh.h"
 #include "Model Loading\meshLoaderObj.h"
@@ -9,9 +21,18 @@
 #include "Objects\platform.h"
 #include "Objects\skybox.h" 
 #include "Shaders\shader.h"
+#include "Shaders\shaderVariants.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "Graphics\tripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
 
 // For playing sounds on Windows
 #include <Windows.h>
@@ -25,8 +46,15 @@ void playSound(const char* filename) {
 
 //OBJECT DECLARATIONS AND SETTING UP THE SCENE IS DONE IN MAIN CfPP FOR SIMPLICITY
 
-void processKeyboardInput();
+void processFrameInput();
+void updatePlayer(float step);
+bool isGroundBelow(const glm::vec3& eye, float depth);
 void resetPlayer();
+void addStressLights(std::vector<PointLight>& lights, float time);
+void benchmarkCollision();
+void dropItem(int itemID, const glm::vec3& position);
+void removeItemEntity(int itemID);
+void removeDroppedTreat(size_t index);
 
 // 0 = None, 1 = Plant, 2 = Fuel (Coin), 3 = Treat
 int heldItemID = 0;
@@ -34,7 +62,7 @@ int heldItemID = 0;
 float deltaTime = 0.0f;	// time between current frame and last frame
 float lastFrame = 0.0f;
 
-bool isNearItem = false;
+bool isNearItem = false; // an item or a dropped treat within reach
 
 // Task completion tracking
 bool taskPlantDelivered = false;
@@ -56,6 +84,10 @@ Camera camera;
 glm::vec3 lightColor = glm::vec3(1.0f);
 glm::vec3 lightPos = glm::vec3(0.0f, 300.0f, -300.0f);
 
+// The sun's shadow map caches the static world; bump this whenever a static
+// caster moves, appears or goes away so the cache is drawn again
+unsigned staticShadowVersion = 0;
+
 // Item Positions
 glm::vec3 plantPos = glm::vec3(-93.14f, 62.0f, -193.34f);
 glm::vec3 fuelPos = glm::vec3(6.33f, 3.5f, -406.48f); 
@@ -63,24 +95,109 @@ glm::vec3 treatPos = glm::vec3(105.08f, 50.74f, -199.93f);
 // Spaceship Position
 glm::vec3 spaceshipPos = glm::vec3(-30.0f, 10.0f, -30.0f);
 
-// Dropped treats from aliens
+// Dropped treats from aliens, removed once picked up
 struct DroppedTreat {
 	glm::vec3 pos;
-	bool collected;
+	int entity; // in entityGrid
 };
 std::vector<DroppedTreat> droppedTreats;
 
+// Everything that moves or can be picked up, for proximity checks
+enum EntityLayer : unsigned
+{
+	ENTITY_LAYER_PLAYER = 1u << 0,
+	ENTITY_LAYER_ALIEN = 1u << 1, // userData: index in aliens
+	ENTITY_LAYER_ITEM = 1u << 2, // userData: the item's heldItemID
+	ENTITY_LAYER_TREAT = 1u << 3 // userData: index in droppedTreats
+};
+SpatialHash entityGrid;
+int playerEntity = -1;
+std::vector<int> alienEntities; // per alien, -1 once it's dead
+int itemEntities[4] = { -1, -1, -1, -1 }; // per heldItemID, -1 while held or delivered
+std::vector<int> touchingAliens; // reused every tick
+
 // Centralized collision manager
 CollisionManager collisionManager;
 
+// Ground: one heightfield for collision queries and the CDLOD terrain
+Heightfield groundHeightfield;
+Terrain terrain;
+
 // Player physics
 PlayerPhysics playerPhysics;
 
+// Simulation clock, gameplay and physics advance in fixed ticks (--tick-rate)
+// and rendering interpolates between the previous and the current tick
+FixedTimestep simClock(60.0f, 5);
+glm::vec3 previousPlayerPos = glm::vec3(0.0f);
+glm::vec3 previousRocketOffset = glm::vec3(0.0f);
+bool jumpRequested = false; // space pressed, waiting for the next tick
+
+// Sorted opaque pass, depth prepass and overdraw debug counters
+Renderer renderer;
+
+// Worker threads that cull, sort and pack the next frame while this one draws
+FramePreparer framePreparer;
+
+// The scene is drawn offscreen at a scale picked from the measured GPU time,
+// then stretched over the window before the HUD goes on top
+RenderTarget sceneTarget;
+GpuTimer sceneTimer;
+DynamicResolution dynamicResolution;
+
+// Render debug toggles, flipped by input and handed to the renderer each frame
+bool depthPrepassEnabled = false;
+bool overdrawDebugEnabled = false;
+bool dynamicResolutionEnabled = true;
+bool lightStressEnabled = false; // F4: a few hundred extra point lights
+
+// Run GL on its own thread (--render-thread). The main thread then only polls
+// input and simulates, and passes scene snapshots over a triple buffer.
+bool useRenderThread = false;
+
+// Time the collision query paths once the level is loaded (--bench-collision)
+bool collisionBenchmark = false;
+
+// What the HUD shows, captured at the end of the simulation step
+struct HudState {
+	bool taskPlantDelivered;
+	bool taskFuelDelivered;
+	bool taskDogFed;
+	bool taskAlienKilled;
+	bool allTasksComplete;
+	int heldItemID;
+	bool showPressE;
+	// F2 collision stats, copied here because the render thread can't touch the manager
+	int dynamicTreeHeight;
+	int playerCandidates;
+	int staticTreeHeight;
+	int staticCount;
+	int playerSupportPercent;
+	unsigned playerSupportLookups;
+	int alienSupportPercent;
+	unsigned alienSupportLookups;
+	int gridEntities;
+	int gridBuckets;
+	int touchingAliens;
+};
+
+// Everything the render side needs for one frame, no pointers into game state
+// except the meshes and shaders, which live for the whole run
+struct SceneSnapshot {
+	FrameInput frame;
+	HudState hud;
+	bool depthPrepass;
+	bool overdrawDebug;
+	bool dynamicResolution;
+	int width;
+	int height;
+};
+TripleBuffer<SceneSnapshot> sceneExchange;
+
 // Spawn position
 const glm::vec3 SPAWN_POSITION = glm::vec3(0.0f, 5.0f, 0.0f);
 
 // Game objects, they will be dynamically allocated
-Platform* g_platform = nullptr;
 Platform* platform1 = nullptr;
 Platform* platform2 = nullptr;
 Platform* platform3 = nullptr;
@@ -101,7 +218,22 @@ Platform* spike3 = nullptr;
 Platform* spaceshipPlatform = nullptr;
 Platform* dogPlatform = nullptr; // Dog Object
 
+// per-mesh triangle hierarchies, shared by every platform drawn with the mesh
+TriangleBVH mountainCollisionMesh;
+TriangleBVH spaceshipCollisionMesh;
+TriangleBVH dogCollisionMesh;
+
+// Platforms taken out of the scene at runtime. They are only deleted at
+// shutdown because an in-flight render packet may still point at their mesh.
+std::vector<Platform*> retiredPlatforms;
+
 std::vector<Alien*> aliens; // Alien enemies
+// reused every tick for the aliens' collision batch
+std::vector<Alien*> probingAliens;
+std::vector<CollisionManager::Query> alienProbes;
+std::vector<CollisionManager::QueryResult> alienProbeResults;
+int playerCollisionCandidates = 0; // narrow phase candidates of the last player move, for the HUD
+CollisionManager::SupportCache playerSupport; // what the player stands on, across ticks
 
 // eye height above player's origin
 // player's position is at their feet for collision purposes
@@ -113,13 +245,25 @@ bool allMainTasksComplete() {
 	return taskPlantDelivered && taskDogFed && taskFuelDelivered && taskAlienKilled;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--render-thread") == 0)
+			useRenderThread = true;
+		else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+			simClock.setTickRate((float)atof(argv[++i]));
+		else if (strcmp(argv[i], "--bench-collision") == 0)
+			collisionBenchmark = true;
+	}
+
 	glClearColor(0.2f, 0.8f, 1.0f, 1.0f);
 
 	//building and compiling shader program
-	Shader shader("Shaders/vertex_shader.glsl", "Shaders/fragment_shader.glsl");
-	Shader sunShader("Shaders/sun_vertex_shader.glsl", "Shaders/sun_fragment_shader.glsl");
+	// one source pair, one program per feature mask (see shaderVariants.h)
+	ShaderVariants sceneShaders("Shaders/vertex_shader.glsl", "Shaders/fragment_shader.glsl");
+	Shader& shader = sceneShaders.get(SHADER_TEXTURED | SHADER_CLUSTERED | SHADER_SHADOWED);
+	Shader& packedShader = sceneShaders.get(SHADER_TEXTURED | SHADER_PACKED | SHADER_CLUSTERED | SHADER_SHADOWED);
+	Shader& sunShader = sceneShaders.get(0); // plain white, no uvs, no lighting
 	
 	Shader hudShader("Shaders/hud_vertex.glsl", "Shaders/hud_fragment.glsl");
 
@@ -139,7 +283,7 @@ int main()
 	GLuint texAlien = loadBMP("Resources/Textures/alien.bmp");
 	GLuint texDog = loadBMP("Resources/Textures/dog.bmp");
 
-	glEnable(GL_DEPTH_TEST);
+	GLStateCache::enable(GL_DEPTH_TEST);
 
 	// Lock cursor for FPS-style controls
 	window.lockCursor(true);
@@ -154,7 +298,8 @@ int main()
 	ImGui::StyleColorsDark();
 
 	// Setup Platform/Renderer backends
-	ImGui_ImplGlfw_InitForOpenGL(window.getWindow(), true);
+	// with a render thread the HUD is fed by hand, the GLFW callbacks would race with it
+	ImGui_ImplGlfw_InitForOpenGL(window.getWindow(), !useRenderThread);
 	ImGui_ImplOpenGL3_Init("#version 330");
 
 	// Texture Vectors
@@ -165,10 +310,6 @@ int main()
 	std::vector<Texture> textures2;
 	textures2.push_back({ tex2, "texture_diffuse" });
 
-	// ground texture
-	std::vector<Texture> textures3;
-	textures3.push_back({ tex3, "texture_diffuse" });
-
 	// platform texture
 	std::vector<Texture> textures4;
 	textures4.push_back({ tex4, "texture_diffuse" });
@@ -206,8 +347,6 @@ int main()
 	Mesh sun = loader.loadObj("Resources/Models/sphere.obj");
 	// Mesh box = loader.loadObj("Resources/Models/cube.obj", textures);
 
-	// plane mesh for ground
-	Mesh plane = loader.loadObj("Resources/Models/plane_mars.obj", textures3);
 
 	// fence mesh
 	Mesh fenceMesh = loader.loadObj("Resources/Models/fence.obj", textures2);
@@ -228,12 +367,31 @@ int main()
 	Mesh alienModel = loader.loadObj("Resources/Models/alien.obj", texturesAlien);
 	Mesh dogModel = loader.loadObj("Resources/Models/dog.obj", texturesDog);
 
-	// Platforms Init
-	// create a Platform from the plane mesh (keeps rendering + collision logic encapsulated)
-	g_platform = new Platform(plane, "Ground");
-	g_platform->setPosition(glm::vec3(0.0f, 1.0f, 0.0f));
-	g_platform->setScale(glm::vec3(300.0f, 2.0f, 1000.0f));
+	// static world geometry goes to the compact vertex format,
+	// before the platforms below take their copies
+	Mesh* staticMeshes[] = { &fenceMesh, &platformMesh, &mountainMesh, &spikeMesh, &spaceshipModel, &dogModel };
+	for (Mesh* m : staticMeshes)
+		m->pack();
+
+	// the mountains are far from the play area, past the swap distance
+	// they are drawn as a single quad from a baked atlas of views
+	ShaderVariants impostorBakeShaders("Shaders/impostor_bake_vertex.glsl", "Shaders/impostor_bake_fragment.glsl");
+	Impostor mountainImpostor;
+	mountainImpostor.bake(mountainMesh, impostorBakeShaders, 8, 384);
+	mountainImpostor.setSwapDistance(150.0f);
+
+	// Ground: flat at the old plane's top (y = 1.03) across the play area,
+	// rolling hills rise behind the mountains
+	groundHeightfield.create(glm::vec2(-384.0f, -1024.0f), 2.0f, 385, 1025, 1.03f);
+	groundHeightfield.addHills(glm::vec2(-200.0f, -460.0f), glm::vec2(200.0f, 110.0f), 80.0f, 45.0f, 120.0f, 7);
+	collisionManager.setHeightfield(&groundHeightfield);
+
+	terrain.init(groundHeightfield, tex3);
+	terrain.setTextureScale(glm::vec2(1.0f / 600.0f, 1.0f / 2000.0f)); // mars.bmp stretched like the old plane
+	ShaderVariants terrainShaders("Shaders/terrain_vertex.glsl", "Shaders/fragment_shader.glsl");
+	Shader& terrainShader = terrainShaders.get(SHADER_TEXTURED | SHADER_CLUSTERED | SHADER_SHADOWED);
 
+	// Platforms Init
 	// create floating platforms in the air
 	platform1 = new Platform(platformMesh, "P1");
 	platform1->setPosition(glm::vec3(50.0f, 10.0f, -38.0f));
@@ -269,38 +427,51 @@ int main()
 	fence->setPosition(glm::vec3(60.0f, 0.0f, -200.0f));
 	fence->setScale(glm::vec3(175.0f, 25.0f, 20.0f));
 
+	// the walls, the ship and the dog collide with their actual triangles
+	Platform::buildCollisionMesh(mountainMesh, mountainCollisionMesh);
+	Platform::buildCollisionMesh(spaceshipModel, spaceshipCollisionMesh);
+	Platform::buildCollisionMesh(dogModel, dogCollisionMesh);
+	printf("Collision meshes: mountain %zu, spaceship %zu, dog %zu triangles\n",
+		mountainCollisionMesh.getTriangleCount(), spaceshipCollisionMesh.getTriangleCount(), dogCollisionMesh.getTriangleCount());
+
 	//mountain around gameplay area acting as walls
 	mountain1 = new Platform(mountainMesh, "M1");
 	mountain1->setPosition(glm::vec3(100.0f, 0.0f, 100.0f));
 	mountain1->setScale(glm::vec3(250.0f, 250.0f, 250.0f));
 	mountain1->setRotation(glm::vec3(0.0f, 180.0f, 0.0f));
 	mountain1->setUseOBBCollision(true);
+	mountain1->setCollisionMesh(&mountainCollisionMesh);
 
 	mountain2 = new Platform(mountainMesh, "M2");
 	mountain2->setPosition(glm::vec3(-100.0f, 0.0f, 100.0f));
 	mountain2->setScale(glm::vec3(250.0f, 250.0f, 250.0f));
 	mountain2->setRotation(glm::vec3(0.0f, -180.0f, 0.0f));
 	mountain2->setUseOBBCollision(true);
+	mountain2->setCollisionMesh(&mountainCollisionMesh);
 
 	mountain4 = new Platform(mountainMesh, "M4");
 	mountain4->setPosition(glm::vec3(223.0f, 0.0f, -275.0f));
 	mountain4->setScale(glm::vec3(300.0f, 270.0f, 300.0f));
 	mountain4->setRotation(glm::vec3(0.0f, 80.0f, 0.0f));
 	mountain4->setUseOBBCollision(true);
+	mountain4->setCollisionMesh(&mountainCollisionMesh);
 
 	mountain5 = new Platform(mountainMesh, "M5");
 	mountain5->setPosition(glm::vec3(-223.0f, 0.0f, -275.0f));
 	mountain5->setScale(glm::vec3(300.0f, 350.0f, 300.0f));
 	mountain5->setRotation(glm::vec3(0.0f, 80.0f, 0.0f));
 	mountain5->setUseOBBCollision(true);
+	mountain5->setCollisionMesh(&mountainCollisionMesh);
 
 	mountain3 = new Platform(mountainMesh, "M3");
 	mountain3->setPosition(glm::vec3(0.0f, 0.0f, 150.0f));
 	mountain3->setScale(glm::vec3(130.0f, 200.0f, 130.0f));
+	mountain3->setCollisionMesh(&mountainCollisionMesh);
 
 	mountain6 = new Platform(mountainMesh, "M6");
 	mountain6->setPosition(glm::vec3(50.0f, 0.0f, -470.0f));
 	mountain6->setScale(glm::vec3(300.0f, 450.0f, 200.0f));
+	mountain6->setCollisionMesh(&mountainCollisionMesh);
 
 	spike1 = new Platform(spikeMesh, "S1");
 	spike1->setPosition(glm::vec3(-100.0f, 1.0f, -200.0f));
@@ -323,6 +494,7 @@ int main()
 	spaceshipPlatform->setPosition(spaceshipPos);
 	spaceshipPlatform->setScale(glm::vec3(10.0f, 10.0f, 10.0f));
 	spaceshipPlatform->setUseOBBCollision(true);
+	spaceshipPlatform->setCollisionMesh(&spaceshipCollisionMesh);
 
 	// Dog Object 
 	dogPlatform = new Platform(dogModel, "Dog");
@@ -332,33 +504,52 @@ int main()
 	dogPlatform->setPosition(dogPos);
 	dogPlatform->setScale(glm::vec3(3.0f, 3.0f, 3.0f)); // Adjust scale as needed
 	dogPlatform->setUseOBBCollision(true);
-
-	// Register all platforms with the collision manager
-	collisionManager.addCollidable(g_platform);
-	collisionManager.addCollidable(platform1);
-	collisionManager.addCollidable(platform2);
-	collisionManager.addCollidable(platform3);
-	collisionManager.addCollidable(platform4);
-	collisionManager.addCollidable(platform5);
-	collisionManager.addCollidable(platform6);
-	collisionManager.addCollidable(plantPlatform); 
-	collisionManager.addCollidable(fence);
-	collisionManager.addCollidable(mountain1);
-	collisionManager.addCollidable(mountain2);
-	collisionManager.addCollidable(mountain3);
-	collisionManager.addCollidable(mountain4);
-	collisionManager.addCollidable(mountain5);
-	collisionManager.addCollidable(mountain6);
-	collisionManager.addCollidable(spike1);
-	collisionManager.addCollidable(spike2);
-	collisionManager.addCollidable(spike3);
+	dogPlatform->setCollisionMesh(&dogCollisionMesh);
+
+	// Register all platforms with the collision manager. Only the spaceship
+	// ever moves (it launches), the rest go into the static tree.
+	collisionManager.addCollidable(platform1, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(platform2, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(platform3, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(platform4, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(platform5, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(platform6, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(plantPlatform, CollisionManager::Mobility::Static); 
+	collisionManager.addCollidable(fence, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(mountain1, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(mountain2, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(mountain3, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(mountain4, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(mountain5, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(mountain6, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(spike1, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(spike2, CollisionManager::Mobility::Static);
+	collisionManager.addCollidable(spike3, CollisionManager::Mobility::Static);
 	collisionManager.addCollidable(spaceshipPlatform);
-	collisionManager.addCollidable(dogPlatform);
+	collisionManager.addCollidable(dogPlatform, CollisionManager::Mobility::Static);
+	collisionManager.buildStaticTree();
 
 	// 0 makes most sense for our game
 	collisionManager.setCollisionMargin(0);
 	// Disable verbose debug output in release runs to avoid console flooding and input lag
 	collisionManager.setDebugOutput(false);  // Changed from true to false to reduce mouse-look lag
+	// a level this size is scanned faster than the trees are walked, even with
+	// the statics baked (--bench-collision, CollisionBench), so point resolves
+	// scan every collidable; casts and sweeps always use the trees
+	collisionManager.setQueryMode(CollisionManager::QueryMode::SimdScan);
+
+	// distance field of the static world for proximity checks, baked on
+	// every core the first time and read back from disk after that
+	auto bakeStart = std::chrono::high_resolution_clock::now();
+	bool fieldCached = collisionManager.bakeDistanceField("Resources/staticWorld.sdf");
+	double bakeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bakeStart).count();
+	const DistanceField& distanceField = collisionManager.getDistanceField();
+	printf("Distance field: %d of %d bricks stored, %.1f MB, %s in %.0f ms\n",
+		(int)distanceField.getStoredBrickCount(), (int)distanceField.getBrickCount(),
+		distanceField.getMemoryBytes() / (1024.0 * 1024.0), fieldCached ? "read" : "baked", bakeMs);
+
+	if (collisionBenchmark)
+		benchmarkCollision();
 
 
 
@@ -373,6 +564,18 @@ int main()
 	aliens.push_back(new Alien(&alienModel, glm::vec3(66.89f, 1.0f, -388.61f), 25.0f));
 
 	aliens.push_back(new Alien(&alienModel, glm::vec3(-53.96, 1.0, -279.16), 25.0f));
+
+	// the entity grid: the player, the aliens and the items lying around
+	playerEntity = entityGrid.insert(camera.getCameraPosition(), 0.0f, ENTITY_LAYER_PLAYER, 0);
+	for (size_t i = 0; i < aliens.size(); i++) {
+		glm::vec3 center;
+		float radius;
+		aliens[i]->getContactSphere(center, radius);
+		alienEntities.push_back(entityGrid.insert(center, radius, ENTITY_LAYER_ALIEN, (int)i));
+	}
+	dropItem(1, plantPos);
+	dropItem(2, fuelPos);
+	dropItem(3, treatPos);
 	std::vector<Vertex> hudVerts;
 	std::vector<int> hudIndices = { 0, 1, 2, 0, 2, 3 };
 	Vertex v;
@@ -394,255 +597,505 @@ int main()
 	};
 	skybox.load(skyboxFaces);
 
+	renderer.init();
+
+	// the sun never moves, its shadow camera covers the whole map
+	const glm::mat4 sunShadowViewProjection = ShadowMap::sunViewProjection(lightPos, glm::vec3(0.0f, 0.0f, -200.0f), 320.0f);
+	framePreparer.start();
+	sceneTimer.init();
+
+	// Draws one snapshot. Runs on this thread, or on the render thread when
+	// useRenderThread is set, so it must only read the snapshot and GL resources.
+	float lastRenderTime = 0.0f;
+	unsigned resolutionSample = 0; // the scene timer sample dynamicResolution last saw
+	auto renderFrame = [&](const SceneSnapshot& scene) {
+		renderer.setDepthPrepass(scene.depthPrepass);
+		renderer.setOverdrawDebug(scene.overdrawDebug);
+		GLStateCache::beginFrame();
+
+		// scene resolution for this frame, from the GPU time measured so far
+		bool offscreen = scene.dynamicResolution && scene.width > 0 && scene.height > 0 &&
+			sceneTarget.ensureCapacity(scene.width, scene.height);
+		int sceneWidth = scene.width;
+		int sceneHeight = scene.height;
+		if (offscreen) {
+			sceneWidth = dynamicResolution.scaled(scene.width);
+			sceneHeight = dynamicResolution.scaled(scene.height);
+			sceneTarget.bind(sceneWidth, sceneHeight);
+		}
+		sceneTimer.begin();
+		window.clear();
+
+		// The packet of the previous frame is ready by now. Take it, then hand
+		// this frame's snapshot to the workers while the GL thread replays it.
+		const RenderPacket& packet = framePreparer.acquire();
+		framePreparer.kick(FrameInput(scene.frame));
+
+		// Replay the previous frame's packet: opaques front-to-back,
+		// the skybox last so it only shades the pixels nothing covered
+		renderer.beginFrame(packet, sceneWidth, sceneHeight);
+		renderer.drawOpaque();
+		renderer.drawTerrain();
+		renderer.drawImpostors();
+		renderer.drawSkybox(skybox);
+		renderer.endFrame(sceneWidth, sceneHeight);
+		sceneTimer.end();
+
+		// upscale to the window, the HUD is drawn at full resolution on top
+		if (offscreen) {
+			sceneTarget.blitToScreen(scene.width, scene.height);
+			// only new measurements, the timer skips frames when the GPU falls behind
+			if (sceneTimer.getSampleCount() != resolutionSample) {
+				resolutionSample = sceneTimer.getSampleCount();
+				dynamicResolution.update(sceneTimer.getMilliseconds());
+			}
+		}
+		else {
+			dynamicResolution.reset();
+		}
+
+		if (scene.hud.showPressE) {
+			GLStateCache::disable(GL_DEPTH_TEST);
+			hudShader.use();
+			GLStateCache::activeTexture(GL_TEXTURE0);
+			GLStateCache::bindTexture(GL_TEXTURE_2D, texPressE);
+			glUniform1i(glGetUniformLocation(hudShader.getId(), "texture1"), 0);
+			glm::mat4 hudProj = glm::mat4(1.0);
+			glm::mat4 hudView = glm::mat4(1.0);
+			glm::mat4 hudModel = glm::mat4(1.0);
+			hudModel = glm::translate(hudModel, glm::vec3(0.0f, -0.8f, 0.0f));
+			hudModel = glm::scale(hudModel, glm::vec3(15.0f, 4.0f, 1.0f));
+			GLuint hudMatrixID = glGetUniformLocation(hudShader.getId(), "MVP");
+			glm::mat4 hudMVP = hudProj * hudView * hudModel;
+			glUniformMatrix4fv(hudMatrixID, 1, GL_FALSE, &hudMVP[0][0]);
+			hudSquare.draw(hudShader);
+			GLStateCache::enable(GL_DEPTH_TEST);
+		}
+
+		// ImGui Task List HUD
+		ImGui_ImplOpenGL3_NewFrame();
+		if (useRenderThread) {
+			// the GLFW backend may only be used from the main thread
+			float now = static_cast<float>(glfwGetTime());
+			ImGuiIO& hudIO = ImGui::GetIO();
+			hudIO.DisplaySize = ImVec2((float)scene.width, (float)scene.height);
+			hudIO.DeltaTime = now > lastRenderTime ? now - lastRenderTime : 1.0f / 60.0f;
+			lastRenderTime = now;
+		}
+		else {
+			ImGui_ImplGlfw_NewFrame();
+		}
+		ImGui::NewFrame();
+
+		// Position window in top-left corner
+		ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Always);
+		ImGui::SetNextWindowBgAlpha(0.7f); // Semi-transparent background
+
+		ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDecoration |
+			ImGuiWindowFlags_AlwaysAutoResize |
+			ImGuiWindowFlags_NoSavedSettings |
+			ImGuiWindowFlags_NoFocusOnAppearing |
+			ImGuiWindowFlags_NoNav |
+			ImGuiWindowFlags_NoMove;
+
+		ImGui::Begin("Tasks", nullptr, window_flags);
+
+		ImGui::Text("=== MISSION OBJECTIVES ===");
+		ImGui::Separator();
+
+		// Task 1: Deliver plant to ship
+		if (scene.hud.taskPlantDelivered)
+			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Deliver Plant to Ship");
+		else if (scene.hud.heldItemID == 1)
+			ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "[~] Bring Plant to Ship");
+		else
+			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Collect Plant");
+
+		// Task 2: Deliver fuel to ship
+		if (scene.hud.taskFuelDelivered)
+			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Deliver Fuel to Ship");
+		else if (scene.hud.heldItemID == 2)
+			ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "[~] Bring Fuel to Ship");
+		else
+			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Collect Fuel");
+
+		// Task 3: Feed the dog
+		if (scene.hud.taskDogFed)
+			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Feed the Dog");
+		else if (scene.hud.heldItemID == 3)
+			ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "[~] Bring Treat to Dog");
+		else
+			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Collect Treat");
+
+		// Task 4: Kill an alien
+		if (scene.hud.taskAlienKilled)
+			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Defeat an Alien");
+		else
+			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Defeat an Alien (Stomp!)");
+
+		ImGui::Separator();
+
+		// Final Task: Only show when all other tasks are complete
+		if (scene.hud.allTasksComplete) {
+			ImGui::TextColored(ImVec4(0.0f, 1.0f, 1.0f, 1.0f), ">>> BOARD THE SHIP TO ESCAPE! <<<");
+		}
+		else {
+			ImGui::Text("Complete all tasks to escape!");
+		}
+
+		ImGui::Separator();
+		ImGui::Text("Press E to interact");
+		ImGui::Text("Stomp aliens to defeat them!");
+
+		// Render debug toggles (F1 / F2)
+		if (renderer.isDepthPrepassEnabled() || renderer.isOverdrawDebugEnabled()) {
+			ImGui::Separator();
+			ImGui::Text("Depth prepass: %s", renderer.isDepthPrepassEnabled() ? "ON" : "OFF");
+			if (renderer.isOverdrawDebugEnabled()) {
+				ImGui::Text("Overdraw: %.2fx avg, %.1f%% of pixels > 1", renderer.getAverageOverdraw(), renderer.getOverdrawCoverage() * 100.0f);
+				ImGui::Text("Opaque draws: %d (%d culled, %d impostors)", (int)renderer.getOpaqueCount(), (int)renderer.getCulledCount(), (int)renderer.getImpostorCount());
+				ImGui::Text("Terrain patches: %d", (int)renderer.getTerrainPatchCount());
+				ImGui::Text("GL state calls: %u issued, %u skipped", GLStateCache::getIssuedCalls(), GLStateCache::getElidedCalls());
+				ImGui::Text("Scene GPU: %.2f ms, resolution %s %d%%", sceneTimer.getMilliseconds(),
+					scene.dynamicResolution ? "(dynamic, F3)" : "(fixed, F3)", (int)(dynamicResolution.getScale() * 100.0f + 0.5f));
+				ImGui::Text("Point lights: %d (%d visible, %d cluster refs, F4 stress)", (int)renderer.getLightCount(),
+					(int)renderer.getVisibleLightCount(), (int)renderer.getClusterLightReferences());
+				ImGui::Text("Shadow map: %d dynamic casters, static cache drawn %u times", (int)renderer.getDynamicCasterCount(), renderer.getShadowCacheRebuilds());
+				ImGui::Text("Collision broadphase: %d candidates last player move, static tree %d deep over %d, dynamic tree height %d",
+					scene.hud.playerCandidates, scene.hud.staticTreeHeight, scene.hud.staticCount, scene.hud.dynamicTreeHeight);
+				ImGui::Text("Support cache: player %d%% of %u lookups, aliens %d%% of %u",
+					scene.hud.playerSupportPercent, scene.hud.playerSupportLookups,
+					scene.hud.alienSupportPercent, scene.hud.alienSupportLookups);
+				ImGui::Text("Entity grid: %d entities, %d buckets in use, %d aliens checked against the player",
+					scene.hud.gridEntities, scene.hud.gridBuckets, scene.hud.touchingAliens);
+			}
+		}
+
+		ImGui::End();
+		// Render ImGui
+		ImGui::Render();
+		// the backend restores all the GL state it touches, the state cache stays valid
+		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+		window.present(scene.width, scene.height);
+	};
+
+	SceneSnapshot localScene;
+	std::atomic<bool> renderThreadRunning(true);
+	std::thread renderThread;
+	// the render thread signals each snapshot it takes, so the simulation
+	// waits for it instead of spinning out snapshots nobody will draw
+	std::mutex snapshotTakenMutex;
+	std::condition_variable snapshotTaken;
+	if (useRenderThread) {
+		// hand the context over, the main thread makes no GL calls from here on
+		window.releaseContext();
+		renderThread = std::thread([&]() {
+			window.makeContextCurrent();
+			while (renderThreadRunning.load()) {
+				if (sceneExchange.consume()) {
+					{
+						std::lock_guard<std::mutex> lock(snapshotTakenMutex);
+					}
+					snapshotTaken.notify_one();
+					renderFrame(sceneExchange.readBuffer());
+				}
+				else
+					std::this_thread::yield(); // nothing new from the simulation yet
+			}
+			framePreparer.acquire(); // don't leave a packet half built
+			window.releaseContext();
+		});
+	}
+
+	previousPlayerPos = camera.getCameraPosition();
 
 	//check if we close the window or press the escape button
 	while (!window.isPressed(GLFW_KEY_ESCAPE) &&
 		glfwWindowShouldClose(window.getWindow()) == 0)
 	{
-		window.clear();
+		window.pollEvents();
 		float currentFrame = static_cast<float>(glfwGetTime());
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 		playerPhysics.printStatus(camera.getCameraPosition());
-		// Handle cutscene
-		if (cutsceneActive)
+
+		// mouse look and key presses are handled once per rendered frame
+		if (!cutsceneActive)
+			processFrameInput();
+
+		// Simulation: zero or more fixed ticks, whatever time is due
+		simClock.beginFrame(deltaTime);
+		while (simClock.nextStep())
 		{
-			// Only remove and delete dogPlatform once
-			if (dogPlatform)
+			float step = simClock.getStep();
+			previousPlayerPos = camera.getCameraPosition();
+			previousRocketOffset = rocketLaunchOffset;
+
+			// Handle cutscene
+			if (cutsceneActive)
 			{
-				collisionManager.removeCollidable(dogPlatform);
-				delete dogPlatform;
-				dogPlatform = nullptr;
-			}
-			cutsceneTimer += deltaTime;
+				// Only remove dogPlatform once
+				if (dogPlatform)
+				{
+					collisionManager.removeCollidable(dogPlatform);
+					retiredPlatforms.push_back(dogPlatform);
+					dogPlatform = nullptr;
+					staticShadowVersion++;
+				}
+				cutsceneTimer += step;
 
-			// Unlock cursor during cutscene so it doesn't interfere
-			window.lockCursor(false);
+				// Unlock cursor during cutscene so it doesn't interfere
+				window.lockCursor(false);
 
-			// Position camera to the side of the rocket for a cinematic view
-			glm::vec3 rocketCurrentPos = spaceshipPos + rocketLaunchOffset;
-			glm::vec3 cutsceneCamPos = glm::vec3(120.0f, 20.0f, 0.0f); // Side view
-			glm::vec3 cutsceneLookAt = glm::vec3(0.0f, 20.0f, 0.0f); // Look at rocket center
+				// Position camera to the side of the rocket for a cinematic view
+				glm::vec3 rocketCurrentPos = spaceshipPos + rocketLaunchOffset;
+				glm::vec3 cutsceneCamPos = glm::vec3(120.0f, 20.0f, 0.0f); // Side view
+				glm::vec3 cutsceneLookAt = glm::vec3(0.0f, 20.0f, 0.0f); // Look at rocket center
 
-			camera.setCameraPosition(cutsceneCamPos);
-			// Calculate direction to look at rocket
-			glm::vec3 lookDir = glm::normalize(cutsceneLookAt - cutsceneCamPos);
-			camera.setCameraViewDirection(lookDir);
+				camera.setCameraPosition(cutsceneCamPos);
+				previousPlayerPos = cutsceneCamPos; // camera cut, nothing to interpolate
+				// Calculate direction to look at rocket
+				glm::vec3 lookDir = glm::normalize(cutsceneLookAt - cutsceneCamPos);
+				camera.setCameraViewDirection(lookDir);
 
-			// After a short delay, start the rocket launch
-			if (cutsceneTimer > 1.0f && !rocketLaunched)
-			{
-				rocketLaunched = true;
-				printf("ROCKET LAUNCHING!\n");
-			}
+				// After a short delay, start the rocket launch
+				if (cutsceneTimer > 1.0f && !rocketLaunched)
+				{
+					rocketLaunched = true;
+					staticShadowVersion++; // the ship casts a dynamic shadow from now on
+					printf("ROCKET LAUNCHING!\n");
+				}
 
-			// Accelerate the rocket upward
+				// Accelerate the rocket upward
 
-			if (rocketLaunched)
-			{
-				float launchSpeed = 50.0f + (cutsceneTimer - 1.0f) * 80.0f; // Accelerating
-				rocketLaunchOffset.y += launchSpeed * deltaTime;
+				if (rocketLaunched)
+				{
+					float launchSpeed = 50.0f + (cutsceneTimer - 1.0f) * 80.0f; // Accelerating
+					rocketLaunchOffset.y += launchSpeed * step;
+
+					// Update spaceship platform position
+					if (spaceshipPlatform)
+					{
+						spaceshipPlatform->setPosition(spaceshipPos + rocketLaunchOffset);
+					}
+				}
 
-				// Update spaceship platform position
-				if (spaceshipPlatform)
+				// End cutscene after duration
+				if (cutsceneTimer >= CUTSCENE_DURATION)
 				{
-					spaceshipPlatform->setPosition(spaceshipPos + rocketLaunchOffset);
+					cutsceneActive = false;
+					window.lockCursor(true);
+					printf("Cutscene ended! You escaped the planet!\n");
 				}
 			}
-
-			// End cutscene after duration
-			if (cutsceneTimer >= CUTSCENE_DURATION)
+			else
 			{
-				cutsceneActive = false;
-				window.lockCursor(true);
-				printf("Cutscene ended! You escaped the planet!\n");
+				updatePlayer(step);
+			}
+			entityGrid.move(playerEntity, camera.getCameraPosition());
+
+			// refit whatever moved this tick (the launching ship) before the aliens query
+			collisionManager.update();
+
+			// Aliens, all their collision probes resolved in one batch
+			alienProbes.clear();
+			probingAliens.clear();
+			for (Alien* alien : aliens) {
+				CollisionManager::Query probe;
+				if (alien->beginUpdate(step, probe)) {
+					alienProbes.push_back(probe);
+					probingAliens.push_back(alien);
+				}
+			}
+			alienProbeResults.resize(alienProbes.size());
+			collisionManager.resolvePoints(alienProbes.data(), alienProbes.size(), alienProbeResults.data());
+			for (size_t i = 0; i < probingAliens.size(); i++)
+				probingAliens[i]->endUpdate(alienProbeResults[i], collisionManager);
+			for (size_t i = 0; i < aliens.size(); i++) {
+				if (alienEntities[i] < 0)
+					continue;
+				glm::vec3 center;
+				float radius;
+				aliens[i]->getContactSphere(center, radius);
+				entityGrid.move(alienEntities[i], center);
+			}
+
+			// only the aliens whose box the player might be in
+			touchingAliens.clear();
+			entityGrid.query(camera.getCameraPosition(), 0.0f, ENTITY_LAYER_ALIEN, [](int entity) {
+				touchingAliens.push_back(entityGrid.getUserData(entity));
+			});
+			for (int index : touchingAliens) {
+				Alien* alien = aliens[index];
+				bool stomped = false;
+				if (alien->checkPlayerCollision(camera.getCameraPosition(), playerPhysics.velocity, stomped)) {
+					// Player died
+					resetPlayer();
+				}
+				else if (stomped) {
+					playSound("Resources/sleep_short.wav");
+					// Track alien kills for task
+					aliensKilledCount++;
+					if (!taskAlienKilled) {
+						taskAlienKilled = true;
+						printf("Task Complete: Kill an Alien!\n");
+					}
+
+					entityGrid.remove(alienEntities[index]);
+					alienEntities[index] = -1;
+
+					// Create dropped treat
+					DroppedTreat t;
+					t.pos = alien->getPosition();
+					t.pos.y += 2.0f;
+					t.entity = entityGrid.insert(t.pos, 0.0f, ENTITY_LAYER_TREAT, (int)droppedTreats.size());
+					droppedTreats.push_back(t);
+
+					// Bounce player
+					playerPhysics.velocity.y = 10.0f; // Bounce
+				}
 			}
-		}
-		else
-		{
-			processKeyboardInput();
 		}
 
-		
-		
-		
-		//// Code for the light ////
+		// Render between the last two ticks so motion stays smooth at any refresh rate
+		float alpha = simClock.getAlpha();
+		glm::vec3 renderCameraPos = glm::mix(previousPlayerPos, camera.getCameraPosition(), alpha);
 
-		sunShader.use();
 		//camera fov
 		glm::mat4 ProjectionMatrix = glm::perspective(glm::radians(70.0f), window.getWidth() * 1.0f / window.getHeight(), 0.1f, 10000.0f);
-		glm::mat4 ViewMatrix = glm::lookAt(camera.getCameraPosition(), camera.getCameraPosition() + camera.getCameraViewDirection(), camera.getCameraUp());
-		skybox.draw(ViewMatrix, ProjectionMatrix);
-
-		GLuint MatrixID = glGetUniformLocation(sunShader.getId(), "MVP");
-
-		//Test for one Obj loading = light source
-		glm::mat4 ModelMatrix = glm::translate(glm::mat4(1.0), lightPos);
-		glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-		glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		sun.draw(sunShader);
-
-		//// End code for the light ////
-
-		shader.use();
-		GLuint MatrixID2 = glGetUniformLocation(shader.getId(), "MVP");
-		GLuint ModelMatrixID = glGetUniformLocation(shader.getId(), "model");
-		glUniform3f(glGetUniformLocation(shader.getId(), "lightColor"), lightColor.x, lightColor.y, lightColor.z);
-		glUniform3f(glGetUniformLocation(shader.getId(), "lightPos"), lightPos.x, lightPos.y, lightPos.z);
-		glUniform3f(glGetUniformLocation(shader.getId(), "viewPos"), camera.getCameraPosition().x, camera.getCameraPosition().y, camera.getCameraPosition().z);
-
-		// Box
-		ModelMatrix = glm::translate(glm::mat4(1.0), glm::vec3(0.0f, 0.0f, 0.0f));
-		MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-		glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-		glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-		box.draw(shader);
-
-		///// Draw platforms via class //////
-		// main ground platform
-		g_platform->draw(shader, ViewMatrix, ProjectionMatrix);
-		// floating platforms
-		if (platform1) platform1->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (platform2) platform2->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (platform3) platform3->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (platform4) platform4->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (platform5) platform5->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (platform6) platform6->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (plantPlatform) plantPlatform->draw(shader, ViewMatrix, ProjectionMatrix); // Draw call
-		if (fence) fence->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (mountain1) mountain1->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (mountain2) mountain2->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (mountain3) mountain3->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (mountain4) mountain4->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (mountain5) mountain5->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (mountain6) mountain6->draw(shader, ViewMatrix, ProjectionMatrix);
-
-		// In the render loop, after drawing other platforms:
-		if (spike1) spike1->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (spike2) spike2->draw(shader, ViewMatrix, ProjectionMatrix);
-		if (spike3) spike3->draw(shader, ViewMatrix, ProjectionMatrix);
-
-		if (spaceshipPlatform) spaceshipPlatform->draw(shader, ViewMatrix, ProjectionMatrix);
-
-		// Draw dog if it exists
-		if (dogPlatform) dogPlatform->draw(shader, ViewMatrix, ProjectionMatrix);
-
-		// Aliens
-		for (auto& alien : aliens) {
-			alien->update(deltaTime, collisionManager);
-			alien->draw(shader, ViewMatrix, ProjectionMatrix);
-			bool stomped = false;
-			if (alien->checkPlayerCollision(camera.getCameraPosition(), playerPhysics.velocity, stomped)) {
-				// Player died
-				resetPlayer();
+		glm::mat4 ViewMatrix = glm::lookAt(renderCameraPos, renderCameraPos + camera.getCameraViewDirection(), camera.getCameraUp());
+
+		SceneSnapshot& scene = useRenderThread ? sceneExchange.writeBuffer() : localScene;
+		FrameInput& frameInput = scene.frame;
+		frameInput.view = ViewMatrix;
+		frameInput.projection = ProjectionMatrix;
+		frameInput.cameraPos = renderCameraPos;
+		frameInput.uniforms.lightColor = lightColor;
+		frameInput.uniforms.lightPos = lightPos;
+		frameInput.uniforms.viewPos = renderCameraPos;
+		frameInput.shadowViewProjection = sunShadowViewProjection;
+		frameInput.staticShadowVersion = staticShadowVersion;
+		frameInput.terrain = &terrain;
+		frameInput.terrainShader = &terrainShader;
+		std::vector<RenderObject>& objects = frameInput.objects;
+		objects.clear(); // the slot still holds an older frame
+
+		//// Code for the light ////
+		objects.push_back(RenderObject(&sun, &sunShader, lightPos));
+
+		///// Queue platforms //////
+		Platform* scenePlatforms[] = {
+			platform1, platform2, platform3, platform4, platform5, platform6,
+			plantPlatform, fence,
+			spike1, spike2, spike3,
+			spaceshipPlatform, dogPlatform // dog is gone once the cutscene starts
+		};
+		for (Platform* p : scenePlatforms) {
+			if (!p)
+				continue;
+			glm::vec3 position = p->getPosition();
+			ShadowCasting shadow = CASTS_STATIC_SHADOW;
+			if (p == spaceshipPlatform && rocketLaunched) {
+				position = spaceshipPos + glm::mix(previousRocketOffset, rocketLaunchOffset, alpha);
+				shadow = CASTS_DYNAMIC_SHADOW;
 			}
-			else if (stomped) {
-				playSound("Resources/sleep_short.wav");
-				// Track alien kills for task
-				aliensKilledCount++;
-				if (!taskAlienKilled) {
-					taskAlienKilled = true;
-					printf("Task Complete: Kill an Alien!\n");
-				}
+			Shader* platformShader = p->getMesh().packed ? &packedShader : &shader;
+			objects.push_back(RenderObject(&p->getMesh(), platformShader, position, p->getRotation(), p->getScale(), shadow));
+		}
 
-				// Create dropped treat
-				DroppedTreat t;
-				t.pos = alien->getPosition();
-				t.pos.y += 2.0f;
-				t.collected = false;
-				droppedTreats.push_back(t);
+		Platform* mountains[] = { mountain1, mountain2, mountain3, mountain4, mountain5, mountain6 };
+		for (Platform* p : mountains) {
+			if (!p)
+				continue;
+			Shader* platformShader = p->getMesh().packed ? &packedShader : &shader;
+			RenderObject mountain(&p->getMesh(), platformShader, p->getPosition(), p->getRotation(), p->getScale(), CASTS_STATIC_SHADOW);
+			mountain.impostor = &mountainImpostor;
+			objects.push_back(mountain);
+		}
 
-				// Bounce player
-				playerPhysics.velocity.y = 10.0f; // Bounce
-			}
+		for (auto& alien : aliens) {
+			if (!alien->isDead())
+				objects.push_back(RenderObject(&alien->getMesh(), &shader, alien->getInterpolatedPosition(alpha), alien->getRotationRadians(), glm::vec3(5.0f), CASTS_DYNAMIC_SHADOW));
 		}
 
 		// --- Items ---
+		glm::vec3 heldItemPos = renderCameraPos + (camera.getCameraViewDirection() * 1.5f) - (camera.getCameraUp() * 0.5f) + (glm::cross(camera.getCameraViewDirection(), camera.getCameraUp()) * 0.8f);
 		// Only draw plant if not delivered
 		if (!taskPlantDelivered) {
-			if (heldItemID == 1) {
-				ModelMatrix = glm::translate(glm::mat4(1.0), camera.getCameraPosition() + (camera.getCameraViewDirection() * 1.5f) - (camera.getCameraUp() * 0.5f) + (glm::cross(camera.getCameraViewDirection(), camera.getCameraUp()) * 0.8f));
-			}
-			else {
+			glm::vec3 itemPos = heldItemPos;
+			if (heldItemID != 1) {
 				float plantWobble = sin(currentFrame * 2.0f) * 0.5f;
-				ModelMatrix = glm::translate(glm::mat4(1.0), plantPos + glm::vec3(0, plantWobble, 0));
+				itemPos = plantPos + glm::vec3(0, plantWobble, 0);
 			}
-			ModelMatrix = glm::rotate(ModelMatrix, glm::radians(currentFrame * 100.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-			ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.1f, 0.1f, 0.1f));
-			MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-			glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-			glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-			plantModel.draw(shader);
+			objects.push_back(RenderObject(&plantModel, &shader, itemPos, glm::vec3(0.0f, glm::radians(currentFrame * 100.0f), 0.0f), glm::vec3(0.1f), CASTS_DYNAMIC_SHADOW));
 		}
 
 		// Only draw fuel if not delivered
 		if (!taskFuelDelivered) {
-			if (heldItemID == 2) {
-				ModelMatrix = glm::translate(glm::mat4(1.0), camera.getCameraPosition() + (camera.getCameraViewDirection() * 1.5f) - (camera.getCameraUp() * 0.5f) + (glm::cross(camera.getCameraViewDirection(), camera.getCameraUp()) * 0.8f));
-			}
-			else {
+			glm::vec3 itemPos = heldItemPos;
+			if (heldItemID != 2) {
 				float fuelWobble = sin(currentFrame * 3.0f) * 0.5f;
-				ModelMatrix = glm::translate(glm::mat4(1.0), fuelPos + glm::vec3(0, fuelWobble, 0));
+				itemPos = fuelPos + glm::vec3(0, fuelWobble, 0);
 			}
-			ModelMatrix = glm::rotate(ModelMatrix, glm::radians(currentFrame * 150.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-			ModelMatrix = glm::scale(ModelMatrix, glm::vec3(0.05f, 0.05f, 0.05f));
-			MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-			glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-			glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-			fuelModel.draw(shader);
+			objects.push_back(RenderObject(&fuelModel, &shader, itemPos, glm::vec3(0.0f, glm::radians(currentFrame * 150.0f), 0.0f), glm::vec3(0.05f), CASTS_DYNAMIC_SHADOW));
 		}
 
 		// Only draw treat if not fed to dog (and not holding it)
 		if (!taskDogFed) {
+			glm::vec3 treatSpin = glm::vec3(0.0f, glm::radians(currentFrame * 40.0f), 0.0f);
 			if (heldItemID == 3) {
-				ModelMatrix = glm::translate(glm::mat4(1.0), camera.getCameraPosition() + (camera.getCameraViewDirection() * 1.5f) - (camera.getCameraUp() * 0.5f) + (glm::cross(camera.getCameraViewDirection(), camera.getCameraUp()) * 0.8f));
-				ModelMatrix = glm::rotate(ModelMatrix, glm::radians(currentFrame * 40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f, 1.0f, 1.0f));
-				MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-				glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-				glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-				dogTreat.draw(shader);
+				objects.push_back(RenderObject(&dogTreat, &shader, heldItemPos, treatSpin, glm::vec3(1.0f), CASTS_DYNAMIC_SHADOW));
 			}
 			else if (treatPos.y > 0) {
 				float treatWobble = sin(currentFrame * 1.5f) * 0.5f;
-				ModelMatrix = glm::translate(glm::mat4(1.0), treatPos + glm::vec3(0, treatWobble, 0));
-				ModelMatrix = glm::rotate(ModelMatrix, glm::radians(currentFrame * 40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f, 1.0f, 1.0f));
-				MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-				glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-				glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-				dogTreat.draw(shader);
+				objects.push_back(RenderObject(&dogTreat, &shader, treatPos + glm::vec3(0, treatWobble, 0), treatSpin, glm::vec3(1.0f), CASTS_DYNAMIC_SHADOW));
 			}
 		}
 
 		// Draw Dropped Treats (only if dog not fed yet)
 		if (!taskDogFed) {
 			for (auto& t : droppedTreats) {
-				if (t.collected)
-					continue;
-
 				float treatWobble = sin(currentFrame * 1.5f) * 0.5f;
-				ModelMatrix = glm::translate(glm::mat4(1.0), t.pos + glm::vec3(0, treatWobble, 0));
-				ModelMatrix = glm::rotate(ModelMatrix, glm::radians(currentFrame * 40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-				ModelMatrix = glm::scale(ModelMatrix, glm::vec3(1.0f, 1.0f, 1.0f));
-				MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
-				glUniformMatrix4fv(MatrixID2, 1, GL_FALSE, &MVP[0][0]);
-				glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ModelMatrix[0][0]);
-				dogTreat.draw(shader);
+				objects.push_back(RenderObject(&dogTreat, &shader, t.pos + glm::vec3(0, treatWobble, 0), glm::vec3(0.0f, glm::radians(currentFrame * 40.0f), 0.0f), glm::vec3(1.0f), CASTS_DYNAMIC_SHADOW));
 			}
 		}
 
-		// HUD
-		bool nearAnyTreat = false;
-		if (!droppedTreats.empty() && !taskDogFed) {
-			for (auto& t : droppedTreats) {
-				if (!t.collected && glm::distance(camera.getCameraPosition(), t.pos) < 5.0f) {
-					nearAnyTreat = true;
-					break;
-				}
+		// --- Point lights, binned into clusters by the frame preparer ---
+		std::vector<PointLight>& lights = frameInput.lights;
+		lights.clear();
+
+		// pickups glow so they can be spotted from a distance
+		if (!taskPlantDelivered && heldItemID != 1)
+			lights.push_back(PointLight(plantPos, 18.0f, glm::vec3(0.2f, 0.9f, 0.3f)));
+		if (!taskFuelDelivered && heldItemID != 2)
+			lights.push_back(PointLight(fuelPos, 18.0f, glm::vec3(1.0f, 0.8f, 0.2f)));
+		if (!taskDogFed) {
+			if (heldItemID != 3 && treatPos.y > 0)
+				lights.push_back(PointLight(treatPos, 15.0f, glm::vec3(1.0f, 0.5f, 0.15f)));
+			for (auto& t : droppedTreats)
+				lights.push_back(PointLight(t.pos, 15.0f, glm::vec3(1.0f, 0.5f, 0.15f)));
+		}
+
+		// rocket exhaust, flickering under the ship
+		if (rocketLaunched) {
+			glm::vec3 exhaust = spaceshipPos + glm::mix(previousRocketOffset, rocketLaunchOffset, alpha) - glm::vec3(0.0f, 6.0f, 0.0f);
+			for (int i = 0; i < 3; i++) {
+				float flicker = 0.8f + 0.2f * sin(currentFrame * (23.0f + i * 7.0f));
+				lights.push_back(PointLight(exhaust - glm::vec3(0.0f, i * 5.0f, 0.0f), 40.0f * flicker, glm::vec3(1.0f, 0.45f, 0.1f) * flicker));
 			}
 		}
 
+		// alien eyes
+		for (auto& alien : aliens) {
+			if (!alien->isDead())
+				lights.push_back(PointLight(alien->getInterpolatedPosition(alpha) + glm::vec3(0.0f, 8.0f, 0.0f), 12.0f, glm::vec3(1.0f, 0.1f, 0.1f)));
+		}
+
+		if (lightStressEnabled)
+			addStressLights(lights, currentFrame);
+
+		// HUD
 		// Distance calculations for HUD
 		float distToShip = glm::distance(camera.getCameraPosition(), spaceshipPos);
 		float distToDog = 1000.0f;
@@ -662,103 +1115,66 @@ int main()
 		bool canFeedDog = (heldItemID == 3) && distToDog < dogDepositDist;
 
 		// Show "Press E" when near items to pick up (and not holding anything)
-		bool canPickUpItem = (isNearItem || nearAnyTreat) && heldItemID == 0;
+		bool canPickUpItem = isNearItem && heldItemID == 0;
 
 		// Combined condition for showing "Press E"
 		bool showPressE = canPickUpItem || canDepositAtShip || canFeedDog || nearShipForFinalTask;
 
-		if (showPressE) {
-			glDisable(GL_DEPTH_TEST);
-			hudShader.use();
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, texPressE);
-			glUniform1i(glGetUniformLocation(hudShader.getId(), "texture1"), 0);
-			glm::mat4 hudProj = glm::mat4(1.0);
-			glm::mat4 hudView = glm::mat4(1.0);
-			glm::mat4 hudModel = glm::mat4(1.0);
-			hudModel = glm::translate(hudModel, glm::vec3(0.0f, -0.8f, 0.0f));
-			hudModel = glm::scale(hudModel, glm::vec3(15.0f, 4.0f, 1.0f));
-			GLuint hudMatrixID = glGetUniformLocation(hudShader.getId(), "MVP");
-			glm::mat4 hudMVP = hudProj * hudView * hudModel;
-			glUniformMatrix4fv(hudMatrixID, 1, GL_FALSE, &hudMVP[0][0]);
-			hudSquare.draw(hudShader);
-			glEnable(GL_DEPTH_TEST);
+		scene.hud.taskPlantDelivered = taskPlantDelivered;
+		scene.hud.taskFuelDelivered = taskFuelDelivered;
+		scene.hud.taskDogFed = taskDogFed;
+		scene.hud.taskAlienKilled = taskAlienKilled;
+		scene.hud.allTasksComplete = allMainTasksComplete();
+		scene.hud.heldItemID = heldItemID;
+		scene.hud.showPressE = showPressE;
+		scene.hud.dynamicTreeHeight = collisionManager.getBroadphaseHeight();
+		scene.hud.playerCandidates = playerCollisionCandidates;
+		scene.hud.staticTreeHeight = collisionManager.getStaticTreeHeight();
+		scene.hud.staticCount = collisionManager.getStaticCount();
+		unsigned alienHits = 0, alienLookups = 0;
+		for (Alien* alien : aliens) {
+			alienHits += alien->getSupportCache().hits;
+			alienLookups += alien->getSupportCache().hits + alien->getSupportCache().misses;
 		}
-
-		// ImGui Task List HUD
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-
-		// Position window in top-left corner
-		ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Always);
-		ImGui::SetNextWindowBgAlpha(0.7f); // Semi-transparent background
-
-		ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDecoration |
-			ImGuiWindowFlags_AlwaysAutoResize |
-			ImGuiWindowFlags_NoSavedSettings |
-			ImGuiWindowFlags_NoFocusOnAppearing |
-			ImGuiWindowFlags_NoNav |
-			ImGuiWindowFlags_NoMove;
-
-		ImGui::Begin("Tasks", nullptr, window_flags);
-
-		ImGui::Text("=== MISSION OBJECTIVES ===");
-		ImGui::Separator();
-
-		// Task 1: Deliver plant to ship
-		if (taskPlantDelivered)
-			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Deliver Plant to Ship");
-		else if (heldItemID == 1)
-			ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "[~] Bring Plant to Ship");
-		else
-			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Collect Plant");
-
-		// Task 2: Deliver fuel to ship
-		if (taskFuelDelivered)
-			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Deliver Fuel to Ship");
-		else if (heldItemID == 2)
-			ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "[~] Bring Fuel to Ship");
-		else
-			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Collect Fuel");
-
-		// Task 3: Feed the dog
-		if (taskDogFed)
-			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Feed the Dog");
-		else if (heldItemID == 3)
-			ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "[~] Bring Treat to Dog");
-		else
-			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Collect Treat");
-
-		// Task 4: Kill an alien
-		if (taskAlienKilled)
-			ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "[X] Defeat an Alien");
-		else
-			ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "[ ] Defeat an Alien (Stomp!)");
-
-		ImGui::Separator();
-
-		// Final Task: Only show when all other tasks are complete
-		if (allMainTasksComplete()) {
-			ImGui::TextColored(ImVec4(0.0f, 1.0f, 1.0f, 1.0f), ">>> BOARD THE SHIP TO ESCAPE! <<<");
+		scene.hud.playerSupportPercent = (int)(playerSupport.getHitRate() * 100.0f + 0.5f);
+		scene.hud.playerSupportLookups = playerSupport.hits + playerSupport.misses;
+		scene.hud.alienSupportPercent = alienLookups ? (int)(alienHits * 100.0f / alienLookups + 0.5f) : 0;
+		scene.hud.alienSupportLookups = alienLookups;
+		scene.hud.gridEntities = (int)entityGrid.getEntityCount();
+		scene.hud.gridBuckets = (int)entityGrid.getOccupiedBucketCount();
+		scene.hud.touchingAliens = (int)touchingAliens.size();
+		scene.depthPrepass = depthPrepassEnabled;
+		scene.overdrawDebug = overdrawDebugEnabled;
+		scene.dynamicResolution = dynamicResolutionEnabled;
+		scene.width = window.getWidth();
+		scene.height = window.getHeight();
+
+		if (useRenderThread) {
+			sceneExchange.publish();
+			// one snapshot per rendered frame, like the single threaded loop;
+			// the timeout only keeps input polled if the render thread stalls
+			std::unique_lock<std::mutex> lock(snapshotTakenMutex);
+			snapshotTaken.wait_for(lock, std::chrono::milliseconds(100), [] { return !sceneExchange.isFresh(); });
 		}
 		else {
-			ImGui::Text("Complete all tasks to escape!");
+			renderFrame(scene);
 		}
+	}
 
-		ImGui::Separator();
-		ImGui::Text("Press E to interact");
-		ImGui::Text("Stomp aliens to defeat them!");
-
-		ImGui::End();
-		// Render ImGui
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-
-		window.update();
+	if (useRenderThread) {
+		renderThreadRunning = false;
+		renderThread.join();
+		window.makeContextCurrent();
 	}
 
+	// Workers may still be preparing a packet
+	framePreparer.stop();
+	renderer.release();
+	mountainImpostor.release();
+	terrain.release();
+	sceneTimer.release();
+	sceneTarget.release();
+
 	// Remove from collision manager before deleting
 	collisionManager.clearAll();
 	// Cleanup ImGui
@@ -770,8 +1186,6 @@ int main()
 	collisionManager.clearAll();
 
 	// cleanup
-	delete g_platform;
-	g_platform = nullptr;
 	delete platform1;
 	platform1 = nullptr;
 	delete platform2;
@@ -811,16 +1225,16 @@ int main()
 	delete dogPlatform;
 	dogPlatform = nullptr;
 
+	for (auto p : retiredPlatforms)
+		delete p;
+
 	for (auto a : aliens)
 		delete a;
 }
 
-//basically game loop input processing
-void processKeyboardInput()
+//basically game loop input processing, once per rendered frame
+void processFrameInput()
 {
-	float distPlant = glm::distance(camera.getCameraPosition(), plantPos);
-	float distFuel = glm::distance(camera.getCameraPosition(), fuelPos);
-	float distTreat = glm::distance(camera.getCameraPosition(), treatPos);
 	// Distance to spaceship
 	float distToShip = glm::distance(camera.getCameraPosition(), spaceshipPos);
 	// Dog Interaction
@@ -831,31 +1245,21 @@ void processKeyboardInput()
 	float interactionDist = 5.0f;
 	float shipDepositDist = 12.0f; // Slightly larger because the ship is big
 
-	bool nearStaticItem = false;
-	if (!taskPlantDelivered && distPlant < interactionDist) nearStaticItem = true;
-	if (!taskFuelDelivered && distFuel < interactionDist) nearStaticItem = true;
-	if (!taskDogFed && distTreat < interactionDist) nearStaticItem = true;
-	isNearItem = nearStaticItem;
+	// only items still needed are in the grid, the nearest one is picked up
+	int pickup = entityGrid.findNearest(camera.getCameraPosition(), interactionDist, ENTITY_LAYER_ITEM | ENTITY_LAYER_TREAT);
+	isNearItem = pickup >= 0;
 
 	static bool eWasPressed = false;
 	if (window.isPressed(GLFW_KEY_E) && !eWasPressed) {
 		if (heldItemID == 0) {
 			// Pick up items (only if task not complete)
-			if (!taskPlantDelivered && distPlant < interactionDist)
-				heldItemID = 1;
-			else if (!taskFuelDelivered && distFuel < interactionDist)
-				heldItemID = 2;
-			else if (!taskDogFed && distTreat < interactionDist)
+			if (pickup >= 0 && entityGrid.getLayer(pickup) == ENTITY_LAYER_ITEM) {
+				heldItemID = entityGrid.getUserData(pickup);
+				removeItemEntity(heldItemID);
+			}
+			else if (pickup >= 0) {
+				removeDroppedTreat(entityGrid.getUserData(pickup));
 				heldItemID = 3;
-			else if (!taskDogFed) {
-				// Check dropped treats
-				for (auto& t : droppedTreats) {
-					if (!t.collected && glm::distance(camera.getCameraPosition(), t.pos) < interactionDist) {
-						t.collected = true;
-						heldItemID = 3;
-						break;
-					}
-				}
 			}
 
 			// Final task: Board the ship when all tasks complete
@@ -885,6 +1289,11 @@ void processKeyboardInput()
 				taskDogFed = true;
 				heldItemID = 0;
 				printf("Task Complete: Treat given to Dog! Good boy!\n");
+
+				// the other treats aren't needed any more
+				removeItemEntity(3);
+				while (!droppedTreats.empty())
+					removeDroppedTreat(droppedTreats.size() - 1);
 			}
 			else {
 				// Normal drop logic for everything else (or if not near ship/dog)
@@ -894,12 +1303,23 @@ void processKeyboardInput()
 				else
 					dropPos.y = camera.getCameraPosition().y - 0.5f;
 
+				// not into a wall or a platform: out along the distance field
+				const float ITEM_CLEARANCE = 0.5f;
+				for (int i = 0; i < 4; i++) {
+					float distance = collisionManager.getDistance(dropPos);
+					glm::vec3 away = collisionManager.getDistanceGradient(dropPos);
+					if (distance >= ITEM_CLEARANCE || away == glm::vec3(0.0f))
+						break;
+					dropPos += away * (ITEM_CLEARANCE - distance);
+				}
+
 				if (heldItemID == 1)
 					plantPos = dropPos;
 				if (heldItemID == 2)
 					fuelPos = dropPos;
 				if (heldItemID == 3)
 					treatPos = dropPos;
+				dropItem(heldItemID, dropPos);
 				heldItemID = 0;
 			}
 		}
@@ -932,6 +1352,50 @@ void processKeyboardInput()
 	}
 	pWasPressed = window.isPressed(GLFW_KEY_P);
 
+	// debug: F1 toggles the depth prepass, F2 the overdraw counter
+	static bool f1WasPressed = false;
+	if (window.isPressed(GLFW_KEY_F1) && !f1WasPressed)
+	{
+		depthPrepassEnabled = !depthPrepassEnabled;
+	}
+	f1WasPressed = window.isPressed(GLFW_KEY_F1);
+
+	static bool f2WasPressed = false;
+	if (window.isPressed(GLFW_KEY_F2) && !f2WasPressed)
+	{
+		overdrawDebugEnabled = !overdrawDebugEnabled;
+	}
+	f2WasPressed = window.isPressed(GLFW_KEY_F2);
+
+	// F3 switches dynamic resolution off (native) and back on
+	static bool f3WasPressed = false;
+	if (window.isPressed(GLFW_KEY_F3) && !f3WasPressed)
+	{
+		dynamicResolutionEnabled = !dynamicResolutionEnabled;
+	}
+	f3WasPressed = window.isPressed(GLFW_KEY_F3);
+
+	// F4 adds the light stress test
+	static bool f4WasPressed = false;
+	if (window.isPressed(GLFW_KEY_F4) && !f4WasPressed)
+	{
+		lightStressEnabled = !lightStressEnabled;
+	}
+	f4WasPressed = window.isPressed(GLFW_KEY_F4);
+
+	// Jump (spacebar) - use edge detection AND require grounded,
+	// the jump itself happens on the next simulation tick
+	static bool spaceWasPressed = false;
+	if (window.isPressed(GLFW_KEY_SPACE) && !spaceWasPressed && playerPhysics.isGrounded)
+	{
+		jumpRequested = true;
+	}
+	spaceWasPressed = window.isPressed(GLFW_KEY_SPACE);
+}
+
+// player movement and collision for one simulation tick
+void updatePlayer(float step)
+{
 	// Get current position
 	glm::vec3 currentPos = camera.getCameraPosition();
 
@@ -961,81 +1425,45 @@ void processKeyboardInput()
 	// Apply movement input to physics
 	playerPhysics.applyMovementInput(moveDirection, isRunning);
 
-	// Jump (spacebar) - use edge detection AND require grounded
-	static bool spaceWasPressed = false;
-	if (window.isPressed(GLFW_KEY_SPACE) && !spaceWasPressed && playerPhysics.isGrounded)
+	if (jumpRequested)
 	{
 		playerPhysics.jump();
+		jumpRequested = false;
 	}
-	spaceWasPressed = window.isPressed(GLFW_KEY_SPACE);
 
 	// Update physics and get movement delta
-	glm::vec3 delta = playerPhysics.update(deltaTime);
-
-	// Apply delta to get proposed position
-	glm::vec3 proposed = currentPos + delta;
+	glm::vec3 delta = playerPhysics.update(step);
 
-	// Check collision with all objects
-	bool collided = collisionManager.resolvePointAgainstAll(proposed, PLAYER_EYE_HEIGHT);
+	// Sweep from the current position along the delta, sliding along
+	// whatever is in the way, so a long tick can't skip through thin objects
+	CollisionManager::QueryResult move = collisionManager.moveCapsule(CollisionManager::Query(currentPos, PLAYER_EYE_HEIGHT,
+		COLLISION_LAYER_ALL, CollisionManager::DEFAULT_CAPSULE_RADIUS, &playerSupport), delta);
+	glm::vec3 proposed = move.position;
+	playerCollisionCandidates = move.candidates;
 
 	bool groundContactThisFrame = false;
 
-	if (collided)
+	// Every face the move touched is in its contact manifold
+	if (move.findHazard())
 	{
-		const auto& info = collisionManager.getLastCollisionInfo();
-
-		// Check for hazard collision (no dynamic_cast needed)
-		if (info.collidable && info.collidable->isHazard())
-		{
-			resetPlayer();
-			return;
-		}
+		resetPlayer();
+		return;
+	}
 
-		// Handle collision based on face
-		if (info.face == CollisionManager::ContactFace::Top)
-		{
-			playerPhysics.onGroundCollision(proposed.y);
-			groundContactThisFrame = true;
-		}
-		else if (info.face == CollisionManager::ContactFace::Bottom)
-		{
-			// Only call ceiling collision for actual ceiling hits
-			playerPhysics.onCeilingCollision();
-		}
-		else
-		{
-			// For ANY collision (including side walls), check if we're still on ground
-			// This is crucial, wall collisions should NOT break ground contact
-			glm::vec3 probePos = proposed;
-			probePos.y -= 0.2f;
+	if (move.touches(CollisionManager::ContactFace::Bottom))
+	{
+		playerPhysics.onCeilingCollision();
+	}
 
-			if (collisionManager.resolvePointAgainstAll(probePos, PLAYER_EYE_HEIGHT))
-			{
-				if (collisionManager.getLastCollisionInfo().face == CollisionManager::ContactFace::Top)
-				{
-					groundContactThisFrame = true;
-					playerPhysics.isGrounded = true;
-				}
-			}
-		}
+	if (move.touches(CollisionManager::ContactFace::Top))
+	{
+		playerPhysics.onGroundCollision(proposed.y);
+		groundContactThisFrame = true;
 	}
-	else
+	else if (playerPhysics.isGrounded && playerPhysics.velocity.y <= 0.1f && isGroundBelow(proposed, 0.3f))
 	{
-		// No collision, check if we're still on ground (edge detection)
-		if (playerPhysics.isGrounded && playerPhysics.velocity.y <= 0.1f)
-		{
-			glm::vec3 probePos = proposed;
-			probePos.y -= 0.3f;
-
-			if (collisionManager.resolvePointAgainstAll(probePos, PLAYER_EYE_HEIGHT))
-			{
-				if (collisionManager.getLastCollisionInfo().face == CollisionManager::ContactFace::Top)
-				{
-					groundContactThisFrame = true;
-					playerPhysics.isGrounded = true;
-				}
-			}
-		}
+		// walking along a floor touches nothing, check it is still under us (edge detection)
+		groundContactThisFrame = true;
 	}
 
 	// update grounded state
@@ -1049,9 +1477,130 @@ void processKeyboardInput()
 	camera.setCameraPosition(proposed);
 }
 
+// a floor (not a wall or a slope too steep to stand on) at most depth
+// below the player's feet, one ray down from the eye
+bool isGroundBelow(const glm::vec3& eye, float depth)
+{
+	CollisionManager::RayHit hit;
+	return collisionManager.raycast(eye, glm::vec3(0.0f, -1.0f, 0.0f), PLAYER_EYE_HEIGHT + depth, hit,
+		COLLISION_LAYER_ALL, &playerSupport) && hit.normal.y > 0.7f;
+}
+
 void resetPlayer()
 {
 	playSound("Resources/sleep_short.wav");
 	camera.setCameraPosition(SPAWN_POSITION);
+	entityGrid.move(playerEntity, SPAWN_POSITION);
+	previousPlayerPos = SPAWN_POSITION; // teleport, don't interpolate
 	playerPhysics.reset();
+	jumpRequested = false;
+}
+
+// An item lying at position, where it can be picked up. A dropped treat
+// becomes the dog treat item, so there's only ever one of each.
+void dropItem(int itemID, const glm::vec3& position)
+{
+	if (itemEntities[itemID] >= 0)
+		entityGrid.move(itemEntities[itemID], position);
+	else
+		itemEntities[itemID] = entityGrid.insert(position, 0.0f, ENTITY_LAYER_ITEM, itemID);
+}
+
+void removeItemEntity(int itemID)
+{
+	if (itemEntities[itemID] < 0)
+		return;
+	entityGrid.remove(itemEntities[itemID]);
+	itemEntities[itemID] = -1;
+}
+
+// swap with the last treat, whose entity then points at its new index
+void removeDroppedTreat(size_t index)
+{
+	entityGrid.remove(droppedTreats[index].entity);
+	droppedTreats[index] = droppedTreats.back();
+	droppedTreats.pop_back();
+	if (index < droppedTreats.size())
+		entityGrid.setUserData(droppedTreats[index].entity, (int)index);
+}
+
+// F4 stress test: colored lights drifting over the whole map, always the same
+// layout so frame times can be compared between runs
+void addStressLights(std::vector<PointLight>& lights, float time)
+{
+	const int STRESS_LIGHTS = 288;
+	for (int i = 0; i < STRESS_LIGHTS; i++)
+	{
+		float a = i * 0.618034f;
+		float b = i * 0.414214f;
+		glm::vec3 center(-150.0f + 300.0f * (a - floor(a)), 8.0f + (i % 7) * 8.0f, -450.0f + 500.0f * (b - floor(b)));
+		glm::vec3 drift(sin(time * 0.7f + i) * 10.0f, sin(time * 1.3f + i * 0.5f) * 3.0f, cos(time * 0.5f + i) * 10.0f);
+		glm::vec3 color(0.5f + 0.5f * sin(i * 1.7f), 0.5f + 0.5f * sin(i * 2.3f + 2.0f), 0.5f + 0.5f * sin(i * 3.1f + 4.0f));
+		lights.push_back(PointLight(center + drift, 20.0f, color));
+	}
+}
+
+// --bench-collision: the same player queries through the old path (every
+// collidable, through its virtual interface) and through each query mode of
+// the collision manager. The modes must agree with the old path exactly.
+void benchmarkCollision()
+{
+	const int QUERIES = 20000;
+	const std::vector<ICollidable*>& collidables = collisionManager.getCollidables();
+
+	// half spread over the level, half standing in a collidable's top so they resolve
+	std::vector<glm::vec3> points;
+	for (int i = 0; i < QUERIES; i++)
+	{
+		float a = i * 0.618034f;
+		float b = i * 0.414214f;
+		float c = i * 0.732051f;
+		a -= floor(a); b -= floor(b); c -= floor(c);
+		if (i % 2 == 0 || collidables.empty())
+		{
+			points.push_back(glm::vec3(-150.0f + 300.0f * a, 80.0f * c, -450.0f + 500.0f * b));
+		}
+		else
+		{
+			glm::vec3 minW, maxW;
+			collidables[i % collidables.size()]->getWorldAABB(minW, maxW);
+			points.push_back(glm::vec3(glm::mix(minW.x, maxW.x, a), maxW.y + PLAYER_EYE_HEIGHT * c, glm::mix(minW.z, maxW.z, b)));
+		}
+	}
+
+	// the old loop didn't know about the ground either
+	const Heightfield* ground = collisionManager.getHeightfield();
+	CollisionManager::QueryMode gameMode = collisionManager.getQueryMode();
+	collisionManager.setHeightfield(nullptr);
+
+	std::vector<glm::vec3> expected(points);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (glm::vec3& p : expected)
+		for (ICollidable* collidable : collidables)
+			collisionManager.resolvePoint(collidable, p, PLAYER_EYE_HEIGHT);
+	double virtualMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Collision benchmark, %d queries against %d collidables\n", QUERIES, (int)collidables.size());
+	printf("  virtual per-object loop: %8.3f ms\n", virtualMs);
+
+	const char* names[] = { "AABB tree", "SoA scan, SSE", "SoA scan, scalar" };
+	const CollisionManager::QueryMode modes[] = { CollisionManager::QueryMode::Tree,
+		CollisionManager::QueryMode::SimdScan, CollisionManager::QueryMode::ScalarScan };
+	for (int m = 0; m < 3; m++)
+	{
+		collisionManager.setQueryMode(modes[m]);
+		std::vector<glm::vec3> resolved(points);
+		start = std::chrono::high_resolution_clock::now();
+		for (glm::vec3& p : resolved)
+			collisionManager.resolvePointAgainstAll(p, PLAYER_EYE_HEIGHT);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		int mismatches = 0;
+		for (int i = 0; i < QUERIES; i++)
+			if (resolved[i] != expected[i])
+				mismatches++;
+		printf("  %-23s: %8.3f ms (%.2fx), %d mismatches\n", names[m], ms, virtualMs / ms, mismatches);
+	}
+
+	collisionManager.setQueryMode(gameMode);
+	collisionManager.setHeightfield(ground);
 }